@@ -0,0 +1,534 @@
+//
+//  main.cpp
+//
+
+#include "processor.hpp"
+#include "engine.hpp"
+#include "log.hpp"
+
+#include <systemc>
+#include <CLI/CLI.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__)
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+using namespace sim;
+
+namespace {
+    struct Mode {
+        bool functional;                    // FunctionalEngine instead of the SystemC model
+        bool jit;
+        ControlUnit::MemoryAccess memoryAccess;
+        bool dmi;
+        bool blockCache;
+    };
+
+    const std::map<std::string, Mode> modes = {
+        {"pins", {false, false, ControlUnit::MemoryAccess::Pins, false, false}},
+        {"tlm", {false, false, ControlUnit::MemoryAccess::Transaction, false, false}},
+        {"dmi", {false, false, ControlUnit::MemoryAccess::Transaction, true, false}},
+        {"block-cache", {false, false, ControlUnit::MemoryAccess::Transaction, true, true}},
+        {"functional", {true, false, ControlUnit::MemoryAccess::Pins, false, false}},
+        {"jit", {true, true, ControlUnit::MemoryAccess::Pins, false, false}},
+    };
+
+    const std::map<std::string, ControlUnit::Sequencer> sequencers = {
+        {"thread", ControlUnit::Sequencer::Thread},
+        {"method", ControlUnit::Sequencer::Method},
+    };
+
+    const std::map<std::string, ControlUnit::RegisterAccess> registerAccessModes = {
+        {"pins", ControlUnit::RegisterAccess::Pins},
+        {"direct", ControlUnit::RegisterAccess::Direct},
+    };
+
+    struct Workload {
+        std::vector<uint8_t> block;
+        int relocate;                       // Offset of a 16-bit operand that gets the address of its block added, -1 = none
+    };
+
+    // Never halting workloads: the whole memory is filled with the same block, so the
+    // program counter wraps around at 0xFFFF and keeps executing. There are no jumps yet,
+    // the wrap-around is the loop. HL stays 0 unless a block loads it, so the memory
+    // operands read (and MVI M rewrites) the first instruction byte.
+    // arith, fill, alu-chain and mvi-kernel make up the default suite.
+    const std::map<std::string, Workload> workloads = {
+        {"arith", {{
+            0b00000110, 0x11,   // MVI B, 0x11
+            0b10000000,         // ADD B
+            0b10001001,         // ADC C
+            0b10010010,         // SUB D
+            0b10011011,         // SBB E
+            0b10000100,         // ADD H
+            0b10001101,         // ADC L
+        }, -1}},
+        {"fill", {{
+            0b00100001, 0x03, 0x00, // LXI H, block + 3
+            0b00110110, 0x36,   // MVI M, 0x36 (the opcode it overwrites)
+            0b00110110, 0x36,   // MVI M, 0x36
+            0b00000000,         // NOP
+        }, 1}},
+        {"alu-chain", {{
+            0b11000110, 0x03,   // ADI 3
+            0b11010110, 0x01,   // SUI 1
+            0b11100110, 0xFE,   // ANI 0xFE
+            0b11110110, 0x01,   // ORI 1
+            0b11101110, 0x55,   // XRI 0x55
+            0b11001110, 0x02,   // ACI 2
+            0b11011110, 0x01,   // SBI 1
+            0b11111110, 0x10,   // CPI 0x10
+        }, -1}},
+        {"mvi-kernel", {{
+            0b00111110, 0x01,   // MVI A, 1
+            0b00000110, 0x02,   // MVI B, 2
+            0b00001110, 0x03,   // MVI C, 3
+            0b00010110, 0x04,   // MVI D, 4
+            0b00011110, 0x05,   // MVI E, 5
+            0b00100110, 0x00,   // MVI H, 0
+            0b00101110, 0x00,   // MVI L, 0
+            0b00000000,         // NOP
+            0b00000000,         // NOP
+        }, -1}},
+        {"mixed", {{
+            0b00000110, 0x11,   // MVI B, 0x11
+            0b10000000,         // ADD B
+            0b10000110,         // ADD M
+            0b11000110, 0x03,   // ADI 3
+            0b00000000,         // NOP
+            0b00000000,         // NOP
+        }, -1}},
+        {"nop", {{
+            0b00000000,         // NOP
+        }, -1}},
+        {"mvi", {{
+            0b00000110, 0x11,   // MVI B, 0x11
+            0b00001110, 0x22,   // MVI C, 0x22
+        }, -1}},
+        {"mvi-m", {{
+            0b00110110, 0x36,   // MVI M, 0x36 (the same value)
+        }, -1}},
+        {"lxi", {{
+            0b00000001, 0x34, 0x12, // LXI B, 0x1234
+            0b00000000,             // NOP
+        }, -1}},
+        {"alu", {{
+            0b10000000,         // ADD B
+            0b10010001,         // SUB C
+            0b10101010,         // XRA D
+            0b10110011,         // ORA E
+        }, -1}},
+        {"alu-m", {{
+            0b10000110,         // ADD M
+        }, -1}},
+        {"alu-imm", {{
+            0b11000110, 0x03,   // ADI 3
+            0b11010110, 0x01,   // SUI 1
+        }, -1}},
+    };
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> makeProgram(const Workload& workload) {
+        const auto& block = workload.block;
+        std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+        for (size_t i = 0; i < program.size(); ++i) {
+            program[i] = block[i % block.size()];
+        }
+        if (workload.relocate >= 0) {
+            for (size_t base = 0; base < program.size(); base += block.size()) {
+                const size_t operand = base + static_cast<size_t>(workload.relocate);
+                const uint16_t address = static_cast<uint16_t>(base + (program[operand + 1] << 8 | program[operand]));
+                program[operand] = static_cast<uint8_t>(address);
+                program[operand + 1] = static_cast<uint8_t>(address >> 8);
+            }
+        }
+        return program;
+    }
+
+    // Instructions and clock cycles of one pass through a block
+    std::pair<uint64_t, uint64_t> blockTiming(const std::vector<uint8_t>& block) {
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+        for (size_t i = 0; i < block.size(); i += ControlUnit::instructionLength(block[i])) {
+            ++instructions;
+            cycles += ControlUnit::instructionCycles(block[i]);
+        }
+        return {instructions, cycles};
+    }
+
+    // Resident set size of the process now, 0 where it isn't known
+    uint64_t currentRssKb() {
+#if defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        uint64_t size = 0;
+        uint64_t resident = 0;
+        statm >> size >> resident;
+        return resident * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE)) / 1024;
+#elif defined(__APPLE__)
+        mach_task_basic_info info {};
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+            return 0;
+        }
+        return static_cast<uint64_t>(info.resident_size) / 1024;
+#else
+        return 0;
+#endif
+    }
+
+    // Footprint and random access latency of a 64 KB store made of `Cell`s
+    template<typename Cell>
+    void measureStorage(const char* name) {
+        constexpr uint64_t accesses = 1 << 26;
+        std::vector<Cell> store(DEFAULT_MEMORY_SIZE);
+        std::array<uint8_t, DEFAULT_MEMORY_SIZE> image = makeProgram(workloads.at("mixed"));
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; ++i) {
+            if constexpr (std::is_same_v<Cell, uint8_t>) {
+                std::memcpy(store.data(), image.data(), image.size());
+            } else {
+                std::copy(image.begin(), image.end(), store.begin());
+            }
+            image[i] = static_cast<uint8_t>(store[i]);
+        }
+        const std::chrono::duration<double> load = std::chrono::steady_clock::now() - start;
+
+        // Read-modify-write at pseudo random addresses, every address depends on the previous value
+        uint32_t address = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < accesses; ++i) {
+            address = (address * 1103515245u + 12345u + static_cast<uint8_t>(store[address & 0xFFFF])) & 0xFFFF;
+            store[address] = static_cast<uint8_t>(address);
+        }
+        const std::chrono::duration<double> access = std::chrono::steady_clock::now() - start;
+
+        std::printf("%-12s %12zu %14.2f %16.3f %10s\n", name, store.size() * sizeof(Cell),
+            access.count() / accesses * 1e9, load.count() / 1000 * 1e6, "-");
+    }
+
+    // Startup time, resident pages and RSS growth of memories booting the same 4 KB firmware
+    // from private copies and from one shared image, each variant on memories of its own
+    void measureSharedImages() {
+        using SharedMemory = Memory<DEFAULT_MEMORY_SIZE>;
+        constexpr size_t instances = 256;
+        auto firmware = std::make_shared<std::array<uint8_t, DEFAULT_MEMORY_SIZE>>();
+        for (size_t i = 0; i < 0x1000; ++i) {
+            (*firmware)[i] = static_cast<uint8_t>(i * 7 + 1);
+        }
+
+        std::vector<std::unique_ptr<SharedMemory>> memories;
+        const auto measure = [&](const char* name, const auto& load) {
+            const uint64_t rss = currentRssKb();
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < instances; ++i) {
+                memories.push_back(std::make_unique<SharedMemory>((name + std::to_string(i)).c_str()));
+                memories.back()->mapPages(0x0000, 0x0FFF, SharedMemory::PageType::Rom);
+                load(*memories.back());
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            const uint64_t grown = std::max(currentRssKb(), rss) - rss;
+            std::printf("%-12s %12zu %14s %16.3f %10llu\n", name, memories.back()->residentPages() * SharedMemory::PAGE_SIZE, "-",
+                elapsed.count() / instances * 1e6, static_cast<unsigned long long>(grown));
+        };
+        // Shared first, the heap the private copies free wouldn't be given back to the system
+        measure("shared", [&firmware](SharedMemory& memory) { memory.load(firmware); });
+        measure("private", [&firmware](SharedMemory& memory) { memory.load(*firmware); });
+    }
+
+    struct Sample {
+        std::string workload;
+        std::string mode;
+        double quantum;         // Microseconds, 0 = clocked
+        uint64_t instructions;
+        uint64_t cycles;        // Simulated clock cycles (T-states)
+        double seconds;
+        uint64_t rssGrowth;     // Kilobytes the resident set grew by during the run of this mode
+
+        double mips() const { return instructions / seconds / 1e6; }
+        double mhz() const { return cycles / seconds / 1e6; }
+    };
+
+    // One sample per line, so baselines can be diffed and read back without a JSON library
+    void writeJson(const std::string& path, const std::vector<Sample>& samples) {
+        std::ofstream out(path);
+        if (!out) {
+            throw std::runtime_error("writeJson(): unable to create " + path);
+        }
+        const auto level = spdlog::level::to_string_view(static_cast<spdlog::level::level_enum>(SIM_LOG_ACTIVE_LEVEL));
+        out << "{\n  \"log_level\": \"" << std::string(level.data(), level.size()) << "\",\n  \"samples\": [";
+        const char* separator = "\n";
+        for (const auto& sample : samples) {
+            char line[384];
+            std::snprintf(line, sizeof(line), "%s    {\"workload\": \"%s\", \"mode\": \"%s\", \"quantum_us\": %.3f, "
+                "\"instructions\": %llu, \"cycles\": %llu, \"seconds\": %.6f, \"mips\": %.3f, \"mhz\": %.3f, \"rss_growth_kb\": %llu}",
+                separator, sample.workload.c_str(), sample.mode.c_str(), sample.quantum,
+                static_cast<unsigned long long>(sample.instructions), static_cast<unsigned long long>(sample.cycles),
+                sample.seconds, sample.mips(), sample.mhz(), static_cast<unsigned long long>(sample.rssGrowth));
+            out << line;
+            separator = ",\n";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    // Value of `"key": value` in a line written by writeJson()
+    std::string jsonField(const std::string& line, const std::string& key) {
+        const std::string tag = "\"" + key + "\": ";
+        size_t begin = line.find(tag);
+        if (begin == std::string::npos) {
+            return {};
+        }
+        begin += tag.size();
+        if (line[begin] == '"') {
+            return line.substr(begin + 1, line.find('"', begin + 1) - begin - 1);
+        }
+        return line.substr(begin, line.find_first_of(",}", begin) - begin);
+    }
+
+    struct Baseline {
+        std::string workload;
+        std::string mode;
+        double quantum;
+        double mips;
+    };
+
+    std::vector<Baseline> readBaseline(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("readBaseline(): unable to open " + path);
+        }
+        std::vector<Baseline> baseline;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.find("\"workload\"") != std::string::npos) {
+                baseline.push_back({jsonField(line, "workload"), jsonField(line, "mode"),
+                    std::stod(jsonField(line, "quantum_us")), std::stod(jsonField(line, "mips"))});
+            }
+        }
+        return baseline;
+    }
+
+    // Prints the change against the baseline and returns the number of regressions
+    int compare(const std::vector<Sample>& samples, const std::vector<Baseline>& baseline, double tolerance) {
+        int regressions = 0;
+        std::printf("\n%-12s %-12s %12s %12s %12s %9s\n", "workload", "mode", "quantum(us)", "base MIPS", "MIPS", "change");
+        for (const auto& sample : samples) {
+            const auto match = std::find_if(baseline.begin(), baseline.end(), [&sample](const Baseline& base) {
+                return base.workload == sample.workload && base.mode == sample.mode && std::abs(base.quantum - sample.quantum) < 1e-6;
+            });
+            if (match == baseline.end() || match->mips <= 0.0) {
+                std::printf("%-12s %-12s %12.3f %12s %12.3f %9s\n", sample.workload.c_str(), sample.mode.c_str(),
+                    sample.quantum, "-", sample.mips(), "new");
+                continue;
+            }
+            const double change = (sample.mips() / match->mips - 1.0) * 100.0;
+            const bool regressed = change < -tolerance;
+            regressions += regressed ? 1 : 0;
+            std::printf("%-12s %-12s %12.3f %12.3f %12.3f %+8.1f%%%s\n", sample.workload.c_str(), sample.mode.c_str(),
+                sample.quantum, match->mips, sample.mips(), change, regressed ? "  REGRESSION" : "");
+        }
+        return regressions;
+    }
+}
+
+int sc_main(int argc, char* argv[]) {
+    CLI::App app {"Intel 8080 Simulator Benchmarks"};
+
+    std::vector<std::string> names;
+    for (const auto& [name, workload] : workloads) {
+        // Every block must end on the wrap-around boundary
+        if (DEFAULT_MEMORY_SIZE % workload.block.size() != 0) {
+            std::fprintf(stderr, "Workload %s doesn't divide the memory size\n", name.c_str());
+            return 1;
+        }
+        names.push_back(name);
+    }
+    std::vector<std::string> modeNames;
+    for (const auto& [name, mode] : modes) {
+        modeNames.push_back(name);
+    }
+
+    std::vector<std::string> selected = {"arith", "fill", "alu-chain", "mvi-kernel"};
+    app.add_option("-w,--workloads", selected, "Workloads to measure")
+        ->check(CLI::IsMember(names))
+        ->capture_default_str();
+
+    std::vector<std::string> selectedModes = {"pins", "tlm", "dmi", "block-cache", "functional", "jit"};
+    app.add_option("--modes", selectedModes, "Execution modes to measure")
+        ->check(CLI::IsMember(modeNames))
+        ->capture_default_str();
+
+    std::vector<double> quanta = {0.0, 50.0};
+    app.add_option("-q,--quanta", quanta, "Temporal decoupling quanta of the SystemC modes in microseconds (0 = clocked)")
+        ->check(CLI::NonNegativeNumber)
+        ->capture_default_str();
+
+    double simTime = 100.0;
+    app.add_option("-t,--sim-time", simTime, "Simulated time per quantum in milliseconds")
+        ->check(CLI::PositiveNumber)
+        ->capture_default_str();
+
+    double minSeconds = 0.25;
+    app.add_option("--min-time", minSeconds, "Wall time the functional modes repeat the simulated time for, in seconds")
+        ->check(CLI::PositiveNumber)
+        ->capture_default_str();
+
+    std::string jsonPath;
+    app.add_option("--json", jsonPath, "Write the samples as JSON");
+
+    std::string baselinePath;
+    app.add_option("--baseline", baselinePath, "Compare the MIPS with a file written by --json, exits with 2 on regressions")
+        ->check(CLI::ExistingFile);
+
+    double tolerance = 10.0;
+    app.add_option("--tolerance", tolerance, "MIPS drop against the baseline in percent that counts as a regression")
+        ->check(CLI::NonNegativeNumber)
+        ->capture_default_str();
+
+    // The sequencer and the register access are fixed when the processor is built, compare them with separate runs
+    ControlUnit::Sequencer sequencer = ControlUnit::Sequencer::Thread;
+    app.add_option("--sequencer", sequencer, "Process of the SystemC control unit (thread, method)")
+        ->transform(CLI::CheckedTransformer(sequencers, CLI::ignore_case));
+
+    ControlUnit::RegisterAccess registerAccess = ControlUnit::RegisterAccess::Pins;
+    app.add_option("--registers", registerAccess, "Register access of the SystemC control unit (pins, direct)")
+        ->transform(CLI::CheckedTransformer(registerAccessModes, CLI::ignore_case));
+
+    bool storage = false;
+    app.add_flag("--storage", storage, "Compare the byte memory store with an sc_uint<8> one and exit");
+
+    CLI11_PARSE(app, argc, argv);
+
+    ConfigureNullLogging();
+
+    if (storage) {
+        std::printf("%-12s %12s %14s %16s %10s\n", "store", "bytes", "access(ns)", "load(us)", "rss(KB)");
+        measureStorage<uint8_t>("uint8_t");
+        measureStorage<sc_dt::sc_uint<8>>("sc_uint<8>");
+        measureSharedImages();
+        return 0;
+    }
+
+    const bool method = sequencer == ControlUnit::Sequencer::Method;
+    const std::string prefix = std::string(method ? "method-" : "")
+        + (registerAccess == ControlUnit::RegisterAccess::Direct ? "direct-" : "");    // Of the SystemC mode names
+    Intel8080 processor("Intel8080", sequencer, registerAccess);
+    const sc_core::sc_time window(simTime, sc_core::SC_MS);
+    const sc_core::sc_time period(0.5, sc_core::SC_US);     // Clock of the Intel8080 module
+    const uint64_t windowCycles = static_cast<uint64_t>(window / period);
+
+    std::vector<Sample> samples;
+    for (const auto& name : selected) {
+        const Workload& workload = workloads.at(name);
+        const auto program = makeProgram(workload);
+
+        for (const auto& modeName : selectedModes) {
+            const Mode& mode = modes.at(modeName);
+
+            // The peak RSS of the process would keep the largest mode measured so far,
+            // the growth of the current RSS is what this mode has added
+            const uint64_t rss = currentRssKb();
+
+            if (mode.functional) {
+                // The same simulated time as a SystemC window, repeated until the run is long enough to time
+                FunctionalEngine engine;
+                engine.setJitEnabled(mode.jit);
+                engine.load(program);
+                const auto [blockInstructions, blockCycles] = blockTiming(workload.block);
+                const uint64_t chunk = windowCycles * blockInstructions / blockCycles;
+
+                const auto start = std::chrono::steady_clock::now();
+                std::chrono::duration<double> elapsed {};
+                do {
+                    engine.run(chunk);
+                    elapsed = std::chrono::steady_clock::now() - start;
+                } while (elapsed.count() < minSeconds);
+
+                samples.push_back({name, modeName, 0.0, engine.instructionCount(), engine.cycleCount(),
+                    elapsed.count(), std::max(currentRssKb(), rss) - rss});
+                continue;
+            }
+            if (method && mode.blockCache) {
+                std::fprintf(stderr, "Skipping %s %s: the method sequencer has no block cache\n", name.c_str(), modeName.c_str());
+                continue;
+            }
+
+            processor.cu.setMemoryAccess(mode.memoryAccess);
+            processor.cu.setDmiEnabled(mode.dmi);
+            processor.cu.setBlockCacheEnabled(mode.blockCache);
+            processor.reset();
+            processor.loadMemory(program);
+
+            for (const double quantum : quanta) {
+                if (method && quantum != 0.0) {
+                    std::fprintf(stderr, "Skipping %s %s at %.3f us: the method sequencer runs clocked\n",
+                        name.c_str(), modeName.c_str(), quantum);
+                    continue;
+                }
+                processor.cu.setQuantum(sc_core::sc_time(quantum, sc_core::SC_US));
+
+                const uint64_t instructions = processor.cu.instructionCount();
+                const uint64_t cycles = processor.cu.cycleCount();
+                const auto start = std::chrono::steady_clock::now();
+                sc_core::sc_start(window);
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                samples.push_back({name, prefix + modeName, quantum, processor.cu.instructionCount() - instructions,
+                    processor.cu.cycleCount() - cycles, elapsed.count(), std::max(currentRssKb(), rss) - rss});
+            }
+        }
+    }
+
+    // Speedup is relative to the first configuration measured for the workload
+    const auto reference = [&samples](const std::string& workload) {
+        for (const auto& sample : samples) {
+            if (sample.workload == workload) {
+                return sample.mips();
+            }
+        }
+        return 0.0;
+    };
+
+    const auto level = spdlog::level::to_string_view(static_cast<spdlog::level::level_enum>(SIM_LOG_ACTIVE_LEVEL));
+    std::printf("log level compiled in: %.*s\n", static_cast<int>(level.size()), level.data());
+    std::printf("%-12s %-12s %12s %14s %10s %10s %10s %10s %8s\n",
+        "workload", "mode", "quantum(us)", "instructions", "wall(s)", "MIPS", "MHz", "+RSS(KB)", "speedup");
+    for (const auto& sample : samples) {
+        std::printf("%-12s %-12s %12.3f %14llu %10.4f %10.3f %10.3f %10llu ", sample.workload.c_str(), sample.mode.c_str(),
+            sample.quantum, static_cast<unsigned long long>(sample.instructions), sample.seconds, sample.mips(), sample.mhz(),
+            static_cast<unsigned long long>(sample.rssGrowth));
+        if (const double mips = reference(sample.workload); mips > 0.0) {
+            std::printf("%7.2fx\n", sample.mips() / mips);
+        } else {
+            std::printf("%8s\n", "-");
+        }
+    }
+
+    try {
+        if (!jsonPath.empty()) {
+            writeJson(jsonPath, samples);
+        }
+        if (!baselinePath.empty() && compare(samples, readBaseline(baselinePath), tolerance) != 0) {
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,401 @@
+//
+//  modules.cpp
+//
+
+#include "alu.hpp"
+#include "memory.hpp"
+#include "mut.hpp"
+#include "reg.hpp"
+#include "regfile.hpp"
+#include "log.hpp"
+
+#include <systemc>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <memory>
+#include <string>
+
+/*
+ * Module Microbenchmarks
+ *
+ * Every module is bound to plain signals and driven from sc_main between
+ * sc_start() calls, without a control unit. An operation writes the input
+ * signals and runs the kernel until no activity is left at the current time,
+ * so the time per operation includes the signal updates, the process
+ * activations and the scheduler, and `deltas` counts the delta cycles it took.
+ * Every benchmark runs with both datatype policies.
+ */
+
+using namespace sim;
+
+namespace {
+    // Runs the delta cycles triggered by the signals written since the last call and returns their number
+    sc_dt::uint64 settle() {
+        const sc_dt::uint64 before = sc_core::sc_delta_count();
+        do {
+            sc_core::sc_start(sc_core::SC_ZERO_TIME);
+        } while (sc_core::sc_pending_activity_at_current_time());
+        return sc_core::sc_delta_count() - before;
+    }
+
+    void reportDeltas(benchmark::State& state, sc_dt::uint64 deltas) {
+        state.counters["deltas"] = benchmark::Counter(static_cast<double>(deltas), benchmark::Counter::kAvgIterations);
+    }
+
+    // Module names must be unique, the policy name tells the instances apart
+    template<typename Types> constexpr const char* policyName = "Native";
+    template<> constexpr const char* policyName<BitAccurateTypes> = "BitAccurate";
+
+    std::string moduleName(const char* module, const char* policy) {
+        return std::string(module) + policy;
+    }
+
+    template<typename Types>
+    struct AluBench {
+        BasicALU<Types> alu {moduleName("ALU", policyName<Types>).c_str()};
+        sc_core::sc_signal<typename Types::Byte> accumulator;
+        sc_core::sc_signal<typename Types::Byte> operand;
+        sc_core::sc_signal<typename Types::Opcode> opcode;
+        sc_core::sc_signal<typename Types::Byte> result;
+        sc_core::sc_signal<typename Types::Flags> flags;
+
+        AluBench() {
+            alu.accumulator(accumulator);
+            alu.operand(operand);
+            alu.opcode(opcode);
+            alu.result(result);
+            alu.flags(flags);
+        }
+    };
+
+    // The target socket of the memory must be bound
+    class MemoryInitiator final : public sc_core::sc_module {
+    public:
+        tlm_utils::simple_initiator_socket<MemoryInitiator> socket {"socket"};
+
+        MemoryInitiator(sc_core::sc_module_name name) : sc_core::sc_module(name) {}
+    };
+
+    template<typename Types>
+    struct MemoryBench {
+        Memory<DEFAULT_MEMORY_SIZE, Types> memory {moduleName("Memory", policyName<Types>).c_str()};
+        MemoryInitiator initiator {moduleName("MemoryInitiator", policyName<Types>).c_str()};
+        sc_core::sc_signal<typename Types::Address> address;
+        sc_core::sc_signal<typename Types::Byte> dataIn;
+        sc_core::sc_signal<typename Types::Byte> dataOut;
+        sc_core::sc_signal<bool> read;
+        sc_core::sc_signal<bool> write;
+
+        MemoryBench() {
+            memory.addressBus(address);
+            memory.dataBusIn(dataIn);
+            memory.dataBusOut(dataOut);
+            memory.readEnable(read);
+            memory.writeEnable(write);
+            initiator.socket.bind(memory.socket);
+        }
+    };
+
+    template<typename Types>
+    struct MultiplexerBench {
+        BasicMultiplexer<Types> mux {moduleName("Multiplexer", policyName<Types>).c_str()};
+        sc_core::sc_signal<typename Types::Byte> select;
+        sc_core::sc_signal<typename Types::Byte> input;
+        sc_core::sc_signal<typename Types::Byte> output;
+        sc_core::sc_signal<bool> writeEnable;
+        sc_core::sc_signal<bool> readEnable;
+        std::array<sc_core::sc_signal<typename Types::Byte>, 7> registerOutputs;   // Indexed by SELECT_REG_*
+        std::array<sc_core::sc_signal<typename Types::Byte>, 7> registerInputs;
+        std::array<sc_core::sc_signal<bool>, 7> registerWriteEnables;
+
+        MultiplexerBench() {
+            mux.select(select);
+            mux.input(input);
+            mux.output(output);
+            mux.writeEnable(writeEnable);
+            mux.readEnable(readEnable);
+            mux.inputA(registerOutputs[SELECT_REG_A]);
+            mux.inputB(registerOutputs[SELECT_REG_B]);
+            mux.inputC(registerOutputs[SELECT_REG_C]);
+            mux.inputD(registerOutputs[SELECT_REG_D]);
+            mux.inputE(registerOutputs[SELECT_REG_E]);
+            mux.inputH(registerOutputs[SELECT_REG_H]);
+            mux.inputL(registerOutputs[SELECT_REG_L]);
+            mux.outputA(registerInputs[SELECT_REG_A]);
+            mux.outputB(registerInputs[SELECT_REG_B]);
+            mux.outputC(registerInputs[SELECT_REG_C]);
+            mux.outputD(registerInputs[SELECT_REG_D]);
+            mux.outputE(registerInputs[SELECT_REG_E]);
+            mux.outputH(registerInputs[SELECT_REG_H]);
+            mux.outputL(registerInputs[SELECT_REG_L]);
+            for (size_t i = 0; i < registerWriteEnables.size(); ++i) {
+                mux.regWriteEnable[i](registerWriteEnables[i]);
+            }
+        }
+    };
+
+    template<typename Types>
+    struct RegisterBench {
+        BasicRegister<Types> reg {moduleName("Register", policyName<Types>).c_str()};
+        sc_core::sc_signal<bool> writeEnable;
+        sc_core::sc_signal<typename Types::Byte> dataIn;
+        sc_core::sc_signal<typename Types::Byte> dataOut;
+
+        RegisterBench() {
+            reg.writeEnable(writeEnable);
+            reg.dataIn(dataIn);
+            reg.dataOut(dataOut);
+        }
+    };
+
+    template<typename Types>
+    struct RegisterFileBench {
+        BasicRegisterFile<Types> file {moduleName("RegisterFile", policyName<Types>).c_str()};
+        sc_core::sc_signal<typename Types::Byte> select;
+        sc_core::sc_signal<typename Types::Byte> input;
+        sc_core::sc_signal<typename Types::Byte> output;
+        sc_core::sc_signal<bool> writeEnable;
+        sc_core::sc_signal<bool> readEnable;
+
+        RegisterFileBench() {
+            file.select(select);
+            file.input(input);
+            file.output(output);
+            file.writeEnable(writeEnable);
+            file.readEnable(readEnable);
+        }
+    };
+
+    // All modules have to exist before the first sc_start()
+    template<typename Types> std::unique_ptr<AluBench<Types>> aluBench;
+    template<typename Types> std::unique_ptr<MemoryBench<Types>> memoryBench;
+    template<typename Types> std::unique_ptr<MultiplexerBench<Types>> multiplexerBench;
+    template<typename Types> std::unique_ptr<RegisterBench<Types>> registerBench;
+    template<typename Types> std::unique_ptr<RegisterFileBench<Types>> registerFileBench;
+
+    template<typename Types>
+    void createBenches() {
+        aluBench<Types> = std::make_unique<AluBench<Types>>();
+        memoryBench<Types> = std::make_unique<MemoryBench<Types>>();
+        multiplexerBench<Types> = std::make_unique<MultiplexerBench<Types>>();
+        registerBench<Types> = std::make_unique<RegisterBench<Types>>();
+        registerFileBench<Types> = std::make_unique<RegisterFileBench<Types>>();
+    }
+}
+
+// MARK: - ALU
+
+// New operands every iteration, a signal written with its current value doesn't notify
+template<typename Types>
+static void BM_AluAdd(benchmark::State& state) {
+    AluBench<Types>& bench = *aluBench<Types>;
+    bench.opcode.write(ALU::OP_ADD);
+    settle();
+    sc_dt::uint64 deltas = 0;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        bench.accumulator.write(++value);
+        bench.operand.write(static_cast<uint8_t>(value ^ 0x5A));
+        deltas += settle();
+        benchmark::DoNotOptimize(bench.result.read());
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_AluAdd, NativeTypes);
+BENCHMARK_TEMPLATE(BM_AluAdd, BitAccurateTypes);
+
+template<typename Types>
+static void BM_AluOpcode(benchmark::State& state) {
+    AluBench<Types>& bench = *aluBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint8_t opcode = 0;
+    for (auto _ : state) {
+        opcode = (opcode + 1) & 0b0111;     // ADD ... CMP
+        bench.opcode.write(opcode);
+        deltas += settle();
+        benchmark::DoNotOptimize(bench.flags.read());
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_AluOpcode, NativeTypes);
+BENCHMARK_TEMPLATE(BM_AluOpcode, BitAccurateTypes);
+
+// MARK: - Memory
+
+template<typename Types>
+static void BM_MemoryRead(benchmark::State& state) {
+    MemoryBench<Types>& bench = *memoryBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint16_t address = 0;
+    for (auto _ : state) {
+        bench.address.write(address++);
+        bench.read.write(true);
+        deltas += settle();
+        bench.read.write(false);
+        deltas += settle();
+        benchmark::DoNotOptimize(bench.dataOut.read());
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_MemoryRead, NativeTypes);
+BENCHMARK_TEMPLATE(BM_MemoryRead, BitAccurateTypes);
+
+template<typename Types>
+static void BM_MemoryWrite(benchmark::State& state) {
+    MemoryBench<Types>& bench = *memoryBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint16_t address = 0;
+    for (auto _ : state) {
+        bench.address.write(address);
+        bench.dataIn.write(static_cast<uint8_t>(address++));
+        bench.write.write(true);
+        deltas += settle();
+        bench.write.write(false);
+        deltas += settle();
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_MemoryWrite, NativeTypes);
+BENCHMARK_TEMPLATE(BM_MemoryWrite, BitAccurateTypes);
+
+// MARK: - Multiplexer
+
+template<typename Types>
+static void BM_MultiplexerWrite(benchmark::State& state) {
+    MultiplexerBench<Types>& bench = *multiplexerBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        ++value;
+        bench.select.write(value % 7);
+        bench.input.write(value);
+        bench.writeEnable.write(true);
+        deltas += settle();
+        bench.writeEnable.write(false);
+        deltas += settle();
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_MultiplexerWrite, NativeTypes);
+BENCHMARK_TEMPLATE(BM_MultiplexerWrite, BitAccurateTypes);
+
+template<typename Types>
+static void BM_MultiplexerRead(benchmark::State& state) {
+    MultiplexerBench<Types>& bench = *multiplexerBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        ++value;
+        bench.select.write(value % 7);
+        bench.registerOutputs[value % 7].write(value);
+        bench.readEnable.write(true);
+        deltas += settle();
+        bench.readEnable.write(false);
+        deltas += settle();
+        benchmark::DoNotOptimize(bench.output.read());
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_MultiplexerRead, NativeTypes);
+BENCHMARK_TEMPLATE(BM_MultiplexerRead, BitAccurateTypes);
+
+// A register output changing while the multiplexer is idle still runs the selector,
+// the price of having every register output in its sensitivity list
+template<typename Types>
+static void BM_MultiplexerFanOut(benchmark::State& state) {
+    MultiplexerBench<Types>& bench = *multiplexerBench<Types>;
+    bench.writeEnable.write(false);
+    bench.readEnable.write(false);
+    settle();
+    sc_dt::uint64 deltas = 0;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        ++value;
+        bench.registerOutputs[value % 7].write(value);
+        deltas += settle();
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_MultiplexerFanOut, NativeTypes);
+BENCHMARK_TEMPLATE(BM_MultiplexerFanOut, BitAccurateTypes);
+
+// MARK: - Register
+
+template<typename Types>
+static void BM_RegisterWrite(benchmark::State& state) {
+    RegisterBench<Types>& bench = *registerBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        bench.dataIn.write(++value);
+        bench.writeEnable.write(true);
+        deltas += settle();
+        bench.writeEnable.write(false);
+        deltas += settle();
+        benchmark::DoNotOptimize(bench.dataOut.read());
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_RegisterWrite, NativeTypes);
+BENCHMARK_TEMPLATE(BM_RegisterWrite, BitAccurateTypes);
+
+// MARK: - Register file
+
+// A register write and a read back through the handshake of the control unit
+template<typename Types>
+static void BM_RegisterFilePins(benchmark::State& state) {
+    RegisterFileBench<Types>& bench = *registerFileBench<Types>;
+    sc_dt::uint64 deltas = 0;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        ++value;
+        bench.select.write(value % 7);
+        bench.input.write(value);
+        bench.writeEnable.write(true);
+        deltas += settle();
+        bench.writeEnable.write(false);
+        bench.readEnable.write(true);
+        deltas += settle();
+        bench.readEnable.write(false);
+        deltas += settle();
+        benchmark::DoNotOptimize(bench.output.read());
+    }
+    reportDeltas(state, deltas);
+}
+BENCHMARK_TEMPLATE(BM_RegisterFilePins, NativeTypes);
+BENCHMARK_TEMPLATE(BM_RegisterFilePins, BitAccurateTypes);
+
+// The same through RegisterFileInterface
+template<typename Types>
+static void BM_RegisterFileDirect(benchmark::State& state) {
+    RegisterFileInterface& file = registerFileBench<Types>->file;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        ++value;
+        file.write(value % 7, value);
+        benchmark::DoNotOptimize(file.read(value % 7));
+    }
+    reportDeltas(state, 0);
+}
+BENCHMARK_TEMPLATE(BM_RegisterFileDirect, NativeTypes);
+BENCHMARK_TEMPLATE(BM_RegisterFileDirect, BitAccurateTypes);
+
+int sc_main(int argc, char* argv[]) {
+    ConfigureNullLogging();
+
+    createBenches<NativeTypes>();
+    createBenches<BitAccurateTypes>();
+    settle();   // Elaboration and initialization
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    sc_core::sc_stop();
+    return 0;
+}
@@ -24,6 +24,12 @@ class AllAction(Action):
             action="store_true",
             help="configure test target",
         )
+        subparser.add_argument(
+            "-wb",
+            "--with-benchmarks",
+            action="store_true",
+            help="configure benchmark target",
+        )
         subparser.add_argument(
             "-v",
             "--verbose",
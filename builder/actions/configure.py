@@ -42,6 +42,12 @@ class ConfigureAction(Action):
             action="store_true",
             help="configure test target",
         )
+        subparser.add_argument(
+            "-wb",
+            "--with-benchmarks",
+            action="store_true",
+            help="configure benchmark target",
+        )
         subparser.add_argument(
             "-v",
             "--verbose",
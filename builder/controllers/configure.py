@@ -10,6 +10,7 @@ class ConfigureController(object):
         "build_folder",
         "toolchain_path",
         "with_tests",
+        "with_benchmarks",
         "verbose",
     ]
 
@@ -23,5 +24,6 @@ class ConfigureController(object):
             self.build_folder,
             self.toolchain_path,
             self.with_tests,
+            self.with_benchmarks,
             self.verbose,
         )
@@ -9,14 +9,23 @@ class Cmake(Wrapper):
         super(Cmake, self).__init__("cmake")
 
     def configure(
-        self, build_type, build_folder, toolchain_path, with_tests, verbose, env=None
+        self,
+        build_type,
+        build_folder,
+        toolchain_path,
+        with_tests,
+        with_benchmarks,
+        verbose,
+        env=None,
     ):
         enable_testing = "ON" if with_tests else "OFF"
+        enable_benchmarks = "ON" if with_benchmarks else "OFF"
         cmd = [
             self.executable,
             "-DCMAKE_EXPORT_COMPILE_COMMANDS=ON",
             f"-DCMAKE_TOOLCHAIN_FILE={toolchain_path}",
             f"-DENABLE_TESTING={enable_testing}",
+            f"-DENABLE_BENCHMARKS={enable_benchmarks}",
             f"-DCMAKE_BUILD_TYPE={build_type}",
         ]
         if verbose:
@@ -22,7 +22,7 @@ class Conan(Wrapper):
         )
 
     def install_dependencies(
-        self, host_profile, build_profile, install_folder, with_tests
+        self, host_profile, build_profile, install_folder, with_tests, with_benchmarks
     ):
         exec(
             [
@@ -32,12 +32,16 @@ class Conan(Wrapper):
                 "--update",
                 f"--output-folder={install_folder}",
                 "--deployer=conan/licenses",
-                *self.__get_configuration_args(host_profile, build_profile, with_tests),
+                *self.__get_configuration_args(
+                    host_profile, build_profile, with_tests, with_benchmarks
+                ),
             ],
             check=True,
         )
 
-    def __get_configuration_args(self, host_profile, build_profile, with_tests=False):
+    def __get_configuration_args(
+        self, host_profile, build_profile, with_tests=False, with_benchmarks=False
+    ):
         args = [
             f"--profile:host={host_profile}",
             f"--profile:build={build_profile}",
@@ -50,4 +54,11 @@ class Conan(Wrapper):
                     "simulator-intel-8080/*:enable_testing=True",
                 ]
             )
+        if with_benchmarks:
+            args.extend(
+                [
+                    "-o",
+                    "simulator-intel-8080/*:enable_benchmarks=True",
+                ]
+            )
         return args
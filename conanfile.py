@@ -14,8 +14,8 @@ class SimulatorIntel8080Recipe(ConanFile):
     topics = ("intel8080", "simulator")
     settings = "os", "compiler", "build_type", "arch"
     generators = "CMakeToolchain", "CMakeDeps", "VirtualBuildEnv"
-    options = {"enable_testing": [True, False]}
-    default_options = {"enable_testing": False}
+    options = {"enable_testing": [True, False], "enable_benchmarks": [True, False]}
+    default_options = {"enable_testing": False, "enable_benchmarks": False}
     requires = (
         "cli11/[^2.3.2]",
         "spdlog/[^1.11.0]",
@@ -25,6 +25,8 @@ class SimulatorIntel8080Recipe(ConanFile):
         "include/**",
         "src/**",
         "tests/**",
+        "bench/**",
+        "tools/**",
         "CMakeLists.txt",
         "version",
         "LICENSE",
@@ -37,6 +39,8 @@ class SimulatorIntel8080Recipe(ConanFile):
     def build_requirements(self):
         if self.options.enable_testing:
             self.test_requires("gtest/[^1.13.0]")
+        if self.options.enable_benchmarks:
+            self.test_requires("benchmark/[^1.8.3]")
 
     def validate(self):
         check_min_cppstd(self, 17)
@@ -49,6 +53,7 @@ class SimulatorIntel8080Recipe(ConanFile):
         cmake.configure(
             {
                 "ENABLE_TESTING": self.options.enable_testing,
+                "ENABLE_BENCHMARKS": self.options.enable_benchmarks,
             }
         )
         cmake.build()
@@ -68,6 +73,14 @@ class SimulatorIntel8080Recipe(ConanFile):
             build_folder,
             os.path.join(self.package_folder, "bin"),
         )
+        copy(
+            self,
+            f"{self.name}-trace{bin_ext}",
+            os.path.join(build_folder, "tools")
+            if self.settings.os != "Windows"
+            else os.path.join(self.build_folder, "tools", str(self.settings.build_type)),
+            os.path.join(self.package_folder, "bin"),
+        )
         copy(
             self,
             "LICENSE",
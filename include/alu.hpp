@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include "alutable.hpp"
+#include "datatypes.hpp"
+
 #include <systemc>
 
 namespace sim {
@@ -25,34 +28,37 @@ namespace sim {
  *
  * (arg is a value from a register or memory or and immediate value)
  */
-class ALU final : sc_core::sc_module {
+template<typename Types>
+class BasicALU final : sc_core::sc_module {
 
 public:
-    static const uint8_t OP_ADD; // ADD ; A ← A + B
-    static const uint8_t OP_ADC; // ADC ; A ← A + B + Cy
-    static const uint8_t OP_SUB; // SUB ; A ← A - B
-    static const uint8_t OP_SBB; // SBB ; A ← A - B - Cy
-    static const uint8_t OP_ANA; // ANA ; A ← A ∧ B
-    static const uint8_t OP_XRA; // XRA ; A ← A ⊻ B
-    static const uint8_t OP_ORA; // ORA ; A ← A ∨ B
-    static const uint8_t OP_CMP; // CMP ; A - B
-
-    static const uint8_t FLAG_IDX_ZERO;
-    static const uint8_t FLAG_IDX_CARRY;
-    static const uint8_t FLAG_IDX_SIGN;
-    static const uint8_t FLAG_IDX_PARITY;
-    static const uint8_t FLAG_IDX_AUX_CARRY;
+    static constexpr uint8_t OP_ADD = alu::OP_ADD; // ADD ; A ← A + B
+    static constexpr uint8_t OP_ADC = alu::OP_ADC; // ADC ; A ← A + B + Cy
+    static constexpr uint8_t OP_SUB = alu::OP_SUB; // SUB ; A ← A - B
+    static constexpr uint8_t OP_SBB = alu::OP_SBB; // SBB ; A ← A - B - Cy
+    static constexpr uint8_t OP_ANA = alu::OP_ANA; // ANA ; A ← A ∧ B
+    static constexpr uint8_t OP_XRA = alu::OP_XRA; // XRA ; A ← A ⊻ B
+    static constexpr uint8_t OP_ORA = alu::OP_ORA; // ORA ; A ← A ∨ B
+    static constexpr uint8_t OP_CMP = alu::OP_CMP; // CMP ; A - B
+
+    static constexpr uint8_t FLAG_IDX_ZERO = alu::FLAG_IDX_ZERO;
+    static constexpr uint8_t FLAG_IDX_CARRY = alu::FLAG_IDX_CARRY;
+    static constexpr uint8_t FLAG_IDX_SIGN = alu::FLAG_IDX_SIGN;
+    static constexpr uint8_t FLAG_IDX_PARITY = alu::FLAG_IDX_PARITY;
+    static constexpr uint8_t FLAG_IDX_AUX_CARRY = alu::FLAG_IDX_AUX_CARRY;
     
     // Ports
-    sc_core::sc_in<sc_dt::sc_uint<8>>  accumulator;    // 8-bit input (operand A)
-    sc_core::sc_in<sc_dt::sc_uint<8>>  operand;        // 8-bit input (operand B)
-    sc_core::sc_in<sc_dt::sc_uint<4>>  opcode;         // Control signal for operation
-    sc_core::sc_out<sc_dt::sc_uint<8>> result;         // 8-bit output
-    sc_core::sc_out<sc_dt::sc_uint<5>> flags;          // 5-bit flag output (zero, carry, sign, parity, and auxiliary carry)
+    sc_core::sc_in<typename Types::Byte>    accumulator;    // 8-bit input (operand A)
+    sc_core::sc_in<typename Types::Byte>    operand;        // 8-bit input (operand B)
+    sc_core::sc_in<typename Types::Opcode>  opcode;         // Control signal for operation
+    sc_core::sc_out<typename Types::Byte>   result;         // 8-bit output
+    sc_core::sc_out<typename Types::Flags>  flags;          // 5-bit flag output (zero, carry, sign, parity, and auxiliary carry)
 
     void execute();
 
-    ALU(sc_core::sc_module_name name);
+    BasicALU(sc_core::sc_module_name name);
 };
 
+using ALU = BasicALU<DefaultTypes>;
+
 } // namespace sim
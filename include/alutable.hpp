@@ -0,0 +1,132 @@
+//
+//  alutable.hpp
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace sim::alu {
+
+/*
+ * Precomputed ALU arithmetic shared by the SystemC ALU and the fast engines.
+ *
+ * A dense table indexed by (opcode, accumulator, operand, carry-in) would take
+ * 2 MB and exceed the constexpr evaluation limits of the compilers, so it is
+ * factored instead: every operation is reduced to a 9-bit raw value whose bit 8
+ * is the carry (borrow for subtractions), and a single 512-entry table gives the
+ * Z, C, S and P flags for it. The per-opcode table keeps the flags an operation
+ * leaves untouched (ADC keeps AC, undefined opcodes keep everything).
+ */
+
+// Same values as ALU::OP_*
+constexpr uint8_t OP_ADD = 0b00000000;
+constexpr uint8_t OP_ADC = 0b00000001;
+constexpr uint8_t OP_SUB = 0b00000010;
+constexpr uint8_t OP_SBB = 0b00000011;
+constexpr uint8_t OP_ANA = 0b00000100;
+constexpr uint8_t OP_XRA = 0b00000101;
+constexpr uint8_t OP_ORA = 0b00000110;
+constexpr uint8_t OP_CMP = 0b00000111;
+constexpr uint8_t OP_COUNT = 16;            // The opcode port is 4 bits wide
+
+// Same values as ALU::FLAG_IDX_*
+constexpr uint8_t FLAG_IDX_ZERO = 0;
+constexpr uint8_t FLAG_IDX_CARRY = 1;
+constexpr uint8_t FLAG_IDX_SIGN = 2;
+constexpr uint8_t FLAG_IDX_PARITY = 3;
+constexpr uint8_t FLAG_IDX_AUX_CARRY = 4;
+
+constexpr uint8_t FLAG_ZERO      = 1 << FLAG_IDX_ZERO;
+constexpr uint8_t FLAG_CARRY     = 1 << FLAG_IDX_CARRY;
+constexpr uint8_t FLAG_SIGN      = 1 << FLAG_IDX_SIGN;
+constexpr uint8_t FLAG_PARITY    = 1 << FLAG_IDX_PARITY;
+constexpr uint8_t FLAG_AUX_CARRY = 1 << FLAG_IDX_AUX_CARRY;
+constexpr uint8_t FLAG_ALL       = FLAG_ZERO | FLAG_CARRY | FLAG_SIGN | FLAG_PARITY | FLAG_AUX_CARRY;
+
+struct Output {
+    uint8_t result;
+    uint8_t flags;
+};
+
+namespace detail {
+
+constexpr std::array<uint8_t, 512> MakeFlagTable() {
+    std::array<uint8_t, 512> table {};
+    for (unsigned raw = 0; raw < table.size(); ++raw) {
+        const uint8_t value = static_cast<uint8_t>(raw);
+        unsigned bits = 0;
+        for (unsigned i = 0; i < 8; ++i) {
+            bits += (value >> i) & 1;
+        }
+        table[raw] = static_cast<uint8_t>(
+            (value == 0 ? FLAG_ZERO : 0) |
+            ((raw & 0x100) ? FLAG_CARRY : 0) |
+            ((value & 0x80) ? FLAG_SIGN : 0) |
+            ((bits & 1) ? FLAG_PARITY : 0));    // Same as __builtin_parity
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, OP_COUNT> MakeKeptFlagTable() {
+    std::array<uint8_t, OP_COUNT> table {};
+    for (unsigned op = 0; op < table.size(); ++op) {
+        table[op] = op == OP_ADC ? FLAG_AUX_CARRY : (op > OP_CMP ? FLAG_ALL : 0);
+    }
+    return table;
+}
+
+} // namespace detail
+
+// Z, C, S and P of a 9-bit raw result
+inline constexpr std::array<uint8_t, 512> FLAG_TABLE = detail::MakeFlagTable();
+
+// Flags that an opcode doesn't modify
+inline constexpr std::array<uint8_t, OP_COUNT> KEPT_FLAG_TABLE = detail::MakeKeptFlagTable();
+
+// Result and flags of `opcode` for the given inputs; `flags` is the current flag register
+constexpr Output Execute(uint8_t opcode, uint8_t accumulator, uint8_t operand, uint8_t flags) {
+    const unsigned a = accumulator;
+    const unsigned b = operand;
+    const unsigned carry = (flags & FLAG_CARRY) ? 1 : 0;
+    unsigned raw = 0;
+    unsigned aux = 0;
+
+    switch (opcode & (OP_COUNT - 1)) {
+        case OP_ADD:
+            raw = a + b;
+            aux = (a ^ b ^ raw) & FLAG_AUX_CARRY;   // Carry out of bit 3
+            break;
+        case OP_ADC:
+            raw = a + b + carry;
+            break;
+        case OP_SUB:
+        case OP_CMP:
+            raw = (a - b) & 0x1FF;
+            break;
+        case OP_SBB:
+            raw = (a - b - carry) & 0x1FF;
+            break;
+        case OP_ANA:
+            raw = a & b;
+            break;
+        case OP_XRA:
+            raw = a ^ b;
+            break;
+        case OP_ORA:
+            raw = a | b;
+            break;
+        default:
+            break;
+    }
+
+    const uint8_t kept = KEPT_FLAG_TABLE[opcode & (OP_COUNT - 1)];
+    return {
+        // CMP leaves a zero result on the ALU output
+        static_cast<uint8_t>(opcode == OP_CMP ? 0 : raw),
+        static_cast<uint8_t>((flags & kept) | ((FLAG_TABLE[raw] | aux) & ~kept & FLAG_ALL))
+    };
+}
+
+} // namespace sim::alu
@@ -0,0 +1,95 @@
+//
+//  batch.hpp
+//
+
+#pragma once
+
+#include "common.hpp"
+#include "engine.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+/*
+ * Batch Runner
+ *
+ * Runs independent guest programs on the FunctionalEngine with a pool of worker
+ * threads. The programs are dealt round-robin onto one deque per worker. A worker
+ * takes the programs from the back of its own deque and, once that is empty,
+ * steals from the front of the others, so a few long programs don't leave the
+ * rest of the pool idle. Every worker loads its images itself into one engine,
+ * so a manifest of thousands of programs never has all of them in memory.
+ */
+class BatchRunner final {
+
+public:
+    struct Result {
+        size_t index {0};                       // Line of the program in the manifest
+        std::string program;
+        FunctionalEngine::Status status {FunctionalEngine::Status::Running};  // Running if stopped by the limit
+        FunctionalEngine::State state;
+        uint64_t instructions {0};
+        uint64_t cycles {0};
+        uint64_t memoryDigest {0};              // FunctionalEngine::memoryDigest()
+        std::string error;                      // The image couldn't be loaded, the rest is unset
+    };
+
+    struct Stats {
+        uint64_t programs {0};
+        uint64_t steals {0};                    // Programs taken from the deque of another worker
+        double seconds {0.0};
+    };
+
+    using Loader = std::function<std::array<uint8_t, DEFAULT_MEMORY_SIZE>(const std::string& program)>;
+
+    // Called for every finished program on the worker threads, one call at a time
+    using Sink = std::function<void(const Result& result)>;
+
+    // Default of --max-instructions, a program that never halts still ends as running
+    static constexpr uint64_t DEFAULT_MAX_INSTRUCTIONS = 100'000'000;
+
+    // 0 workers is one per hardware thread
+    explicit BatchRunner(unsigned workers = 0);
+
+    unsigned workerCount() const { return workers; }
+
+    // Stops a program after `limit` instructions, it is reported as running then
+    void setMaxInstructions(uint64_t limit);
+
+    // utils::LoadProgram by default
+    void setLoader(Loader programLoader);
+
+    // Runs every program and returns when all of them are done.
+    // Rethrows the first exception thrown by the sink.
+    Stats run(const std::vector<std::string>& programs, const Sink& sink);
+
+    // One image path per line, blank lines and lines starting with '#' are skipped
+    static std::vector<std::string> ReadManifest(std::istream& in);
+
+    // The result as a single line of JSON
+    static void WriteJson(std::ostream& out, const Result& result);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;                // Indexes into the program list
+    };
+
+    bool take(std::vector<WorkQueue>& queues, size_t worker, size_t& job, uint64_t& steals) const;
+    Result execute(FunctionalEngine& engine, size_t index, const std::string& program) const;
+
+    unsigned workers;
+    uint64_t maxInstructions;
+    Loader loader;
+};
+
+} // namespace sim
@@ -6,10 +6,13 @@
 
 #pragma once
 
-#include <systemc>
+#include <cstdint>
+#include <cstddef>
 
 namespace sim {
 
+constexpr uint32_t DEFAULT_MEMORY_SIZE = 65536; // 64 KB
+
 constexpr uint8_t SELECT_REG_A  = 0b00000000;
 constexpr uint8_t SELECT_REG_B  = 0b00000001;
 constexpr uint8_t SELECT_REG_C  = 0b00000010;
@@ -18,4 +21,4 @@ constexpr uint8_t SELECT_REG_E  = 0b00000100;
 constexpr uint8_t SELECT_REG_H  = 0b00000101;
 constexpr uint8_t SELECT_REG_L  = 0b00000110;
 
-}
\ No newline at end of file
+}
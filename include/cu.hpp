@@ -6,9 +6,20 @@
 
 #pragma once
 
-#include "reg.hpp"
+#include "datatypes.hpp"
+#include "regfile.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
 
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/tlm_quantumkeeper.h>
 
 #ifdef ENABLE_TESTING
 #include <mutex>
@@ -16,49 +27,73 @@
 
 namespace sim {
 
-class ControlUnit final : sc_core::sc_module {
+template<typename Types>
+class BasicControlUnit final : sc_core::sc_module {
+
+    using Byte = typename Types::Byte;
+    using Address = typename Types::Address;
 
 public:
-    static const uint8_t OP_REG_B;
-    static const uint8_t OP_REG_C;
-    static const uint8_t OP_REG_D;
-    static const uint8_t OP_REG_E;
-    static const uint8_t OP_REG_H;
-    static const uint8_t OP_REG_L;
-    static const uint8_t OP_REG_M;
-    static const uint8_t OP_MEM;
-    static const uint8_t OP_REG_A;
-
-    static const uint8_t OP_GROUP_DATA_TRANSFER;
-    static const uint8_t OP_GROUP_MOV;      // MOV and HLT (= MOV M,M)
-    static const uint8_t OP_GROUP_ALU;
-    static const uint8_t OP_GROUP_SPECIAL;  // ALU Immediate, Branch, Stack, I/O and Machine Contro
-
-    static const uint8_t OP_RP_BC;
-    static const uint8_t OP_RP_DE;
-    static const uint8_t OP_RP_HL;
-    static const uint8_t OP_RP_SP;
-
-    static const uint8_t OP_INST_NOP;
-    static const uint8_t OP_INST_HLT;
+    enum class MemoryAccess {
+        Pins,           // Address/data buses and the read/write enable handshake
+        Transaction     // TLM-2.0 blocking transport through memorySocket
+    };
+
+    // Process that runs the instructions, fixed at construction
+    enum class Sequencer {
+        Thread,         // SC_THREAD blocking in wait() at every handshake
+        Method          // SC_METHOD state machine re-triggered with next_trigger(), no coroutine stack
+    };
+
+    // Register access, fixed at construction
+    enum class RegisterAccess {
+        Pins,           // MUX select and read/write enable handshake
+        Direct          // RegisterFileInterface calls through registerFile
+    };
+
+    static constexpr uint8_t OP_REG_B = 0b00000000;
+    static constexpr uint8_t OP_REG_C = 0b00000001;
+    static constexpr uint8_t OP_REG_D = 0b00000010;
+    static constexpr uint8_t OP_REG_E = 0b00000011;
+    static constexpr uint8_t OP_REG_H = 0b00000100;
+    static constexpr uint8_t OP_REG_L = 0b00000101;
+    static constexpr uint8_t OP_REG_M = 0b00000110;    // Memory, refers to the address in the HL register pair)
+    static constexpr uint8_t OP_MEM   = 0b00000110;    // Source for MUT that refers to memory
+    static constexpr uint8_t OP_REG_A = 0b00000111;    // Accumulator
+
+    static constexpr uint8_t OP_GROUP_DATA_TRANSFER = 0b00000000;
+    static constexpr uint8_t OP_GROUP_MOV = 0b00000001;        // MOV and HLT (= MOV M,M)
+    static constexpr uint8_t OP_GROUP_ALU = 0b00000010;
+    static constexpr uint8_t OP_GROUP_SPECIAL = 0b00000011;    // ALU Immediate, Branch, Stack, I/O and Machine Contro
+
+    static constexpr uint8_t OP_RP_BC = 0b00000000;
+    static constexpr uint8_t OP_RP_DE = 0b00000001;
+    static constexpr uint8_t OP_RP_HL = 0b00000010;
+    static constexpr uint8_t OP_RP_SP = 0b00000011;
+
+    static constexpr uint8_t OP_INST_NOP = 0b00000000;
+    static constexpr uint8_t OP_INST_HLT = 0b01110110;
 
     sc_core::sc_in<bool> clock;                         // Clock signal
 
     // Ports
-    sc_core::sc_out<sc_dt::sc_uint<8>> aluAccumulator;  // ALU argument 1 (A register)
-    sc_core::sc_out<sc_dt::sc_uint<8>> aluOperand;      // ALU argument 2 (argument)
-    sc_core::sc_out<sc_dt::sc_uint<4>> aluOpcode;       // Operation code to ALU
-    sc_core::sc_in<sc_dt::sc_uint<8>>  aluResult;       // Result from ALU
-    sc_core::sc_in<sc_dt::sc_uint<5>>  aluFlags;        // Input flags from ALU
+    sc_core::sc_out<Byte> aluAccumulator;                   // ALU argument 1 (A register)
+    sc_core::sc_out<Byte> aluOperand;                       // ALU argument 2 (argument)
+    sc_core::sc_out<typename Types::Opcode> aluOpcode;      // Operation code to ALU
+    sc_core::sc_in<Byte>  aluResult;                        // Result from ALU
+    sc_core::sc_in<typename Types::Flags> aluFlags;         // Input flags from ALU
 
     // Bus ports
-    sc_core::sc_out<sc_dt::sc_uint<16>> addressBus;
-    sc_core::sc_out<sc_dt::sc_uint<8>>  dataBusOut;
-    sc_core::sc_in<sc_dt::sc_uint<8>>   dataBusIn;
+    sc_core::sc_out<Address> addressBus;
+    sc_core::sc_out<Byte>    dataBusOut;
+    sc_core::sc_in<Byte>     dataBusIn;
+
+    // Transaction level memory port
+    tlm_utils::simple_initiator_socket<BasicControlUnit> memorySocket;
 
     // MUX ports
-    sc_core::sc_in<sc_dt::sc_uint<8>>  inputMux;       // Input signal from mux
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputMux;      // Output signal
+    sc_core::sc_in<Byte>  inputMux;       // Input signal from mux
+    sc_core::sc_out<Byte> outputMux;      // Output signal
     
     // Control Lines
     sc_core::sc_out<bool> memoryWriteEnable;
@@ -67,26 +102,263 @@ public:
     sc_core::sc_out<bool> muxReadEnable;
 
     // MUX ports
-    sc_core::sc_out<sc_dt::sc_uint<8>> muxSelect;                 // Select signal for multiplexer
+    sc_core::sc_out<Byte> muxSelect;                 // Select signal for multiplexer
+
+    // Direct register access
+    sc_core::sc_port<RegisterFileInterface> registerFile;
 
-    sc_dt::sc_uint<8> readReg(sc_dt::sc_uint<8> source);
-    sc_dt::sc_uint<8> readMemAt(sc_dt::sc_uint<16> address);
-    void writeReg(sc_dt::sc_uint<8> source, sc_dt::sc_uint<8> value);
-    void writeMemAt(sc_dt::sc_uint<16> address, sc_dt::sc_uint<8> value);
-    void waitFor(int);
+    uint8_t readReg(uint8_t source);
+    uint8_t readMemAt(uint16_t address);
+    void writeReg(uint8_t source, uint8_t value);
+    void writeMemAt(uint16_t address, uint8_t value);
+    void waitFor(int deltas);   // Delta cycles, e.g. for the ALU to settle; they take no simulated time
     void execute(); // Method to manage the control logic
 
-    ControlUnit(sc_core::sc_module_name name);
+    BasicControlUnit(sc_core::sc_module_name name, Sequencer sequencer = Sequencer::Thread,
+                     RegisterAccess registerAccess = RegisterAccess::Pins);
+
+    Sequencer getSequencer() const;
+    RegisterAccess getRegisterAccess() const;
 
     void reset();
+
+    void setMemoryAccess(MemoryAccess access);
+    MemoryAccess getMemoryAccess() const;
+
+    // Use Direct Memory Interface pointers granted by the memory in the Transaction mode
+    void setDmiEnabled(bool enabled);
+
+    // Temporal decoupling: with a non-zero quantum the control unit stops waiting for every
+    // clock edge and runs ahead of the kernel by up to `quantum` of local time before it syncs.
+    // SC_ZERO_TIME restores the clocked mode.
+    // Throws std::runtime_error for a non-zero quantum with the method sequencer.
+    void setQuantum(const sc_core::sc_time& quantum);
+
+    // Forces a sync with the kernel at the end of the current instruction
+    void requestSync();
+
+    // HLT and unimplemented opcodes end the simulation with sc_stop() (default). Otherwise they
+    // pause the kernel with sc_pause() and the control unit idles until reset(), so a process
+    // can run one program after another on the same elaboration.
+    void setStopOnHalt(bool stop);
+    bool isIdle() const;
+
+    // Local time of one T-state when decoupled (the clock period).
+    // The method sequencer needs it to wait for the T-states of an instruction.
+    void setCyclePeriod(const sc_core::sc_time& period);
+
+    uint64_t instructionCount() const;
+
+    // Clock cycles (T-states) of the executed instructions as documented for the Intel 8080.
+    // The clocked mode waits for as many clock edges and the decoupled mode annotates as
+    // many clock periods, so the simulated time advances by cycleCount() * clock period
+    // plus the access delay of the memory.
+    uint64_t cycleCount() const;
+
+    // Bytes and clock cycles (T-states) of an opcode, 1 and 0 for the unimplemented ones
+    static uint8_t instructionLength(uint8_t opcode);
+    static uint8_t instructionCycles(uint8_t opcode);
+
+    struct BlockCacheStats {
+        uint64_t hits {0};
+        uint64_t misses {0};
+        uint64_t invalidations {0};     // Blocks discarded after a write to their page or a memory reload
+    };
+
+    // Executes pre-decoded basic blocks instead of fetching and decoding every instruction.
+    // Writes of the control unit and DMI invalidations from the memory (e.g. loads) discard
+    // the blocks of the affected 256-byte pages.
+    // Throws std::runtime_error when enabled with the method sequencer.
+    void setBlockCacheEnabled(bool enabled);
+    const BlockCacheStats& blockCacheStats() const;
+
+    // Records every executed instruction into `writer` (not owned), nullptr stops tracing
+    void setTraceWriter(TraceWriter* writer);
+
+    Address getPC() const { return pc; }
+    Address getSP() const { return sp; }
+    typename Types::Flags getFlags() const { return flags; }
+
+    // Counts every executed instruction in `guestProfiler` (not owned), nullptr stops profiling
+    void setProfiler(Profiler* guestProfiler);
 private:
-    sc_dt::sc_uint<8> getRegisterValue(uint8_t regCode);
-    void setRegisterValue(uint8_t regCode, sc_dt::sc_uint<8> value);
+    struct Instruction;
+
+    // Instruction handler, called with the decoded instruction
+    using Handler = void (BasicControlUnit::*)(Instruction instruction);
+
+    struct Instruction {
+        Handler handler;
+        uint8_t opcode;
+        uint8_t length;                     // Bytes including the opcode
+        uint8_t cycles;                     // Clock cycles (T-states) on the Intel 8080
+        std::array<uint8_t, 2> operands;    // Immediate data following the opcode
+    };
+
+    // Basic block: straight-line instructions decoded from `start`, ending at HLT,
+    // an unknown opcode, the end of the page or after MAX_BLOCK_INSTRUCTIONS
+    struct Block {
+        uint16_t start;
+        uint16_t end;                       // Address of the last byte
+        std::vector<Instruction> instructions;
+    };
+
+    static constexpr size_t MAX_BLOCK_INSTRUCTIONS = 64;
+    static constexpr unsigned PAGE_SHIFT = 8;   // Invalidation granularity (256 bytes)
+    static constexpr size_t PAGE_COUNT = (1 << 16) >> PAGE_SHIFT;
+
+    // Implemented instructions, the one place opcode bits are classified
+    // for both the dispatch table and the micro-programs
+    enum class InstructionClass : uint8_t {
+        Nop,
+        Mvi,            // MVI ddd,data
+        Lxi,            // LXI rp,data
+        Hlt,
+        Alu,            // ADD ... CMP sss
+        AluImmediate,   // ADI ... CPI data
+        Unknown
+    };
+
+    static constexpr InstructionClass classify(uint8_t opcode);
+
+    // Decoded templates for every opcode, generated at compile time by decode()
+    static const std::array<Instruction, 256> dispatchTable;
+
+    template<uint8_t Opcode>
+    static constexpr Instruction decode();
+    template<size_t... Opcodes>
+    static constexpr std::array<Instruction, 256> makeDispatchTable(std::index_sequence<Opcodes...>);
+
+    Instruction fetch(uint16_t address);
+    void executeBlock();
+    void invalidateBlocks(uint16_t start, uint16_t end);
+
+    void executeNop(Instruction instruction);
+    template<uint8_t Dst> void executeMvi(Instruction instruction);
+    template<uint8_t RegisterPair> void executeLxi(Instruction instruction);
+    void executeHlt(Instruction instruction);
+    template<uint8_t Op, uint8_t Src> void executeAlu(Instruction instruction);
+    template<uint8_t Op> void executeAluImmediate(Instruction instruction);
+    void trap(Instruction instruction);     // Unimplemented opcode
+    void stop();
+
+    template<uint8_t Reg> uint8_t getRegisterValue();
+    template<uint8_t Reg> void setRegisterValue(uint8_t value);
+    uint8_t transport(tlm::tlm_command command, uint16_t address, uint8_t value);
+    void invalidateDirectMemPtr(sc_dt::uint64 start, sc_dt::uint64 end);
+
+    void synchronize(uint8_t clocks);  // Ends an instruction that took `clocks` T-states
+    void traceInstruction(const Instruction& instruction, uint16_t address);
+    void retire(const Instruction& instruction, uint16_t address);    // Counters, trace and profile of an executed instruction
+
+    // Method sequencer: every instruction is fetched over the bus and then runs a
+    // micro-program of register, memory and ALU accesses. A bus handshake that the
+    // thread waits a delta cycle for ends the activation with next_trigger(SC_ZERO_TIME)
+    // and continues in the same phase on the next one.
+    enum class Stage : uint8_t {
+        Start,
+        Reset,          // Testing: clears the registers after reset()
+        Fetch,          // Opcode and operands
+        Execute,        // Micro-program of the opcode
+        Delay,          // Memory access delay of the instruction
+        Clocks          // T-states of the instruction after the delay
+    };
+
+    enum class MicroKind : uint8_t {
+        ReadRegister,   // latches[latch] <- register `select`
+        ReadMemory,     // latches[latch] <- memory at HIGH:LOW
+        WriteRegister,  // register `select` <- latches[latch]
+        WriteMemory,    // memory at HIGH:LOW <- latches[latch]
+        Alu,            // ACCUMULATOR <- ACCUMULATOR `select` latches[latch], flags
+        LoadStackPointer,
+        Halt,
+        Trap
+    };
+
+    enum Latch : uint8_t {
+        LATCH_ACCUMULATOR,
+        LATCH_OPERAND,
+        LATCH_HIGH,
+        LATCH_LOW,
+        LATCH_IMMEDIATE_LOW,    // First operand byte of the instruction
+        LATCH_IMMEDIATE_HIGH,
+        LATCH_COUNT
+    };
+
+    struct MicroOp {
+        MicroKind kind;
+        uint8_t select;         // SELECT_REG_* or ALU operation
+        uint8_t latch;
+    };
+
+    struct MicroProgram {
+        std::array<MicroOp, 6> ops;
+        uint8_t size;
+    };
+
+    // Micro-programs for every opcode, the counterpart of dispatchTable
+    static const std::array<MicroProgram, 256> microPrograms;
+    static MicroProgram microDecode(uint8_t opcode);
+
+    void sequence();
+    bool microStep(const MicroOp& op);
+
+    // One phase of a handshake per call, true when the access is complete
+    bool readMemPhase(uint16_t address, uint8_t& value);
+    bool writeMemPhase(uint16_t address, uint8_t value);
+    bool readRegPhase(uint8_t select, uint8_t& value);
+    bool writeRegPhase(uint8_t select, uint8_t value);
+    bool aluPhase(uint8_t operation, uint8_t operand);
+
+    Sequencer sequencer;
+    RegisterAccess registerAccess;
+    Stage stage;
+    uint8_t phase;                  // Of the current handshake
+    uint8_t fetched;                // Instruction bytes read so far
+    uint8_t step;                   // Next micro-op, next register while resetting
+    uint8_t pendingClocks;          // T-states left to wait after a memory access delay
+    bool stopped;                   // HLT or trap, PC stays
+    uint16_t instructionAddress;
+    Instruction current;
+    std::array<uint8_t, LATCH_COUNT> latches;
+
+    MemoryAccess memoryAccess;
+    tlm::tlm_generic_payload payload;
+    tlm_utils::tlm_quantumkeeper quantumKeeper;     // Local time annotated by instructions and memory transactions
+
+    bool stopOnHalt;
+    bool idle;                      // Halted without sc_stop(), until reset()
+
+    bool decoupled;
+    bool quantumChanged;
+    bool syncRequested;
+    sc_core::sc_time cyclePeriod;
+    uint64_t instructions;
+    uint64_t cycles;
+
+    // Regions granted by the memory, e.g. a read-only one for ROM and a read-write one for RAM
+    static constexpr size_t DMI_REGIONS = 4;
+    std::array<tlm::tlm_dmi, DMI_REGIONS> dmiRegions;
+    std::array<bool, DMI_REGIONS> dmiValid;
+    size_t dmiNext;                 // Slot replaced by the next grant
+    bool dmiEnabled;
+
+    bool blockCacheEnabled;
+    bool blockInvalidated;          // Set when a block is discarded, stops the running one
+    std::unordered_map<uint16_t, std::shared_ptr<const Block>> blocks;  // Keyed by start address
+    std::array<std::vector<uint16_t>, PAGE_COUNT> pageBlocks; // Start addresses of the blocks overlapping a page
+    BlockCacheStats blockStats;
+
+    TraceWriter* traceWriter;
+    TraceRecord traceRecord;                    // Collects the memory write of the current instruction
+    std::array<uint8_t, 7> traceRegisters;      // Values written to the registers, indexed by SELECT_REG_*
+
+    Profiler* profiler;
 
     // TODO: Convert pc and sp to sc_modules
-    sc_dt::sc_uint<16> pc; // Program counter
-    sc_dt::sc_uint<16> sp; // Stack pointer
-    sc_dt::sc_uint<5> flags;
+    Address pc; // Program counter
+    Address sp; // Stack pointer
+    typename Types::Flags flags;
 
 #ifdef ENABLE_TESTING
 public:
@@ -113,21 +385,24 @@ public:
     void doneResetting() {
         std::lock_guard guard(mutex);
         resetted = false;
+        startTime = sc_core::sc_time_stamp();
     }
 
-    sc_dt::sc_uint<16> getSP() {
-        return sp;
-    }
-
-    sc_dt::sc_uint<16> getPC() {
-        return pc;
+    // Simulation time from the end of reset() to the instruction that halted
+    sc_core::sc_time haltElapsed() {
+        std::lock_guard guard(mutex);
+        return haltTime - startTime;
     }
 
 private:
     bool halted { false };
     bool resetted { false };
+    sc_core::sc_time startTime;
+    sc_core::sc_time haltTime;
     std::mutex mutex;    
 #endif
 };
 
+using ControlUnit = BasicControlUnit<DefaultTypes>;
+
 } // namespace sim
@@ -0,0 +1,50 @@
+//
+//  datatypes.hpp
+//
+
+#pragma once
+
+#include <cstdint>
+#include <systemc>
+
+namespace sim {
+
+/*
+ * Datatype policies of the module ports, signals and internal state
+ *
+ * NativeTypes carries the values in plain integers: the signals compare and copy
+ * them without the sc_uint conversions and the model runs faster.
+ * BitAccurateTypes uses sc_uint of the exact width of every bus, which wraps the
+ * values like the hardware does and shows them bit by bit in a debugger or a VCD.
+ *
+ * The modules are templates over the policy (BasicALU, BasicRegister, ...) and
+ * the usual names are aliases for DefaultTypes: NativeTypes unless the build
+ * defines SIM_BIT_ACCURATE (cmake -DBIT_ACCURATE=ON).
+ */
+struct NativeTypes {
+    using Byte = uint8_t;                   // Data bus, registers and ALU operands
+    using Address = uint16_t;               // Address bus, PC and SP
+    using Opcode = uint8_t;                 // ALU operation (4 bits)
+    using Flags = uint8_t;                  // ALU flags (5 bits)
+};
+
+struct BitAccurateTypes {
+    using Byte = sc_dt::sc_uint<8>;
+    using Address = sc_dt::sc_uint<16>;
+    using Opcode = sc_dt::sc_uint<4>;
+    using Flags = sc_dt::sc_uint<5>;
+};
+
+#ifdef SIM_BIT_ACCURATE
+using DefaultTypes = BitAccurateTypes;
+#else
+using DefaultTypes = NativeTypes;
+#endif
+
+// Value of either policy as a native integer, e.g. for logging and table lookups
+template<typename T>
+inline unsigned ToUnsigned(const T& value) {
+    return static_cast<unsigned>(value);
+}
+
+} // namespace sim
@@ -0,0 +1,109 @@
+//
+//  engine.hpp
+//
+
+#pragma once
+
+#include "common.hpp"
+#include "jit.hpp"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace sim {
+
+/*
+ * Functional Execution Engine
+ *
+ * Pure C++ interpreter for the instruction subset implemented by the ControlUnit.
+ * It keeps the same architectural state (A-L, PC, SP and the 5-bit flags) and
+ * the same instruction semantics as the SystemC Intel8080 model, but executes
+ * directly on plain integers without signals, processes or delta cycles.
+ *
+ * On an unimplemented opcode the engine stops with Status::Trapped and leaves PC
+ * pointing at the offending instruction, as the ControlUnit does.
+ *
+ * With the JIT enabled (Linux x86-64) hot blocks are translated to host code,
+ * the interpreter keeps running cold code, HLT and traps.
+ *
+ * An engine has no shared state, so independent engines can run on different threads.
+ */
+class FunctionalEngine final {
+
+public:
+    // Register codes (SSS/DDD fields of an instruction)
+    static constexpr uint8_t REG_B = 0b00000000;
+    static constexpr uint8_t REG_C = 0b00000001;
+    static constexpr uint8_t REG_D = 0b00000010;
+    static constexpr uint8_t REG_E = 0b00000011;
+    static constexpr uint8_t REG_H = 0b00000100;
+    static constexpr uint8_t REG_L = 0b00000101;
+    static constexpr uint8_t REG_M = 0b00000110;    // Memory at (HL), not a register slot
+    static constexpr uint8_t REG_A = 0b00000111;
+
+    enum class Status {
+        Running,
+        Halted,     // HLT has been executed
+        Trapped     // Unimplemented opcode at PC
+    };
+
+    struct State {
+        std::array<uint8_t, 8> registers {};    // Indexed by register code, the REG_M slot is unused
+        uint16_t pc {0};                        // Program counter
+        uint16_t sp {0};                        // Stack pointer
+        uint8_t flags {0};                      // Flags in the ALU::FLAG_IDX_* layout
+    };
+
+    FunctionalEngine();
+    ~FunctionalEngine();
+
+    void reset();
+
+    void load(const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& data);
+
+    // Executes a single instruction
+    Status step();
+
+    // Executes until the engine halts, traps or `maxInstructions` have been executed.
+    // Returns the number of executed instructions.
+    uint64_t run(uint64_t maxInstructions = std::numeric_limits<uint64_t>::max());
+
+    const State& state() const { return regs; }
+    Status status() const { return current; }
+    uint64_t instructionCount() const { return executed; }
+
+    // Clock cycles (T-states) of the executed instructions, as counted by the ControlUnit
+    uint64_t cycleCount() const { return cycles; }
+
+    uint8_t readMemAt(uint16_t address) const { return memory[address]; }
+
+    // 64-bit FNV-1a hash of the whole memory, compares final images without keeping them
+    uint64_t memoryDigest() const;
+
+    // Returns false if the host doesn't support the JIT, the engine keeps interpreting then
+    bool setJitEnabled(bool enabled);
+    bool isJitEnabled() const { return jit != nullptr; }
+    Jit::Stats jitStats() const;
+
+private:
+    // Interprets until the engine stops, `maxInstructions` have been executed or,
+    // with `blockEnd`, PC leaves the page it started in. Returns the executed count.
+    uint64_t interpret(uint64_t maxInstructions, bool blockEnd);
+    uint64_t runTranslated(Jit::Code code, uint64_t maxInstructions);
+
+    uint8_t getRegisterValue(uint8_t regCode) const;
+    void setRegisterValue(uint8_t regCode, uint8_t value);
+    void executeAlu(uint8_t opcode, uint8_t operand);
+    void trap(uint8_t instruction);
+
+    State regs;
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> memory;
+    Status current;
+    uint64_t executed;
+    uint64_t cycles;
+    std::unique_ptr<Jit> jit;
+};
+
+} // namespace sim
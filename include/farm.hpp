@@ -0,0 +1,119 @@
+//
+//  farm.hpp
+//
+
+#pragma once
+
+#include "batch.hpp"
+#include "common.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+/*
+ * Program Image Store
+ *
+ * Program images in one file descriptor backed by memory: a memfd on Linux, an
+ * unlinked temporary file elsewhere. Images are appended without their trailing
+ * zeros and then mapped read-only, so processes forked afterwards share the
+ * same physical pages instead of each holding a copy.
+ */
+class ImageStore final {
+
+public:
+    ImageStore();
+    ~ImageStore();
+
+    ImageStore(const ImageStore&) = delete;
+    ImageStore& operator=(const ImageStore&) = delete;
+
+    // Throws std::runtime_error after seal() or if the store can't grow
+    void add(const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& image);
+
+    // Maps the images read-only, on Linux also seals the memfd against writes and resizing
+    void seal();
+
+    size_t size() const { return entries.size(); }
+    size_t bytes() const { return length; }
+
+    // The image padded with zeros, valid after seal()
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> image(size_t index) const;
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+    };
+
+    int fd;
+    size_t length;
+    const uint8_t* mapping;
+    std::vector<Entry> entries;
+};
+
+/*
+ * Process Farm
+ *
+ * The SystemC kernel has one simulation context per process, so the model can't be
+ * run on several threads. The farm forks worker processes instead. Each of them
+ * elaborates its own model on the first job it gets and then runs job after job.
+ * The parent hands out one job index at a time over a pipe per worker and collects
+ * the results over another, so the workers stay balanced however long the programs are.
+ * The workers read the images from the ImageStore mapped before the fork.
+ *
+ * The parent must not run other threads when it forks, e.g. the periodic flush of
+ * ConfigureFileLogging(): a worker could inherit a mutex such a thread holds.
+ * See ConfigureForkSafeFileLogging() and setWorkerInit().
+ *
+ * POSIX only: isSupported() is false on other hosts and run() throws there.
+ */
+class ProcessFarm final {
+
+public:
+    // Runs first in every new worker process with the index of its slot, 0 ... workerCount() - 1.
+    // A worker that replaces a killed one gets the same slot.
+    using WorkerInit = std::function<void(unsigned slot)>;
+
+    // Runs in a worker process. `program` of the result is filled in by the parent.
+    using Worker = std::function<BatchRunner::Result(size_t index, const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& image)>;
+
+    struct Stats {
+        uint64_t programs {0};
+        uint64_t failedWorkers {0};     // Exited or crashed before finishing their job
+        uint64_t timedOut {0};          // Jobs whose worker was killed by the job timeout
+        double seconds {0.0};
+    };
+
+    // 0 workers is one per hardware thread
+    explicit ProcessFarm(unsigned workers = 0);
+
+    static bool isSupported();
+
+    unsigned workerCount() const { return workers; }
+
+    // Kills a worker whose job runs longer than `timeout` and forks a new one for the rest.
+    // The job is reported as running with an error. Zero (default) waits as long as it takes.
+    void setJobTimeout(std::chrono::milliseconds timeout) { jobTimeout = timeout; }
+
+    // E.g. to give every worker a log file of its own instead of the parent's.
+    // A worker whose init throws exits and its job is reported with an error.
+    void setWorkerInit(WorkerInit init) { workerInit = std::move(init); }
+
+    // Runs every image of the sealed store, `programs` names them in the results.
+    // The sink is called in the parent, the jobs of a crashed worker are reported with an error.
+    Stats run(const ImageStore& images, const std::vector<std::string>& programs, const Worker& worker,
+              const BatchRunner::Sink& sink);
+
+private:
+    unsigned workers;
+    std::chrono::milliseconds jobTimeout;
+    WorkerInit workerInit;
+};
+
+} // namespace sim
@@ -0,0 +1,117 @@
+//
+//  jit.hpp
+//
+
+#pragma once
+
+#include "common.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace sim {
+
+/*
+ * Dynamic Binary Translator (Linux x86-64)
+ *
+ * Translates hot 8080 basic blocks of the FunctionalEngine into host machine code.
+ * Inside translated code the architectural registers (B-L, A) and the flags live in
+ * host registers r8d-r15d, the ALU flags come from alu::FLAG_TABLE, and a block
+ * jumps straight into the next one once both are translated.
+ *
+ * A block starts where the engine asks for it and ends before HLT or an unknown
+ * opcode (both are left to the interpreter) or at the end of its 256-byte page.
+ * Writes into a page that holds translated code leave the translated code and flush
+ * the whole translation cache. Every exit adds the T-states of the instructions it
+ * has executed, so cycle counts match the interpreter. The code buffer is writable
+ * only while a block is being translated and linked.
+ *
+ * On other hosts isSupported() is false and the engine keeps interpreting.
+ */
+class Jit final {
+
+public:
+    // State exchanged with the translated code. Registers are zero-extended to 32 bits.
+    struct Context {
+        std::array<uint32_t, 8> registers;  // Indexed by register code, the REG_M slot is unused
+        uint32_t flags;
+        uint32_t sp;
+        uint32_t pc;                        // Out: address of the next instruction
+        uint32_t exitReason;                // Out: ExitReason
+        uint32_t writeAddress;              // Out: address written on ExitReason::CodeWrite
+        uint64_t executed;                  // In/out: instruction counter
+        uint64_t cycles;                    // In/out: T-state counter
+        uint64_t limit;                     // Block isn't entered if it would exceed this count
+        uint8_t* memory;
+        const uint8_t* flagTable;
+    };
+
+    enum ExitReason : uint32_t {
+        Leave = 0,          // Next block isn't translated or the budget is exhausted
+        CodeWrite = 1       // Memory of a translated page has been written
+    };
+
+    using Code = const uint8_t*;
+
+    struct Stats {
+        uint64_t translations {0};      // Translated blocks
+        uint64_t flushes {0};           // Translation cache flushes (self-modifying code, full buffer, reload)
+        uint64_t entries {0};           // Switches from the interpreter into translated code
+    };
+
+    static constexpr unsigned PAGE_SHIFT = 8;
+    static constexpr unsigned HOT_THRESHOLD = 16;  // Interpreted executions of a block before it is translated
+
+    Jit();
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool isSupported();
+
+    // Translated code for the block at `address` or nullptr
+    Code lookup(uint16_t address) const { return blocks[address]; }
+
+    // Counts an interpreted execution of the block at `address`, true once it's hot
+    bool isHot(uint16_t address) { return ++heat[address] >= HOT_THRESHOLD; }
+
+    // Translates the block at `address` from `memory`. Returns nullptr if there's nothing
+    // to translate (HLT or an unknown opcode at `address`) or the host isn't supported.
+    Code translate(uint16_t address, const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& memory);
+
+    // Runs translated code starting at `code` until it leaves to the interpreter
+    void enter(Code code, Context& context);
+
+    bool isCodePage(uint16_t address) const { return codePages[address >> PAGE_SHIFT] != 0; }
+
+    // Drops all translated code
+    void flush();
+
+    const Stats& stats() const { return statistics; }
+
+private:
+    class Assembler;
+
+    // Makes the code buffer either writable or executable, drops it if that fails
+    bool protect(bool writable);
+    void emitPrologueAndEpilogue();
+    void link(uint16_t target, Code code);
+
+    uint8_t* buffer;
+    size_t capacity;
+    size_t used;
+    size_t codeStart;               // Translated blocks start after the prologue and epilogue
+    Code epilogue;
+
+    std::array<Code, DEFAULT_MEMORY_SIZE> blocks;
+    std::array<uint16_t, DEFAULT_MEMORY_SIZE> heat;
+    std::array<uint8_t, (DEFAULT_MEMORY_SIZE >> PAGE_SHIFT)> codePages;
+    std::unordered_map<uint16_t, std::vector<size_t>> pendingLinks;   // jmp rel32 offsets waiting for a block
+
+    Stats statistics;
+};
+
+} // namespace sim
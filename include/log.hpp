@@ -5,9 +5,39 @@
 //
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <spdlog/spdlog.h>
 
+// Lowest level compiled in by the SIM_TRACE ... SIM_ERROR macros. Calls below it
+// compile to nothing. Release builds drop trace and debug unless overridden.
+#ifndef SIM_LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define SIM_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define SIM_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#endif
+
+// Logs through a LogHandle. The arguments are evaluated only if the level is compiled
+// in and enabled at runtime, so expensive ones (e.g. utils::to_binary) cost nothing otherwise.
+#define SIM_LOG(handle, level, ...)                                                                  \
+    do {                                                                                             \
+        if constexpr (static_cast<int>(level) >= SIM_LOG_ACTIVE_LEVEL) {                             \
+            if (spdlog::logger* simLogger = (handle).get();                                         \
+                simLogger && simLogger->should_log(level) && (handle).sample(level)) {                   \
+                simLogger->log(level, __VA_ARGS__);                                                  \
+            }                                                                                        \
+        }                                                                                            \
+    } while (false)
+
+#define SIM_TRACE(handle, ...) SIM_LOG(handle, spdlog::level::trace, __VA_ARGS__)
+#define SIM_DEBUG(handle, ...) SIM_LOG(handle, spdlog::level::debug, __VA_ARGS__)
+#define SIM_INFO(handle, ...) SIM_LOG(handle, spdlog::level::info, __VA_ARGS__)
+#define SIM_WARN(handle, ...) SIM_LOG(handle, spdlog::level::warn, __VA_ARGS__)
+#define SIM_ERROR(handle, ...) SIM_LOG(handle, spdlog::level::err, __VA_ARGS__)
+
 namespace sim {
 
 struct LogName
@@ -18,9 +48,92 @@ struct LogName
     static std::string cu;
     static std::string mut;
     static std::string reg;
+    static std::string engine;
+};
+
+// Cached logger: resolved once when logging is configured instead of a locked
+// registry lookup (spdlog::get) on every call. Null until then.
+class LogHandle final {
+public:
+    explicit LogHandle(const std::string& name) : name(name), logger(nullptr), sampleRate(1), sampleCounter(0), skipped(0) {}
+
+    LogHandle(const LogHandle&) = delete;
+    LogHandle& operator=(const LogHandle&) = delete;
+
+    spdlog::logger* get() const { return logger.load(std::memory_order_acquire); }
+    spdlog::logger* operator->() const { return get(); }
+
+    // False for the trace and debug messages skipped by sampling (LogOverflow::Sample)
+    bool sample(spdlog::level::level_enum level) const {
+        const unsigned rate = sampleRate.load(std::memory_order_relaxed);
+        if (rate <= 1 || level > spdlog::level::debug || sampleCounter.fetch_add(1, std::memory_order_relaxed) % rate == 0) {
+            return true;
+        }
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Messages sample() skipped since the last refresh()
+    uint64_t sampledOut() const { return skipped.load(std::memory_order_relaxed); }
+
+    // Re-resolves the logger from the spdlog registry and clears the sampling counters
+    void refresh(unsigned rate);
+
+private:
+    const std::string& name;
+    std::atomic<spdlog::logger*> logger;
+    std::atomic<unsigned> sampleRate;           // 1 passes every message
+    mutable std::atomic<unsigned> sampleCounter;
+    mutable std::atomic<uint64_t> skipped;
+};
+
+// Handles of the LogName loggers
+struct Log
+{
+    static LogHandle main;
+    static LogHandle alu;
+    static LogHandle memory;
+    static LogHandle cu;
+    static LogHandle mut;
+    static LogHandle reg;
+    static LogHandle engine;
+};
+
+// What a full asynchronous logging queue does with a new message
+enum class LogOverflow {
+    Block,      // The logging thread waits for the writer thread
+    Drop,       // The oldest queued message is discarded
+    Sample      // As Drop, and only every sampleRate-th trace/debug message is queued at all
+};
+
+struct AsyncLogOptions {
+    size_t queueSize {8192};                    // Queued messages
+    LogOverflow overflow {LogOverflow::Block};
+    unsigned sampleRate {16};                   // LogOverflow::Sample only
+    std::chrono::seconds flushInterval {1};     // Errors are flushed immediately
 };
 
 extern void ConfigureFileLogging(const std::string& filename, spdlog::level::level_enum level);
 extern void ConfigureNullLogging();
 
+// File logging without a thread of its own, every message is flushed as it's written.
+// For processes that fork(): the child can't inherit a lock held by a logging thread.
+extern void ConfigureForkSafeFileLogging(const std::string& filename, spdlog::level::level_enum level);
+
+// File logging through a bounded queue and a dedicated writer thread. Messages are
+// formatted into the file and flushed in batches off the simulation thread.
+extern void ConfigureAsyncFileLogging(const std::string& filename, spdlog::level::level_enum level,
+    const AsyncLogOptions& options);
+
+struct LogStats {
+    uint64_t dropped {0};       // Queued messages overwritten by newer ones (LogOverflow::Drop and Sample)
+    uint64_t sampled {0};       // Trace and debug messages skipped by LogOverflow::Sample
+};
+
+// Counters of the current configuration, zero for synchronous logging
+extern LogStats GetLogStats();
+
+// Changes the level of a single LogName logger at runtime, false if there's no such logger
+extern bool SetLogLevel(const std::string& name, spdlog::level::level_enum level);
+
 } // namespace sim
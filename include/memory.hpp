@@ -5,41 +5,193 @@
 //
 #pragma once
 
+#include "common.hpp"
+#include "datatypes.hpp"
+
 #include <stdexcept>
 #include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_target_socket.h>
 #include <array>
+#include <memory>
 
 namespace sim {
 
-constexpr uint32_t DEFAULT_MEMORY_SIZE = 65536; // 64 KB
+// Handler of the pages mapped with Memory::mapDevice(). `offset` is relative to the start
+// of the mapping. Called for every access through the ports and the socket, never through DMI.
+class MemoryMappedDevice {
+public:
+    virtual ~MemoryMappedDevice() = default;
+    virtual uint8_t read(size_t offset) = 0;
+    virtual void write(size_t offset, uint8_t value) = 0;
+};
 
-template<size_t MemorySize>
+template<size_t MemorySize, typename Types = DefaultTypes>
 class Memory final : public sc_core::sc_module {
 public:
     // Ports
-    sc_core::sc_in<sc_dt::sc_uint<16>> addressBus;
-    sc_core::sc_in<sc_dt::sc_uint<8>>  dataBusIn;
-    sc_core::sc_out<sc_dt::sc_uint<8>> dataBusOut;
+    sc_core::sc_in<typename Types::Address> addressBus;
+    sc_core::sc_in<typename Types::Byte>    dataBusIn;
+    sc_core::sc_out<typename Types::Byte>   dataBusOut;
     sc_core::sc_in<bool> readEnable;
     sc_core::sc_in<bool> writeEnable;
 
+    // TLM-2.0 (loosely-timed) alternative to the pin-level ports
+    tlm_utils::simple_target_socket<Memory> socket;
+
     Memory(sc_core::sc_module_name name);
 
     void reset();
 
     void load(const std::array<uint8_t, MemorySize>& data);
 
+    // An image of the whole address space that any number of memories can share
+    using SharedImage = std::shared_ptr<const std::array<uint8_t, MemorySize>>;
+
+    // Reads every page from `image` instead of copying it. RAM pages get their own copy
+    // on the first write (copy-on-write), ROM pages keep pointing into the image.
+    void load(SharedImage image);
+
+    // Delay annotated to every transaction received through the socket
+    void setAccessDelay(const sc_core::sc_time& delay);
+
+    // Enables or disables Direct Memory Interface grants.
+    // Disabling revokes every pointer handed out so far.
+    void setDmiAllowed(bool allowed);
+
+    // Revokes DMI pointers overlapping [start, end]
+    void invalidateDmi(sc_dt::uint64 start = 0, sc_dt::uint64 end = MemorySize - 1);
+
+    static constexpr unsigned REGION_SHIFT = 12;    // Counters granularity (4 KB)
+    static constexpr size_t REGION_SIZE = size_t {1} << REGION_SHIFT;
+    static constexpr size_t REGION_COUNT = (MemorySize + REGION_SIZE - 1) / REGION_SIZE;
+
+    // Accesses through the ports and the socket, a transaction counts once in every region it
+    // touches. DMI accesses bypass the memory and aren't counted.
+    struct AccessCounters {
+        uint64_t reads {0};
+        uint64_t writes {0};
+    };
+
+    // Counters of the region holding [region << REGION_SHIFT, (region + 1) << REGION_SHIFT)
+    const AccessCounters& regionCounters(size_t region) const;
+    AccessCounters totalCounters() const;
+
+    // Wake-ups of the pin-level process. It runs on rising enable edges only, so every
+    // activation is an access unless both enables rise in the same delta cycle.
+    uint64_t activations() const;
+
+    // Writes ignored because they hit a ROM page
+    uint64_t romWriteTraps() const;
+
+    // Counters are cleared by reset() too
+    void resetCounters();
+
+    static constexpr unsigned PAGE_SHIFT = 8;       // Allocation granularity (256 bytes)
+    static constexpr size_t PAGE_SIZE = size_t {1} << PAGE_SHIFT;
+    static constexpr size_t PAGE_COUNT = MemorySize / PAGE_SIZE;
+    static_assert(MemorySize % PAGE_SIZE == 0, "Memory must consist of whole pages");
+
+    // Pages holding their own storage. Pages that have never been written (or were
+    // loaded with zeros) share one zero page, pages of a shared image aren't counted
+    // until they are copied. DMI grants don't allocate pages: pages with storage are granted
+    // from it, pages of a shared image read-only in place and zero pages not at all.
+    size_t residentPages() const;
+
+    enum class PageType : uint8_t {
+        Ram,
+        Rom,        // Writes through the ports and the socket are ignored and counted
+        Device,     // Accesses go to a MemoryMappedDevice, see mapDevice()
+    };
+
+    // Region map, one entry per page: the pages of [start, end] become RAM or ROM, the
+    // bounds must be page aligned. The map is kept by reset() and load().
+    // Throws std::runtime_error for a bad range or PageType::Device.
+    void mapPages(sc_dt::uint64 start, sc_dt::uint64 end, PageType type);
+    // Routes the pages of [start, end] to `device` (not owned)
+    void mapDevice(sc_dt::uint64 start, sc_dt::uint64 end, MemoryMappedDevice& device);
+    PageType pageType(sc_dt::uint64 address) const;
+
+    // Device pages read as 0, the device isn't accessed
+    typename Types::Byte getValueAt(typename Types::Address address) const {
+        return peekByte(ToUnsigned(address) % MemorySize);
+    }
+
+    // utils::Fnv1a of the whole memory, the same as FunctionalEngine::memoryDigest()
+    uint64_t digest() const;
+
 private:
     void execute();
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay);
+    bool get_direct_mem_ptr(tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi);
+    void contentChanged(sc_dt::uint64 start = 0, sc_dt::uint64 end = MemorySize - 1);
 
-    std::array<sc_dt::sc_uint<8>, MemorySize> buffer;   // Internal memory storage
+    void count(uint64_t address, unsigned length, bool write);
 
-#ifdef ENABLE_TESTING
-public:
-    sc_dt::sc_uint<8> getValueAt(sc_dt::sc_uint<16> address) const {
-        return buffer[address];
+    using Page = std::array<uint8_t, PAGE_SIZE>;
+
+    uint8_t readByte(size_t address) {
+        const uint8_t* page = readPages[address >> PAGE_SHIFT];
+        if (page != nullptr) {
+            return page[address & (PAGE_SIZE - 1)];
+        }
+        return readDevice(address);
     }
-#endif
+    uint8_t peekByte(size_t address) const {
+        const uint8_t* page = readPages[address >> PAGE_SHIFT];
+        return page != nullptr ? page[address & (PAGE_SIZE - 1)] : 0;
+    }
+    void writeByte(size_t address, uint8_t value) {
+        uint8_t* page = writePages[address >> PAGE_SHIFT];
+        if (page != nullptr) {
+            page[address & (PAGE_SIZE - 1)] = value;
+        } else {
+            writeSharedPage(address, value);
+        }
+    }
+    // Copies a RAM page on its first write, traps writes to ROM and passes device writes on
+    void writeSharedPage(size_t address, uint8_t value);
+    uint8_t readDevice(size_t address);
+
+    static void checkPageRange(sc_dt::uint64 start, sc_dt::uint64 end, const char* function);
+
+    // Gives the page its own storage, initialized with its current content
+    uint8_t* allocatePage(size_t page);
+    // Storage of the page, null while it reads from the zero page or the shared image
+    uint8_t* pageStorage(size_t page) const;
+    // Drops the storage, the page reads from the zero page or the shared image again
+    void releasePage(size_t page);
+    void releasePages();
+    // Points readPages at the storage, the shared image or the zero page (null for devices),
+    // and writePages at the storage of a RAM page (null for shared, ROM and device pages)
+    void updatePage(size_t page);
+    // Moves the pages with storage into one buffer that DMI pointers can point into,
+    // pages allocated later get their slot in it
+    void makeContiguous();
+    // Not a device page and not read from the zero page
+    bool dmiGrantable(size_t page) const;
+
+    sc_core::sc_time accessDelay;
+    bool dmiAllowed;
+
+    std::array<AccessCounters, REGION_COUNT> counters;
+    uint64_t processActivations;
+    uint64_t romWrites;
+
+    // Internal memory storage, a page table over plain bytes (sc_uint<8> takes 8 bytes per cell).
+    // Values are converted to the port types of the policy only at the ports.
+    // Reads go through readPages and writes through writePages. A null entry sends the access
+    // to the slow path (copy-on-write, ROM, devices), so RAM costs one lookup in either table.
+    inline static const Page zeroPage {};
+    std::array<const uint8_t*, PAGE_COUNT> readPages;
+    std::array<uint8_t*, PAGE_COUNT> writePages;
+    std::array<std::unique_ptr<Page>, PAGE_COUNT> ownedPages;
+    std::array<PageType, PAGE_COUNT> pageTypes;
+    std::array<MemoryMappedDevice*, PAGE_COUNT> pageDevices;
+    std::array<size_t, PAGE_COUNT> deviceOffsets;   // Of the first byte of the page in its mapping
+    SharedImage sharedImage;                    // Read by the pages not copied yet
+    std::unique_ptr<uint8_t[]> contiguous;      // Storage of the pages once DMI has been granted
+    std::array<bool, PAGE_COUNT> contiguousPages;   // The storage of the page is its slot in contiguous
 };
 
 } // namespace sim
@@ -7,44 +7,409 @@
 #pragma once
 
 #include <systemc>
+#include <algorithm>
+#include <cstring>
+#include <string>
 #include "memory.hpp"
 #include "log.hpp"
+#include "utils.hpp"
 
 namespace sim {
 
-template<size_t MemorySize>
-Memory<MemorySize>::Memory(sc_core::sc_module_name name)
-    : sc_module(std::move(name)), buffer {} {
+template<size_t MemorySize, typename Types>
+Memory<MemorySize, Types>::Memory(sc_core::sc_module_name name)
+    : sc_module(std::move(name)), socket("socket"), accessDelay(sc_core::SC_ZERO_TIME), dmiAllowed(true),
+      counters {}, processActivations(0), romWrites(0), writePages {}, pageDevices {}, deviceOffsets {}, contiguousPages {} {
+    readPages.fill(zeroPage.data());
+    pageTypes.fill(PageType::Ram);
     SC_METHOD(execute);
-    // Process on read/write signals and address change
-    sensitive << readEnable << writeEnable << addressBus << dataBusIn;
+    // Process on rising read/write enables only. The control unit drives the address and
+    // data in the same delta cycle as the enable, so they are valid when the edge is seen.
+    sensitive << readEnable.pos() << writeEnable.pos();
     dont_initialize();
+
+    socket.register_b_transport(this, &Memory::b_transport);
+    socket.register_get_direct_mem_ptr(this, &Memory::get_direct_mem_ptr);
 }
 
-template<size_t MemorySize>
-void Memory<MemorySize>::reset() {
-    buffer.fill(0);
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::reset() {
+    sharedImage.reset();
+    releasePages();
+    resetCounters();
+    contentChanged();
 }
 
-template<size_t MemorySize>
-void Memory<MemorySize>::execute() {
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::execute() {
+    ++processActivations;
+    const unsigned address = ToUnsigned(addressBus.read()) % MemorySize;
+
     if (writeEnable.read()) {
         // Write data to memory
-        buffer[addressBus.read().to_uint() % MemorySize] = dataBusIn.read();
-        spdlog::get(sim::LogName::memory)->info("Written to memory: Address={}, Data={}", addressBus.read().to_int(), dataBusIn.read().to_uint());
+        writeByte(address, static_cast<uint8_t>(ToUnsigned(dataBusIn.read())));
+        count(address, 1, true);
+        SIM_TRACE(sim::Log::memory, "Written to memory: Address={}, Data={}", address, peekByte(address));
     }
 
     if (readEnable.read()) {
         // Read data from memory
-        dataBusOut.write(buffer[addressBus.read().to_uint() % MemorySize]);
-        spdlog::get(sim::LogName::memory)->info("Read from memory: Address={}, Data={}", addressBus.read().to_int(), dataBusOut.read().to_uint());
+        const uint8_t value = readByte(address);
+        dataBusOut.write(value);
+        count(address, 1, false);
+        SIM_TRACE(sim::Log::memory, "Read from memory: Address={}, Data={}", address, value);
+    }
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::count(uint64_t address, unsigned length, bool write) {
+    if (length == 0) {
+        return;
+    }
+    for (uint64_t region = address >> REGION_SHIFT; region <= (address + length - 1) >> REGION_SHIFT; ++region) {
+        ++(write ? counters[region].writes : counters[region].reads);
+    }
+}
+
+template<size_t MemorySize, typename Types>
+const typename Memory<MemorySize, Types>::AccessCounters& Memory<MemorySize, Types>::regionCounters(size_t region) const {
+    return counters.at(region);
+}
+
+template<size_t MemorySize, typename Types>
+typename Memory<MemorySize, Types>::AccessCounters Memory<MemorySize, Types>::totalCounters() const {
+    AccessCounters total;
+    for (const auto& region : counters) {
+        total.reads += region.reads;
+        total.writes += region.writes;
+    }
+    return total;
+}
+
+template<size_t MemorySize, typename Types>
+uint64_t Memory<MemorySize, Types>::activations() const {
+    return processActivations;
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::resetCounters() {
+    counters.fill({});
+    processActivations = 0;
+    romWrites = 0;
+}
+
+template<size_t MemorySize, typename Types>
+uint64_t Memory<MemorySize, Types>::romWriteTraps() const {
+    return romWrites;
+}
+
+template<size_t MemorySize, typename Types>
+uint64_t Memory<MemorySize, Types>::digest() const {
+    // Device pages count as zeros
+    uint64_t hash = utils::FNV1A_BASIS;
+    for (const uint8_t* page : readPages) {
+        hash = utils::Fnv1a(page != nullptr ? page : zeroPage.data(), PAGE_SIZE, hash);
+    }
+    return hash;
+}
+
+// MARK: - Pages
+
+template<size_t MemorySize, typename Types>
+size_t Memory<MemorySize, Types>::residentPages() const {
+    size_t count = 0;
+    for (size_t page = 0; page < PAGE_COUNT; ++page) {
+        if (pageStorage(page) != nullptr) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+template<size_t MemorySize, typename Types>
+uint8_t* Memory<MemorySize, Types>::pageStorage(size_t page) const {
+    if (contiguousPages[page]) {
+        return contiguous.get() + (page << PAGE_SHIFT);
+    }
+    return ownedPages[page] ? ownedPages[page]->data() : nullptr;
+}
+
+template<size_t MemorySize, typename Types>
+uint8_t* Memory<MemorySize, Types>::allocatePage(size_t page) {
+    uint8_t* storage;
+    if (contiguous) {
+        storage = contiguous.get() + (page << PAGE_SHIFT);
+        contiguousPages[page] = true;
+    } else {
+        ownedPages[page] = std::make_unique<Page>();
+        storage = ownedPages[page]->data();
+    }
+    std::copy_n(readPages[page], PAGE_SIZE, storage);
+    updatePage(page);
+    return storage;
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::releasePage(size_t page) {
+    ownedPages[page].reset();
+    contiguousPages[page] = false;
+    updatePage(page);
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::writeSharedPage(size_t address, uint8_t value) {
+    const size_t page = address >> PAGE_SHIFT;
+    switch (pageTypes[page]) {
+        case PageType::Ram:
+            allocatePage(page)[address & (PAGE_SIZE - 1)] = value;
+            if (sharedImage) {
+                // A read-only grant may still point into the image
+                contentChanged(page << PAGE_SHIFT, ((page + 1) << PAGE_SHIFT) - 1);
+            }
+            break;
+        case PageType::Rom:
+            ++romWrites;
+            SIM_DEBUG(sim::Log::memory, "Write to ROM trapped: Address={}, Data={}", address, value);
+            break;
+        case PageType::Device:
+            pageDevices[page]->write(deviceOffsets[page] + (address & (PAGE_SIZE - 1)), value);
+            break;
+    }
+}
+
+template<size_t MemorySize, typename Types>
+uint8_t Memory<MemorySize, Types>::readDevice(size_t address) {
+    const size_t page = address >> PAGE_SHIFT;
+    return pageDevices[page]->read(deviceOffsets[page] + (address & (PAGE_SIZE - 1)));
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::updatePage(size_t page) {
+    uint8_t* const storage = pageStorage(page);
+    if (pageTypes[page] == PageType::Device) {
+        readPages[page] = nullptr;
+    } else if (storage != nullptr) {
+        readPages[page] = storage;
+    } else if (sharedImage) {
+        readPages[page] = sharedImage->data() + (page << PAGE_SHIFT);
+    } else {
+        readPages[page] = zeroPage.data();
+    }
+    writePages[page] = pageTypes[page] == PageType::Ram ? storage : nullptr;
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::checkPageRange(sc_dt::uint64 start, sc_dt::uint64 end, const char* function) {
+    if (start > end || end >= MemorySize || start % PAGE_SIZE != 0 || (end + 1) % PAGE_SIZE != 0) {
+        throw std::runtime_error(std::string(function) + "(): [" + std::to_string(start) + ", " + std::to_string(end)
+            + "] doesn't cover whole pages");
+    }
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::mapPages(sc_dt::uint64 start, sc_dt::uint64 end, PageType type) {
+    checkPageRange(start, end, "mapPages");
+    if (type == PageType::Device) {
+        throw std::runtime_error("mapPages(): devices are mapped with mapDevice()");
+    }
+    for (size_t page = start >> PAGE_SHIFT; page <= end >> PAGE_SHIFT; ++page) {
+        pageTypes[page] = type;
+        pageDevices[page] = nullptr;
+        updatePage(page);
+    }
+    // Write access granted over the range may be gone
+    contentChanged();
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::mapDevice(sc_dt::uint64 start, sc_dt::uint64 end, MemoryMappedDevice& device) {
+    checkPageRange(start, end, "mapDevice");
+    for (size_t page = start >> PAGE_SHIFT; page <= end >> PAGE_SHIFT; ++page) {
+        pageTypes[page] = PageType::Device;
+        pageDevices[page] = &device;
+        deviceOffsets[page] = (page << PAGE_SHIFT) - start;
+        releasePage(page);
+    }
+    // DMI pointers into the range must not bypass the device
+    contentChanged();
+}
+
+template<size_t MemorySize, typename Types>
+typename Memory<MemorySize, Types>::PageType Memory<MemorySize, Types>::pageType(sc_dt::uint64 address) const {
+    return pageTypes[(address % MemorySize) >> PAGE_SHIFT];
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::releasePages() {
+    for (size_t page = 0; page < PAGE_COUNT; ++page) {
+        releasePage(page);
     }
 }
 
-template<size_t MemorySize>
-void Memory<MemorySize>::load(const std::array<uint8_t, MemorySize>& data) {
-    spdlog::get(sim::LogName::memory)->info("Loading program...");
-    std::copy(data.begin(), data.end(), buffer.begin());
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::makeContiguous() {
+    if (contiguous) {
+        return;
+    }
+    // Left uninitialized, only the slots of pages with storage are ever touched
+    contiguous.reset(new uint8_t[MemorySize]);
+    for (size_t page = 0; page < PAGE_COUNT; ++page) {
+        if (ownedPages[page]) {
+            std::copy_n(ownedPages[page]->begin(), PAGE_SIZE, contiguous.get() + (page << PAGE_SHIFT));
+            ownedPages[page].reset();
+            contiguousPages[page] = true;
+            updatePage(page);
+        }
+    }
+    SIM_INFO(sim::Log::memory, "{} pages moved for DMI", residentPages());
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay) {
+    const sc_dt::uint64 address = trans.get_address();
+    const unsigned int length = trans.get_data_length();
+    unsigned char* data = trans.get_data_ptr();
+
+    if (address + length > MemorySize) {
+        trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+        return;
+    }
+    if (trans.get_byte_enable_ptr() != nullptr) {
+        trans.set_response_status(tlm::TLM_BYTE_ENABLE_ERROR_RESPONSE);
+        return;
+    }
+    if (trans.get_streaming_width() < length) {
+        trans.set_response_status(tlm::TLM_BURST_ERROR_RESPONSE);
+        return;
+    }
+
+    switch (trans.get_command()) {
+        case tlm::TLM_READ_COMMAND:
+            for (unsigned i = 0; i < length; ++i) {
+                data[i] = readByte(address + i);
+            }
+            count(address, length, false);
+            SIM_TRACE(sim::Log::memory, "Read from memory (TLM): Address={}, Length={}", address, length);
+            break;
+        case tlm::TLM_WRITE_COMMAND:
+            for (unsigned i = 0; i < length; ++i) {
+                writeByte(address + i, data[i]);
+            }
+            count(address, length, true);
+            SIM_TRACE(sim::Log::memory, "Written to memory (TLM): Address={}, Length={}", address, length);
+            break;
+        case tlm::TLM_IGNORE_COMMAND:
+            break;
+    }
+
+    delay += accessDelay;
+    trans.set_dmi_allowed(dmiAllowed && dmiGrantable((address % MemorySize) >> PAGE_SHIFT));
+    trans.set_response_status(tlm::TLM_OK_RESPONSE);
+}
+
+template<size_t MemorySize, typename Types>
+bool Memory<MemorySize, Types>::dmiGrantable(size_t page) const {
+    // Zero pages go through the socket until their first write gives them storage
+    return pageTypes[page] != PageType::Device && (sharedImage || pageStorage(page) != nullptr);
+}
+
+template<size_t MemorySize, typename Types>
+bool Memory<MemorySize, Types>::get_direct_mem_ptr(tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi) {
+    const size_t page = (trans.get_address() % MemorySize) >> PAGE_SHIFT;
+    if (!dmiAllowed || !dmiGrantable(page)) {
+        dmi.set_granted_access(tlm::tlm_dmi::DMI_ACCESS_NONE);
+        return false;
+    }
+    // The run of pages around the address of the same type, either all with storage or all shared
+    const PageType type = pageTypes[page];
+    const bool stored = pageStorage(page) != nullptr;
+    const auto inRun = [&](size_t other) { return pageTypes[other] == type && (pageStorage(other) != nullptr) == stored; };
+    size_t first = page;
+    size_t last = page;
+    while (first > 0 && inRun(first - 1)) {
+        --first;
+    }
+    while (last + 1 < PAGE_COUNT && inRun(last + 1)) {
+        ++last;
+    }
+    dmi.set_start_address(first << PAGE_SHIFT);
+    dmi.set_end_address(((last + 1) << PAGE_SHIFT) - 1);
+    if (stored) {
+        // The pointer stays valid until the memory is destroyed
+        makeContiguous();
+        dmi.set_dmi_ptr(contiguous.get() + (first << PAGE_SHIFT));
+        dmi.set_granted_access(type == PageType::Rom ? tlm::tlm_dmi::DMI_ACCESS_READ : tlm::tlm_dmi::DMI_ACCESS_READ_WRITE);
+    } else {
+        // Valid until the image is replaced or a RAM page of the run is copied, both invalidate it
+        dmi.set_dmi_ptr(const_cast<unsigned char*>(sharedImage->data()) + (first << PAGE_SHIFT));
+        dmi.set_granted_access(tlm::tlm_dmi::DMI_ACCESS_READ);
+    }
+    dmi.set_read_latency(accessDelay);
+    dmi.set_write_latency(accessDelay);
+    SIM_INFO(sim::Log::memory, "DMI granted: [{}, {}]", dmi.get_start_address(), dmi.get_end_address());
+    return true;
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::setDmiAllowed(bool allowed) {
+    dmiAllowed = allowed;
+    if (!allowed) {
+        invalidateDmi();
+    }
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::invalidateDmi(sc_dt::uint64 start, sc_dt::uint64 end) {
+    SIM_INFO(sim::Log::memory, "DMI invalidated: [{}, {}]", start, end);
+    socket->invalidate_direct_mem_ptr(start, end);
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::setAccessDelay(const sc_core::sc_time& delay) {
+    accessDelay = delay;
+    // Latencies handed out with earlier grants are stale now
+    invalidateDmi();
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::load(const std::array<uint8_t, MemorySize>& data) {
+    SIM_INFO(sim::Log::memory, "Loading program...");
+    // Pages still read from the previous image until they are replaced
+    const SharedImage previous = std::move(sharedImage);
+    // Zero pages of the image stay (or become) shared, device pages are left to the device
+    for (size_t page = 0; page < PAGE_COUNT; ++page) {
+        if (pageTypes[page] == PageType::Device) {
+            continue;
+        }
+        const uint8_t* source = data.data() + (page << PAGE_SHIFT);
+        if (std::all_of(source, source + PAGE_SIZE, [](uint8_t value) { return value == 0; })) {
+            releasePage(page);
+            continue;
+        }
+        uint8_t* storage = pageStorage(page);
+        std::memcpy(storage != nullptr ? storage : allocatePage(page), source, PAGE_SIZE);
+    }
+    contentChanged();
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::load(SharedImage image) {
+    if (!image) {
+        throw std::runtime_error("load(): no image");
+    }
+    SIM_INFO(sim::Log::memory, "Loading shared image...");
+    sharedImage = std::move(image);
+    releasePages();
+    contentChanged();
+}
+
+template<size_t MemorySize, typename Types>
+void Memory<MemorySize, Types>::contentChanged(sc_dt::uint64 start, sc_dt::uint64 end) {
+    // Initiators may cache what they have read (e.g. decoded instructions), the
+    // DMI invalidation tells them to drop it. Ports aren't usable before the simulation starts.
+    if (sc_core::sc_get_status() & (sc_core::SC_RUNNING | sc_core::SC_PAUSED)) {
+        invalidateDmi(start, end);
+    }
 }
 
 } // namespace sim
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "common.hpp"
+#include "datatypes.hpp"
 #include "log.hpp"
 #include "utils.hpp"
 
@@ -14,37 +15,40 @@
 
 namespace sim {
 
-class Multiplexer : public sc_core::sc_module {
+template<typename Types>
+class BasicMultiplexer : public sc_core::sc_module {
+
+    using Byte = typename Types::Byte;
 
 public:
 
-    sc_core::sc_in<sc_dt::sc_uint<8>>  select;      // Active source
-    sc_core::sc_in<sc_dt::sc_uint<8>>  input;       // Input signal
-    sc_core::sc_out<sc_dt::sc_uint<8>> output;      // Output signal
+    sc_core::sc_in<Byte>               select;      // Active source
+    sc_core::sc_in<Byte>               input;       // Input signal
+    sc_core::sc_out<Byte>              output;      // Output signal
     sc_core::sc_in<bool>               writeEnable; // Control signal to enable writing
     sc_core::sc_in<bool>               readEnable;  // Control signal to enable reading
 
     // Input ports for each register and memory
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputA;
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputB;
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputC;
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputD;
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputE;
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputH;
-    sc_core::sc_in<sc_dt::sc_uint<8>> inputL;
+    sc_core::sc_in<Byte> inputA;
+    sc_core::sc_in<Byte> inputB;
+    sc_core::sc_in<Byte> inputC;
+    sc_core::sc_in<Byte> inputD;
+    sc_core::sc_in<Byte> inputE;
+    sc_core::sc_in<Byte> inputH;
+    sc_core::sc_in<Byte> inputL;
 
     // Output ports for each register and memory
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputA;
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputB;
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputC;
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputD;
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputE;
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputH;
-    sc_core::sc_out<sc_dt::sc_uint<8>> outputL;
+    sc_core::sc_out<Byte> outputA;
+    sc_core::sc_out<Byte> outputB;
+    sc_core::sc_out<Byte> outputC;
+    sc_core::sc_out<Byte> outputD;
+    sc_core::sc_out<Byte> outputE;
+    sc_core::sc_out<Byte> outputH;
+    sc_core::sc_out<Byte> outputL;
 
     sc_core::sc_out<bool> regWriteEnable[7];
 
-    Multiplexer(sc_core::sc_module_name name) : sc_core::sc_module(name) {
+    BasicMultiplexer(sc_core::sc_module_name name) : sc_core::sc_module(name) {
         SC_METHOD(selector);
         sensitive << select << writeEnable << readEnable << input << inputA << inputB << inputC << inputD << inputE << inputH << inputL;
         dont_initialize();
@@ -52,13 +56,13 @@ public:
 
 private:
     void selector() {
-        const uint regID = select.read().to_uint();
-        spdlog::get(sim::LogName::mut)->trace("Selector -> {} ", utils::to_binary(regID));
+        const unsigned regID = ToUnsigned(select.read());
+        SIM_TRACE(sim::Log::mut, "Selector -> {} ", utils::to_binary(regID));
         if (writeEnable.read()) {
-            spdlog::get(sim::LogName::mut)->trace("Writing register {} ", utils::to_binary(regID));
+            SIM_TRACE(sim::Log::mut, "Writing register {} ", utils::to_binary(regID));
             // Write to the selected source
             regWriteEnable[regID].write(true);
-            const sc_dt::sc_uint<8> data = input.read();
+            const Byte data = input.read();
             switch (regID) {
                 case SELECT_REG_A: outputA.write(data); break;
                 case SELECT_REG_B: outputB.write(data); break;
@@ -74,9 +78,9 @@ private:
         }
 
         if (readEnable.read()) {
-            spdlog::get(sim::LogName::mut)->trace("Reading register {} ", utils::to_binary(regID));
+            SIM_TRACE(sim::Log::mut, "Reading register {} ", utils::to_binary(regID));
             // Read from the selected source
-            sc_dt::sc_uint<8> data;
+            Byte data {};
             switch (regID) {
                 case SELECT_REG_A: data = inputA.read(); break;
                 case SELECT_REG_B: data = inputB.read(); break;
@@ -92,4 +96,6 @@ private:
     }
 };
 
+using Multiplexer = BasicMultiplexer<DefaultTypes>;
+
 } // namespace sim
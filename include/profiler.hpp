@@ -0,0 +1,57 @@
+//
+//  profiler.hpp
+//
+
+#pragma once
+
+#include "common.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace sim {
+
+/*
+ * Guest Profiler
+ *
+ * Counts executed instructions per PC and per opcode and the cycles (T-states)
+ * spent per opcode in flat arrays, so recording is three increments per
+ * instruction. The report ranks the opcodes by cycles, which is where
+ * optimizing the control unit pays off first, and the PCs by executions.
+ */
+class Profiler final {
+
+public:
+    Profiler();
+
+    void record(uint16_t pc, uint8_t opcode, uint8_t cycles) {
+        ++pcCounts[pc];
+        pcOpcodes[pc] = opcode;
+        ++opcodeCounts[opcode];
+        opcodeCycles[opcode] += cycles;
+    }
+
+    void reset();
+
+    uint64_t instructions() const;
+    uint64_t cycles() const;
+
+    uint64_t countAt(uint16_t pc) const { return pcCounts[pc]; }
+    uint64_t opcodeCount(uint8_t opcode) const { return opcodeCounts[opcode]; }
+    uint64_t opcodeCycleCount(uint8_t opcode) const { return opcodeCycles[opcode]; }
+
+    // Opcodes sorted by cycles and the `hotspots` most executed PCs
+    void writeReport(std::ostream& out, size_t hotspots = 20) const;
+
+    // Every executed opcode and PC with its counters
+    void writeJson(std::ostream& out) const;
+
+private:
+    std::array<uint64_t, DEFAULT_MEMORY_SIZE> pcCounts;
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> pcOpcodes;     // Opcode last executed at a PC (code may be rewritten)
+    std::array<uint64_t, 256> opcodeCounts;
+    std::array<uint64_t, 256> opcodeCycles;
+};
+
+} // namespace sim
@@ -6,31 +6,38 @@
 
 #pragma once
 
+#include "datatypes.hpp"
+
 #include <systemc>
 
 namespace sim {
 
-class Register final : public sc_core::sc_module {
+template<typename Types>
+class BasicRegister final : public sc_core::sc_module {
 public:
     sc_core::sc_in<bool> writeEnable;  // Write enable signal
-    sc_core::sc_in<sc_dt::sc_uint<8>> dataIn;  // Data to be written to the register
-    sc_core::sc_out<sc_dt::sc_uint<8>> dataOut;  // Data read from the register
+    sc_core::sc_in<typename Types::Byte> dataIn;  // Data to be written to the register
+    sc_core::sc_out<typename Types::Byte> dataOut;  // Data read from the register
 
-    Register(sc_core::sc_module_name);
+    BasicRegister(sc_core::sc_module_name);
 
     void reset();
-private:
-    void update();
-
-    sc_dt::sc_uint<8> value {0};
 
-
-#ifdef ENABLE_TESTING
-public:
-    sc_dt::sc_uint<8> getValue() const {
+    // Direct access that bypasses the ports, dataOut keeps the last value written through them
+    typename Types::Byte getValue() const {
         return value;
     }
-#endif
+
+    void setValue(typename Types::Byte data) {
+        value = data;
+    }
+
+private:
+    void update();
+
+    typename Types::Byte value {0};
 };
 
+using Register = BasicRegister<DefaultTypes>;
+
 } // namespace sim
@@ -0,0 +1,75 @@
+//
+//  regfile.hpp
+//
+
+#pragma once
+
+#include "common.hpp"
+#include "datatypes.hpp"
+#include "mut.hpp"
+#include "reg.hpp"
+
+#include <array>
+#include <cstdint>
+#include <systemc>
+
+namespace sim {
+
+// Direct access to the registers, indexed by SELECT_REG_*
+class RegisterFileInterface : public virtual sc_core::sc_interface {
+public:
+    virtual uint8_t read(uint8_t select) const = 0;
+    virtual void write(uint8_t select, uint8_t value) = 0;
+};
+
+/*
+ * Register File
+ *
+ * The registers A ... L behind the multiplexer. The ports are the control unit side
+ * of the multiplexer, so an access at pin level takes the select/enable handshake and
+ * the delta cycles of the multiplexer and the register processes.
+ * RegisterFileInterface reads and writes the register values with a function call
+ * instead; the processes and the ports are then idle. Pick one of the two at
+ * elaboration: a direct write doesn't drive the register outputs the multiplexer reads.
+ */
+template<typename Types>
+class BasicRegisterFile final : public sc_core::sc_module, public RegisterFileInterface {
+
+    using Byte = typename Types::Byte;
+
+public:
+    sc_core::sc_in<Byte>  select;       // SELECT_REG_* of the access
+    sc_core::sc_in<Byte>  input;        // Value to write
+    sc_core::sc_out<Byte> output;       // Value read
+    sc_core::sc_in<bool>  writeEnable;
+    sc_core::sc_in<bool>  readEnable;
+
+    sc_core::sc_export<RegisterFileInterface> direct;
+
+    BasicMultiplexer<Types> mux {"MUX"};
+    BasicRegister<Types> registerA {"registerA"};
+    BasicRegister<Types> registerB {"registerB"};
+    BasicRegister<Types> registerC {"registerC"};
+    BasicRegister<Types> registerD {"registerD"};
+    BasicRegister<Types> registerE {"registerE"};
+    BasicRegister<Types> registerH {"registerH"};
+    BasicRegister<Types> registerL {"registerL"};
+
+    BasicRegisterFile(sc_core::sc_module_name name);
+
+    void reset();
+
+    uint8_t read(uint8_t select) const override;
+    void write(uint8_t select, uint8_t value) override;
+
+private:
+    std::array<BasicRegister<Types>*, 7> registers;   // Indexed by SELECT_REG_*
+
+    sc_core::sc_signal<Byte> dataMuxToRegA, dataMuxToRegB, dataMuxToRegC, dataMuxToRegD, dataMuxToRegE, dataMuxToRegH, dataMuxToRegL;
+    sc_core::sc_signal<Byte> dataRegAToMux, dataRegBToMux, dataRegCToMux, dataRegDToMux, dataRegEToMux, dataRegHToMux, dataRegLToMux;
+    sc_core::sc_signal<bool> aWriteEnable, bWriteEnable, cWriteEnable, dWriteEnable, eWriteEnable, hWriteEnable, lWriteEnable;
+};
+
+using RegisterFile = BasicRegisterFile<DefaultTypes>;
+
+} // namespace sim
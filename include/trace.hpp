@@ -0,0 +1,117 @@
+//
+//  trace.hpp
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+/*
+ * Binary Execution Trace
+ *
+ * One fixed-size record per executed instruction, kept in a ring of the last
+ * `capacity` records. The cycle counter is delta-encoded (cycles since the
+ * previous record), the header keeps the absolute cycle before the oldest record
+ * still in the ring. The file is memory-mapped where the host supports it, so
+ * the trace survives a crash of the simulator.
+ *
+ * simulator-intel-8080-trace turns a trace into a listing or CSV.
+ */
+
+// Flag in TraceRecord::flags: the instruction has written writeValue to writeAddress
+constexpr uint8_t TRACE_MEMORY_WRITE = 0x80;
+
+struct TraceRecord {
+    uint32_t cycles;                    // Clock cycles (T-states) since the previous record
+    uint16_t pc;                        // Address of the instruction
+    uint16_t sp;                        // After the instruction
+    std::array<uint8_t, 3> bytes;       // Opcode and operands
+    uint8_t length;                     // Bytes of the instruction
+    std::array<uint8_t, 7> registers;   // A, B, C, D, E, H, L after the instruction (SELECT_REG_* order)
+    uint8_t flags;                      // Flags after the instruction and TRACE_MEMORY_WRITE
+    uint16_t writeAddress;
+    uint8_t writeValue;
+    uint8_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 24, "Trace records must stay 24 bytes");
+
+struct TraceHeader {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;                  // Records in the ring
+    uint64_t written;                   // Records written in total, the ring holds the last min(written, capacity)
+    uint64_t baseCycle;                 // Absolute cycle before the oldest record in the ring
+};
+static_assert(sizeof(TraceHeader) == 40, "Trace header must stay 40 bytes");
+
+class TraceWriter final {
+
+public:
+    static constexpr uint64_t DEFAULT_CAPACITY = uint64_t {1} << 22;   // 4M records, 96 MB
+
+    // Creates (truncates) the trace file.
+    // Throws std::runtime_error if the file can't be created or mapped.
+    TraceWriter(const std::string& path, uint64_t capacity = DEFAULT_CAPACITY);
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void record(const TraceRecord& record) {
+        TraceRecord& slot = records[position];
+        if (header->written >= header->capacity) {
+            header->baseCycle += slot.cycles;   // The oldest record is overwritten
+        }
+        slot = record;
+        if (++position == header->capacity) {
+            position = 0;
+        }
+        ++header->written;
+    }
+
+    uint64_t written() const { return header->written; }
+
+private:
+    std::string path;
+    size_t size;
+    void* mapping;                      // Whole file: header and records
+    TraceHeader* header;
+    TraceRecord* records;
+    uint64_t position;                  // Next slot
+};
+
+class TraceReader final {
+
+public:
+    struct Entry {
+        uint64_t cycle;                 // Absolute cycle at the end of the instruction
+        uint64_t index;                 // Instruction number since the start of the trace
+        TraceRecord record;
+    };
+
+    // Throws std::runtime_error if the file can't be read or isn't a trace
+    explicit TraceReader(const std::string& path);
+
+    const TraceHeader& header() const { return head; }
+
+    // Records still in the ring, oldest first
+    const std::vector<Entry>& entries() const { return list; }
+
+private:
+    TraceHeader head;
+    std::vector<Entry> list;
+};
+
+// Mnemonic of an opcode without its operands, e.g. "MVI B"
+std::string Mnemonic(uint8_t opcode);
+
+// Mnemonic of the instruction starting with `bytes`, e.g. "MVI B, 0x11"
+std::string Disassemble(const std::array<uint8_t, 3>& bytes);
+
+} // namespace sim
@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include "common.hpp"
+
+#include <array>
 #include <string>
 
 namespace sim::utils {
@@ -14,5 +17,15 @@ std::string GetCurrentDateTime();
 
 std::string to_binary(uint8_t value);
 
+// Reads a raw program image that is placed at address 0.
+// Throws std::runtime_error if the file can't be read or doesn't fit into memory.
+std::array<uint8_t, DEFAULT_MEMORY_SIZE> LoadProgram(const std::string& path);
+
+constexpr uint64_t FNV1A_BASIS = 0xCBF29CE484222325;
+
+// 64-bit FNV-1a hash, e.g. of a final memory image.
+// Pass the hash of the preceding bytes as `hash` to go on over a split buffer.
+uint64_t Fnv1a(const uint8_t* data, size_t size, uint64_t hash = FNV1A_BASIS);
+
 
 } // namespace sim::utils
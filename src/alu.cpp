@@ -5,33 +5,20 @@
 //
 
 #include "alu.hpp"
+#include "alutable.hpp"
 #include "log.hpp"
 
 using namespace sc_core;
 using namespace sc_dt;
 
 namespace {
-    auto logger() { return spdlog::get(sim::LogName::alu); }
+    const sim::LogHandle& logger() { return sim::Log::alu; }
 }
 
 namespace sim {
 
-const uint8_t ALU::OP_ADD = 0b00000000;
-const uint8_t ALU::OP_ADC = 0b00000001;
-const uint8_t ALU::OP_SUB = 0b00000010;
-const uint8_t ALU::OP_SBB = 0b00000011;
-const uint8_t ALU::OP_ANA = 0b00000100;
-const uint8_t ALU::OP_XRA = 0b00000101;
-const uint8_t ALU::OP_ORA = 0b00000110;
-const uint8_t ALU::OP_CMP = 0b00000111;
-
-const uint8_t ALU::FLAG_IDX_ZERO = 0;
-const uint8_t ALU::FLAG_IDX_CARRY = 1;
-const uint8_t ALU::FLAG_IDX_SIGN = 2;
-const uint8_t ALU::FLAG_IDX_PARITY = 3;
-const uint8_t ALU::FLAG_IDX_AUX_CARRY = 4;
-
-ALU::ALU(sc_module_name name)
+template<typename Types>
+BasicALU<Types>::BasicALU(sc_module_name name)
     : sc_module(std::move(name)) {
     SC_METHOD(execute);
     // Ensure the ALU recalculates when any of these change
@@ -39,89 +26,23 @@ ALU::ALU(sc_module_name name)
     dont_initialize();
 }
 
-void ALU::execute() {
-    const sc_uint<8> a = accumulator.read();
-    const sc_uint<8> b = operand.read();
-    const sc_uint<4> op = opcode.read();
+template<typename Types>
+void BasicALU<Types>::execute() {
+    const uint8_t a = static_cast<uint8_t>(ToUnsigned(accumulator.read()));
+    const uint8_t b = static_cast<uint8_t>(ToUnsigned(operand.read()));
+    const uint8_t op = static_cast<uint8_t>(ToUnsigned(opcode.read()) % alu::OP_COUNT);   // Native opcodes aren't 4 bits wide
 
-    logger()->trace("[->] A={}; arg={}; opcode={}", a.to_int(), b.to_int(), op.to_int());
+    SIM_TRACE(logger(), "[->] A={}; arg={}; opcode={}", a, b, op);
 
-    // 8-bit accumulator
-    sc_dt::sc_uint<8> regACC = 0;
-    // 5-bit flag register (Z, C, S, P, AC)
-    sc_dt::sc_uint<5> regFR = flags.read();
+    const alu::Output out = alu::Execute(op, a, b, static_cast<uint8_t>(ToUnsigned(flags.read())));
 
-    switch (op) {
-        case ALU::OP_ADD:
-            regACC = a + b; 
-            regFR[FLAG_IDX_CARRY] = a + b > 255;
-            regFR[FLAG_IDX_AUX_CARRY] = ((a & 0x0F) + (b & 0x0F)) > 0x0F;
-            regFR[FLAG_IDX_ZERO] = regACC == 0; // Zero flag
-            regFR[FLAG_IDX_SIGN] = regACC[7]; // Sign flag (MSB of result)
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC)); // Calculate parity (even parity)
-            break;
-        case ALU::OP_ADC:
-            regACC = a + b + regFR[FLAG_IDX_CARRY];
-            regFR[FLAG_IDX_CARRY] = (a + b + regFR[FLAG_IDX_CARRY]) > 255;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            break;
-        case ALU::OP_SUB:
-            regACC = a - b;
-            regFR[FLAG_IDX_CARRY] = a < b; // Set Carry flag for subtraction (indicates borrow)
-            regFR[FLAG_IDX_AUX_CARRY] = 0;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            break;
-        case ALU::OP_SBB:
-            regACC = a - b - regFR[FLAG_IDX_CARRY]; // Subtract arg and Carry
-            regFR[FLAG_IDX_CARRY] = a < (b + regFR[FLAG_IDX_CARRY]); // Set Carry flag (borrow)
-            regFR[FLAG_IDX_AUX_CARRY] = 0;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            break;
-        case ALU::OP_ANA:
-            regACC = a & b;
-            regFR[FLAG_IDX_CARRY] = 0;
-            regFR[FLAG_IDX_AUX_CARRY] = ((a & 0x0F) & (b & 0x0F)) > 0x0F;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            break;
-        case ALU::OP_XRA:
-            regACC = a ^ b;
-            regFR[FLAG_IDX_CARRY] = 0;
-            regFR[FLAG_IDX_AUX_CARRY] = 0;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            break;
-         case ALU::OP_ORA:
-            regACC = a | b;
-            regFR[FLAG_IDX_CARRY] = 0;
-            regFR[FLAG_IDX_AUX_CARRY] = 0;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            break;
-        case ALU::OP_CMP:
-            regACC = a - b; // Internal only
-            regFR[FLAG_IDX_CARRY] = a < b;
-            regFR[FLAG_IDX_AUX_CARRY] = 0;
-            regFR[FLAG_IDX_ZERO] = regACC == 0;
-            regFR[FLAG_IDX_SIGN] = regACC[7];
-            regFR[FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
-            regACC = 0;
-            break;
-    }
+    SIM_TRACE(logger(), "[<-] result={}; flags={}", out.result, out.flags);
 
-    logger()->trace("[<-] result={}; flags={}", regACC.to_int(), regFR.to_int());
-
-    result.write(regACC);
-    flags.write(regFR);
+    result.write(out.result);
+    flags.write(out.flags);
 }
 
+template class BasicALU<NativeTypes>;
+template class BasicALU<BitAccurateTypes>;
+
 } // namespace sim
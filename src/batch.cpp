@@ -0,0 +1,193 @@
+//
+//  batch.cpp
+//
+
+#include "batch.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <limits>
+#include <thread>
+
+#include <spdlog/fmt/fmt.h>
+
+namespace {
+    const sim::LogHandle& logger() { return sim::Log::main; }
+
+    const char* StatusName(sim::FunctionalEngine::Status status) {
+        switch (status) {
+            case sim::FunctionalEngine::Status::Halted: return "halted";
+            case sim::FunctionalEngine::Status::Trapped: return "trapped";
+            default: return "running";
+        }
+    }
+
+    std::string EscapeJson(const std::string& text) {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text) {
+            switch (c) {
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\t': escaped += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        escaped += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+                    } else {
+                        escaped += c;
+                    }
+            }
+        }
+        return escaped;
+    }
+}
+
+namespace sim {
+
+BatchRunner::BatchRunner(unsigned workers)
+    : workers(workers != 0 ? workers : std::max(1u, std::thread::hardware_concurrency()))
+    , maxInstructions(std::numeric_limits<uint64_t>::max())
+    , loader(utils::LoadProgram) {
+}
+
+void BatchRunner::setMaxInstructions(uint64_t limit) {
+    maxInstructions = limit;
+}
+
+void BatchRunner::setLoader(Loader programLoader) {
+    loader = std::move(programLoader);
+}
+
+BatchRunner::Stats BatchRunner::run(const std::vector<std::string>& programs, const Sink& sink) {
+    std::vector<WorkQueue> queues(workers);
+    for (size_t index = 0; index < programs.size(); ++index) {
+        queues[index % workers].jobs.push_back(index);
+    }
+
+    std::mutex sinkMutex;
+    std::exception_ptr failure;
+    std::atomic<bool> failed {false};
+    std::atomic<uint64_t> steals {0};
+
+    const auto work = [&](size_t worker) {
+        FunctionalEngine engine;
+        uint64_t stolen = 0;
+        size_t job = 0;
+        while (!failed && take(queues, worker, job, stolen)) {
+            const Result result = execute(engine, job, programs[job]);
+            std::lock_guard guard(sinkMutex);
+            if (failed) {
+                break;
+            }
+            try {
+                sink(result);
+            } catch (...) {
+                failure = std::current_exception();
+                failed = true;
+            }
+        }
+        steals += stolen;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (size_t worker = 0; worker < workers; ++worker) {
+        threads.emplace_back(work, worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    SIM_INFO(logger(), "Batch: {} programs on {} workers in {:.3f} s, {} steals", programs.size(), workers, elapsed.count(), steals.load());
+    return {programs.size(), steals.load(), elapsed.count()};
+}
+
+bool BatchRunner::take(std::vector<WorkQueue>& queues, size_t worker, size_t& job, uint64_t& steals) const {
+    {
+        WorkQueue& own = queues[worker];
+        std::lock_guard guard(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+    // No programs are added while running, so a pass over empty deques means the batch is done
+    for (size_t i = 1; i < queues.size(); ++i) {
+        WorkQueue& victim = queues[(worker + i) % queues.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            ++steals;
+            return true;
+        }
+    }
+    return false;
+}
+
+BatchRunner::Result BatchRunner::execute(FunctionalEngine& engine, size_t index, const std::string& program) const {
+    Result result;
+    result.index = index;
+    result.program = program;
+    try {
+        const auto image = loader(program);
+        engine.reset();
+        engine.load(image);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+        return result;
+    }
+
+    engine.run(maxInstructions);
+    result.status = engine.status();
+    result.state = engine.state();
+    result.instructions = engine.instructionCount();
+    result.cycles = engine.cycleCount();
+    result.memoryDigest = engine.memoryDigest();
+    return result;
+}
+
+std::vector<std::string> BatchRunner::ReadManifest(std::istream& in) {
+    std::vector<std::string> programs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        programs.push_back(line);
+    }
+    return programs;
+}
+
+void BatchRunner::WriteJson(std::ostream& out, const Result& result) {
+    if (!result.error.empty()) {
+        out << fmt::format("{{\"index\": {}, \"program\": \"{}\", \"error\": \"{}\"}}\n",
+            result.index, EscapeJson(result.program), EscapeJson(result.error));
+        return;
+    }
+    const auto& registers = result.state.registers;
+    out << fmt::format("{{\"index\": {}, \"program\": \"{}\", \"status\": \"{}\", "
+        "\"a\": {}, \"b\": {}, \"c\": {}, \"d\": {}, \"e\": {}, \"h\": {}, \"l\": {}, "
+        "\"pc\": {}, \"sp\": {}, \"flags\": {}, \"instructions\": {}, \"cycles\": {}, \"memoryDigest\": \"{:016x}\"}}\n",
+        result.index, EscapeJson(result.program), StatusName(result.status),
+        registers[FunctionalEngine::REG_A], registers[FunctionalEngine::REG_B], registers[FunctionalEngine::REG_C],
+        registers[FunctionalEngine::REG_D], registers[FunctionalEngine::REG_E], registers[FunctionalEngine::REG_H],
+        registers[FunctionalEngine::REG_L], result.state.pc, result.state.sp, result.state.flags,
+        result.instructions, result.cycles, result.memoryDigest);
+}
+
+} // namespace sim
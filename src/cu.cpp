@@ -10,78 +10,294 @@
 #include "common.hpp"
 
 #include <systemc>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
 using namespace sc_core;
 
 namespace {
-    auto logger() { return spdlog::get(sim::LogName::cu); }
+    const sim::LogHandle& logger() { return sim::Log::cu; }
 }
 
 namespace sim {
 
-const uint8_t ControlUnit::OP_REG_B = 0b00000000;
-const uint8_t ControlUnit::OP_REG_C = 0b00000001;
-const uint8_t ControlUnit::OP_REG_D = 0b00000010;
-const uint8_t ControlUnit::OP_REG_E = 0b00000011;
-const uint8_t ControlUnit::OP_REG_H = 0b00000100;
-const uint8_t ControlUnit::OP_REG_L = 0b00000101;
-const uint8_t ControlUnit::OP_REG_M = 0b00000110;    // Memory, refers to the address in the HL register pair)
-const uint8_t ControlUnit::OP_REG_A = 0b00000111;    // Accumulator
-
-const uint8_t ControlUnit::OP_MEM   = 0b00000110;    // Source for MUT that refers to memory
-
-const uint8_t ControlUnit::OP_GROUP_DATA_TRANSFER = 0b00000000;
-const uint8_t ControlUnit::OP_GROUP_MOV = 0b00000001;
-const uint8_t ControlUnit::OP_GROUP_ALU = 0b00000010;
-const uint8_t ControlUnit::OP_GROUP_SPECIAL = 0b00000011;
-
-const uint8_t ControlUnit::OP_RP_BC = 0b00000000;
-const uint8_t ControlUnit::OP_RP_DE = 0b00000001;
-const uint8_t ControlUnit::OP_RP_HL = 0b00000010;
-const uint8_t ControlUnit::OP_RP_SP = 0b00000011;
-
-const uint8_t ControlUnit::OP_INST_NOP = 0b00000000;
-const uint8_t ControlUnit::OP_INST_HLT = 0b01110110;
-
-ControlUnit::ControlUnit(sc_core::sc_module_name name)
-    : sc_core::sc_module(name), pc(0) {
-    SC_THREAD(execute);
+namespace {
+    // Maps an instruction register code (SSS/DDD) to the MUX select line
+    constexpr uint8_t SelectRegister(uint8_t regCode) {
+        switch (regCode) {
+            case 0b00000000: return SELECT_REG_B;
+            case 0b00000001: return SELECT_REG_C;
+            case 0b00000010: return SELECT_REG_D;
+            case 0b00000011: return SELECT_REG_E;
+            case 0b00000100: return SELECT_REG_H;
+            case 0b00000101: return SELECT_REG_L;
+            default: return SELECT_REG_A;
+        }
+    }
+}
+
+template<typename Types>
+BasicControlUnit<Types>::BasicControlUnit(sc_core::sc_module_name name, Sequencer sequencer, RegisterAccess registerAccess)
+    : sc_core::sc_module(name)
+    , memorySocket("memorySocket")
+    , registerFile("registerFile")
+    , sequencer(sequencer)
+    , registerAccess(registerAccess)
+    , stage(Stage::Start)
+    , phase(0)
+    , fetched(0)
+    , step(0)
+    , pendingClocks(0)
+    , stopped(false)
+    , instructionAddress(0)
+    , current {}
+    , latches {}
+    , memoryAccess(MemoryAccess::Pins)
+    , stopOnHalt(true)
+    , idle(false)
+    , decoupled(false)
+    , quantumChanged(false)
+    , syncRequested(false)
+    , cyclePeriod(SC_ZERO_TIME)
+    , instructions(0)
+    , cycles(0)
+    , dmiValid {}
+    , dmiNext(0)
+    , dmiEnabled(true)
+    , blockCacheEnabled(false)
+    , blockInvalidated(false)
+    , traceWriter(nullptr)
+    , traceRecord {}
+    , traceRegisters {}
+    , profiler(nullptr)
+    , pc(0) {
+    if (sequencer == Sequencer::Method) {
+        SC_METHOD(sequence);
+    } else {
+        SC_THREAD(execute);
+    }
     sensitive << clock.pos();  // Add clock sensitivity for positive edge
     dont_initialize();
+
+    memorySocket.register_invalidate_direct_mem_ptr(this, &BasicControlUnit::invalidateDirectMemPtr);
+}
+
+template<typename Types>
+typename BasicControlUnit<Types>::Sequencer BasicControlUnit<Types>::getSequencer() const {
+    return sequencer;
+}
+
+template<typename Types>
+typename BasicControlUnit<Types>::RegisterAccess BasicControlUnit<Types>::getRegisterAccess() const {
+    return registerAccess;
 }
 
-void ControlUnit::reset() {
-    logger()->trace("Resetting...");
+template<typename Types>
+void BasicControlUnit<Types>::reset() {
+    SIM_TRACE(logger(), "Resetting...");
     pc = 0x0;
     sp = 0x0;
     flags = 0x0;
+    idle = false;
+    traceRegisters.fill(0);
 #ifdef ENABLE_TESTING
     doResetting();
 #endif
 }
 
-sc_dt::sc_uint<8> ControlUnit::readReg(sc_dt::sc_uint<8> source) {
-    logger()->trace("Reading register {}...", utils::to_binary(source.to_uint()));
+template<typename Types>
+uint8_t BasicControlUnit<Types>::readReg(uint8_t source) {
+    SIM_TRACE(logger(), "Reading register {}...", utils::to_binary(source));
+    if (registerAccess == RegisterAccess::Direct) {
+        return registerFile->read(source);
+    }
     muxSelect.write(source);        // Set active data source
     muxReadEnable.write(true);      // Set read signal high
     wait(SC_ZERO_TIME);             // Wait for one cycle
     muxReadEnable.write(false);     // Clear read signal
     wait(SC_ZERO_TIME);             // Wait for one cycle
-    return inputMux.read();
+    return static_cast<uint8_t>(ToUnsigned(inputMux.read()));
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::setMemoryAccess(MemoryAccess access) {
+    memoryAccess = access;
+}
+
+template<typename Types>
+typename BasicControlUnit<Types>::MemoryAccess BasicControlUnit<Types>::getMemoryAccess() const {
+    return memoryAccess;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::setQuantum(const sc_core::sc_time& quantum) {
+    if (sequencer == Sequencer::Method && quantum != SC_ZERO_TIME) {
+        throw std::runtime_error("setQuantum(): temporal decoupling needs the thread sequencer");
+    }
+    tlm_utils::tlm_quantumkeeper::set_global_quantum(quantum);
+    decoupled = quantum != SC_ZERO_TIME;
+    quantumChanged = true;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::setStopOnHalt(bool stop) {
+    stopOnHalt = stop;
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::isIdle() const {
+    return idle;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::requestSync() {
+    syncRequested = true;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::setCyclePeriod(const sc_core::sc_time& period) {
+    cyclePeriod = period;
+}
+
+template<typename Types>
+uint64_t BasicControlUnit<Types>::instructionCount() const {
+    return instructions;
+}
+
+template<typename Types>
+uint64_t BasicControlUnit<Types>::cycleCount() const {
+    return cycles;
+}
+
+template<typename Types>
+uint8_t BasicControlUnit<Types>::instructionLength(uint8_t opcode) {
+    return dispatchTable[opcode].length;
+}
+
+template<typename Types>
+uint8_t BasicControlUnit<Types>::instructionCycles(uint8_t opcode) {
+    return dispatchTable[opcode].cycles;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::synchronize(uint8_t clocks) {
+    if (quantumChanged) {
+        // Consume the local time under the previous quantum and restart with the new one
+        quantumKeeper.sync();
+        quantumChanged = false;
+    }
+
+    if (decoupled) {
+        quantumKeeper.inc(cyclePeriod * clocks);    // T-states of the instruction as in the clocked mode
+        if (syncRequested || quantumKeeper.need_sync()) {
+            SIM_TRACE(logger(), "sync @ {}", quantumKeeper.get_current_time().to_string());
+            syncRequested = false;
+            quantumKeeper.sync();
+        }
+    } else {
+        // Consume the delay annotated by memory transactions
+        if (quantumKeeper.get_local_time() != SC_ZERO_TIME) {
+            quantumKeeper.sync();
+        }
+        syncRequested = false;
+        wait(clocks != 0 ? clocks : 1);             // One clock edge per T-state, traps take none but must still yield
+    }
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::setDmiEnabled(bool enabled) {
+    dmiEnabled = enabled;
+    dmiValid.fill(false);
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::invalidateDirectMemPtr(sc_dt::uint64 start, sc_dt::uint64 end) {
+    for (size_t i = 0; i < DMI_REGIONS; ++i) {
+        if (dmiValid[i] && start <= dmiRegions[i].get_end_address() && end >= dmiRegions[i].get_start_address()) {
+            SIM_TRACE(logger(), "DMI pointer revoked");
+            dmiValid[i] = false;
+        }
+    }
+    // The memory content may have changed (e.g. a new program has been loaded)
+    invalidateBlocks(static_cast<uint16_t>(std::min<sc_dt::uint64>(start, 0xFFFF)), static_cast<uint16_t>(std::min<sc_dt::uint64>(end, 0xFFFF)));
+}
+
+template<typename Types>
+uint8_t BasicControlUnit<Types>::transport(tlm::tlm_command command, uint16_t address, uint8_t value) {
+    // Fast path: access the memory storage directly
+    bool granted = false;
+    for (size_t i = 0; i < DMI_REGIONS; ++i) {
+        const tlm::tlm_dmi& dmi = dmiRegions[i];
+        if (!dmiValid[i] || address < dmi.get_start_address() || address > dmi.get_end_address()) {
+            continue;
+        }
+        unsigned char* data = dmi.get_dmi_ptr() + (address - dmi.get_start_address());
+        if (command == tlm::TLM_READ_COMMAND && dmi.is_read_allowed()) {
+            quantumKeeper.inc(dmi.get_read_latency());
+            return *data;
+        }
+        if (command == tlm::TLM_WRITE_COMMAND && dmi.is_write_allowed()) {
+            quantumKeeper.inc(dmi.get_write_latency());
+            *data = value;
+            return value;
+        }
+        granted = true;     // Not for this command, e.g. a write to ROM
+        break;
+    }
+
+    uint8_t data = value;
+    payload.set_command(command);
+    payload.set_address(address);
+    payload.set_data_ptr(&data);
+    payload.set_data_length(1);
+    payload.set_streaming_width(1);
+    payload.set_byte_enable_ptr(nullptr);
+    payload.set_dmi_allowed(false);
+    payload.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+    sc_time delay = quantumKeeper.get_local_time();
+    memorySocket->b_transport(payload, delay);
+    quantumKeeper.set(delay);
+
+    if (payload.is_response_error()) {
+        SIM_ERROR(logger(), "Memory transaction at address {} failed: {}", address, payload.get_response_string());
+        SC_REPORT_ERROR(name(), "memory transaction failed");
+    }
+
+    if (dmiEnabled && !granted && payload.is_dmi_allowed()) {
+        tlm::tlm_dmi& dmi = dmiRegions[dmiNext];
+        dmi.init();
+        dmiValid[dmiNext] = memorySocket->get_direct_mem_ptr(payload, dmi);
+        if (dmiValid[dmiNext]) {
+            dmiNext = (dmiNext + 1) % DMI_REGIONS;
+        }
+    }
+    return data;
 }
 
-sc_dt::sc_uint<8> ControlUnit::readMemAt(sc_dt::sc_uint<16> address) {
-    logger()->trace("Reading memory at address {} ", address.to_uint());
+template<typename Types>
+uint8_t BasicControlUnit<Types>::readMemAt(uint16_t address) {
+    SIM_TRACE(logger(), "Reading memory at address {} ", address);
+    if (memoryAccess == MemoryAccess::Transaction) {
+        return transport(tlm::TLM_READ_COMMAND, address, 0);
+    }
     addressBus.write(address);      // Set memory address to fetch instruction/operand
     memoryReadEnable.write(true);   // Set read signal high
     wait(SC_ZERO_TIME);             // Wait for one cycle
     memoryReadEnable.write(false);  // Clear read signal
     wait(SC_ZERO_TIME);             // Wait for one cycle
-    return dataBusIn.read();
+    return static_cast<uint8_t>(ToUnsigned(dataBusIn.read()));
 }
 
-void ControlUnit::writeReg(sc_dt::sc_uint<8> source, sc_dt::sc_uint<8> value) {
-    logger()->trace("Writing value {} to register {} ", value.to_uint(), utils::to_binary(source.to_uint()));
+template<typename Types>
+void BasicControlUnit<Types>::writeReg(uint8_t source, uint8_t value) {
+    SIM_TRACE(logger(), "Writing value {} to register {} ", value, utils::to_binary(source));
+    traceRegisters[source % traceRegisters.size()] = value;
+    if (registerAccess == RegisterAccess::Direct) {
+        registerFile->write(source, value);
+        return;
+    }
     muxSelect.write(source);        // Set active data source to drive the bus
     outputMux.write(value);
     muxWriteEnable.write(true);     // Set write signal high
@@ -89,8 +305,19 @@ void ControlUnit::writeReg(sc_dt::sc_uint<8> source, sc_dt::sc_uint<8> value) {
     muxWriteEnable.write(false);    // Clear read signal
 }
 
-void ControlUnit::writeMemAt(sc_dt::sc_uint<16> address, sc_dt::sc_uint<8> value) {
-    logger()->trace("Writing value {} to memory at address {} ", value.to_uint(), address.to_uint());
+template<typename Types>
+void BasicControlUnit<Types>::writeMemAt(uint16_t address, uint8_t value) {
+    SIM_TRACE(logger(), "Writing value {} to memory at address {} ", value, address);
+    if (blockCacheEnabled) {
+        invalidateBlocks(address, address);
+    }
+    traceRecord.flags = TRACE_MEMORY_WRITE;
+    traceRecord.writeAddress = address;
+    traceRecord.writeValue = value;
+    if (memoryAccess == MemoryAccess::Transaction) {
+        transport(tlm::TLM_WRITE_COMMAND, address, value);
+        return;
+    }
     addressBus.write(address);      // Set memory address to fetch instruction/operand
     dataBusOut.write(value);
     memoryWriteEnable.write(true);
@@ -98,15 +325,17 @@ void ControlUnit::writeMemAt(sc_dt::sc_uint<16> address, sc_dt::sc_uint<8> value
     memoryWriteEnable.write(false);
 }
 
-void ControlUnit::waitFor(int clocks) {
-    for (int i = 0; i < clocks; ++i) {
-        logger()->trace("wait for 1 cycle");
-        wait(SC_ZERO_TIME); // 1 cycle
+template<typename Types>
+void BasicControlUnit<Types>::waitFor(int deltas) {
+    for (int i = 0; i < deltas; ++i) {
+        SIM_TRACE(logger(), "wait for 1 delta cycle");
+        wait(SC_ZERO_TIME);
     }
 }
 
-void ControlUnit::execute() {
-    logger()->trace("execution started");
+template<typename Types>
+void BasicControlUnit<Types>::execute() {
+    SIM_TRACE(logger(), "execution started");
 
     while (true) {
 
@@ -126,166 +355,688 @@ void ControlUnit::execute() {
             continue;
         }
 #endif
+        if (idle) {
+            wait();
+            continue;
+        }
+
+        SIM_TRACE(logger(), "thread triggered @ {}", sc_time_stamp().to_string());
 
-        logger()->trace("thread triggered @ {}", sc_time_stamp().to_string());
+        if (blockCacheEnabled) {
+            executeBlock();
+            continue;
+        }
 
         // fetch & decode & execute
-        const uint8_t instruction = readMemAt(pc).to_uint(); // 1 cycle
-        const uint8_t opgroup = (instruction >> 6) & 0b00000011;
-        const uint8_t opcode = (instruction >> 3) & 0b00000111;
-        const uint8_t source = instruction & 0b00000111;
-        const uint8_t rp = (instruction >> 4) & 0b00000011;
-        const uint8_t rp_opcode = instruction & 0b00001111;
-
-
-        if(instruction != OP_INST_NOP) {
-            logger()->trace("pc [{}] -> {} (group: {}, code: {}, source: {})", 
-                pc.to_uint(),
-                utils::to_binary(instruction), 
-                utils::to_binary(opgroup), 
-                utils::to_binary(opcode), 
-                utils::to_binary(source));
+        const uint16_t address = static_cast<uint16_t>(ToUnsigned(pc));
+        const Instruction instruction = fetch(address);
+        (this->*instruction.handler)(instruction);
+
+        retire(instruction, address);
+        synchronize(instruction.cycles);
+    }
+}
+
+template<typename Types>
+typename BasicControlUnit<Types>::Instruction BasicControlUnit<Types>::fetch(uint16_t address) {
+    const uint8_t opcode = readMemAt(address); // 1 cycle
+    Instruction instruction = dispatchTable[opcode];
+    for (uint8_t i = 1; i < instruction.length; ++i) {
+        instruction.operands[i - 1] = readMemAt(static_cast<uint16_t>(address + i)); // 1 cycle
+    }
+
+    if(opcode != OP_INST_NOP) {
+        SIM_TRACE(logger(), "pc [{}] -> {}", address, utils::to_binary(opcode));
+    }
+    return instruction;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::retire(const Instruction& instruction, uint16_t address) {
+    if (instruction.handler == &BasicControlUnit::trap) {
+        return;     // Not executed, the FunctionalEngine doesn't count it either
+    }
+    ++instructions;
+    cycles += instruction.cycles;
+    if (traceWriter != nullptr) {
+        traceInstruction(instruction, address);
+    }
+    if (profiler != nullptr) {
+        profiler->record(address, instruction.opcode, instruction.cycles);
+    }
+}
+
+// MARK: - Execution trace
+
+template<typename Types>
+void BasicControlUnit<Types>::setTraceWriter(TraceWriter* writer) {
+    traceWriter = writer;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::traceInstruction(const Instruction& instruction, uint16_t address) {
+    traceRecord.cycles = instruction.cycles;
+    traceRecord.pc = address;
+    traceRecord.sp = static_cast<uint16_t>(ToUnsigned(sp));
+    traceRecord.bytes = {instruction.opcode, instruction.operands[0], instruction.operands[1]};
+    traceRecord.length = instruction.length;
+    traceRecord.registers = traceRegisters;
+    traceRecord.flags |= static_cast<uint8_t>(ToUnsigned(flags));
+    traceWriter->record(traceRecord);
+
+    // The next instruction starts without a memory write
+    traceRecord.flags = 0;
+    traceRecord.writeAddress = 0;
+    traceRecord.writeValue = 0;
+}
+
+// MARK: - Guest profiler
+
+template<typename Types>
+void BasicControlUnit<Types>::setProfiler(Profiler* guestProfiler) {
+    profiler = guestProfiler;
+}
+
+// MARK: - Block cache
+
+template<typename Types>
+void BasicControlUnit<Types>::setBlockCacheEnabled(bool enabled) {
+    if (sequencer == Sequencer::Method && enabled) {
+        throw std::runtime_error("setBlockCacheEnabled(): the block cache needs the thread sequencer");
+    }
+    blockCacheEnabled = enabled;
+    if (!enabled) {
+        invalidateBlocks(0x0000, 0xFFFF);
+    }
+}
+
+template<typename Types>
+const typename BasicControlUnit<Types>::BlockCacheStats& BasicControlUnit<Types>::blockCacheStats() const {
+    return blockStats;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::executeBlock() {
+    const uint16_t start = static_cast<uint16_t>(ToUnsigned(pc));
+
+    std::shared_ptr<const Block> block;
+    if (const auto it = blocks.find(start); it != blocks.end()) {
+        ++blockStats.hits;
+        block = it->second;
+    } else {
+        ++blockStats.misses;
+        auto decoded = std::make_shared<Block>();
+        decoded->start = start;
+        uint16_t address = start;
+        while (true) {
+            const Instruction instruction = fetch(address);
+            decoded->instructions.push_back(instruction);
+            decoded->end = static_cast<uint16_t>(address + instruction.length - 1);
+            address = static_cast<uint16_t>(address + instruction.length);
+
+            const bool stops = instruction.handler == &BasicControlUnit::executeHlt || instruction.handler == &BasicControlUnit::trap;
+            const bool pageEnd = (address >> PAGE_SHIFT) != (start >> PAGE_SHIFT);
+            if (stops || pageEnd || decoded->instructions.size() == MAX_BLOCK_INSTRUCTIONS) {
+                break;
+            }
+        }
+
+        // Register the block with every page it touches (the last operand may cross a page, or wrap around)
+        for (unsigned page = start >> PAGE_SHIFT; ; page = (page + 1) % PAGE_COUNT) {
+            auto& starts = pageBlocks[page];
+            if (std::find(starts.begin(), starts.end(), start) == starts.end()) {
+                starts.push_back(start);
+            }
+            if (page == (decoded->end >> PAGE_SHIFT)) {
+                break;
+            }
         }
+        block = blocks.emplace(start, std::move(decoded)).first->second;
+    }
 
-        switch (opgroup)
-        {
-        case OP_GROUP_DATA_TRANSFER:
-            if(instruction == OP_INST_NOP) { // NOP
-                waitFor(4);
-                ++pc;
+    blockInvalidated = false;
+    uint16_t address = start;
+    for (const Instruction& instruction : block->instructions) {
+        (this->*instruction.handler)(instruction);
+
+        retire(instruction, address);
+        synchronize(instruction.cycles);
+
+        // Leave the block when it was rewritten, on HLT or a trap and when PC has been changed from outside (reset)
+        address = static_cast<uint16_t>(address + instruction.length);
+        if (blockInvalidated || pc != address) {
+            break;
+        }
+    }
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::invalidateBlocks(uint16_t start, uint16_t end) {
+    for (unsigned page = start >> PAGE_SHIFT; page <= static_cast<unsigned>(end >> PAGE_SHIFT); ++page) {
+        auto& starts = pageBlocks[page];
+        for (const uint16_t address : starts) {
+            if (blocks.erase(address) != 0) {
+                ++blockStats.invalidations;
+                blockInvalidated = true;
             }
+        }
+        starts.clear();
+    }
+}
+
+// MARK: - Method sequencer
 
-            if(source == 0b00000110) {      // MVI ddd,data 
-                setRegisterValue(opcode, readMemAt(++pc)); // 1 cycle
-                if(source == OP_REG_M) {
-                    waitFor(9);
+template<typename Types>
+void BasicControlUnit<Types>::sequence() {
+    while (true) {
+        switch (stage) {
+            case Stage::Start:
+#ifdef ENABLE_TESTING
+                if (isResetted()) {
+                    step = 0;
+                    stage = Stage::Reset;
+                    break;
+                }
+                if (isHalted()) {
+                    next_trigger();
+                    return;
+                }
+#endif
+                if (idle) {
+                    next_trigger();
+                    return;
+                }
+                SIM_TRACE(logger(), "method triggered @ {}", sc_time_stamp().to_string());
+                instructionAddress = static_cast<uint16_t>(ToUnsigned(pc));
+                fetched = 0;
+                stopped = false;
+                stage = Stage::Fetch;
+                break;
+
+            case Stage::Reset:
+                // Clears A ... L as the thread does (SELECT_REG_A is 0, SELECT_REG_L is 6)
+                if (!writeRegPhase(step, 0)) {
+                    next_trigger(SC_ZERO_TIME);
+                    return;
+                }
+                if (++step == traceRegisters.size()) {
+#ifdef ENABLE_TESTING
+                    doneResetting();
+#endif
+                    stage = Stage::Start;
+                }
+                break;
+
+            case Stage::Fetch: {
+                uint8_t byte = 0;
+                if (!readMemPhase(static_cast<uint16_t>(instructionAddress + fetched), byte)) {
+                    next_trigger(SC_ZERO_TIME);
+                    return;
+                }
+                if (fetched == 0) {
+                    current = dispatchTable[byte];
+                    if (byte != OP_INST_NOP) {
+                        SIM_TRACE(logger(), "pc [{}] -> {}", instructionAddress, utils::to_binary(byte));
+                    }
                 } else {
-                    waitFor(6);
+                    current.operands[fetched - 1] = byte;
                 }
-                ++pc;
-            } else if(rp_opcode == 0b00000001) { // LXI rp,data
-                const sc_dt::sc_uint<8> low = readMemAt(++pc);
-                const sc_dt::sc_uint<8> high = readMemAt(++pc);
-                switch(rp) {
-                    case OP_RP_BC:
-                        writeReg(SELECT_REG_B, high);
-                        writeReg(SELECT_REG_C, low);
-                    break;
-                    case OP_RP_DE:
-                        writeReg(SELECT_REG_D, high);
-                        writeReg(SELECT_REG_E, low);
-                    break;
-                    case OP_RP_HL:
-                        writeReg(SELECT_REG_H, high);
-                        writeReg(SELECT_REG_L, low);
-                    break;
-                    case OP_RP_SP:
-                        sp = (high << 8) | low;
-                    break;
+                if (++fetched == current.length) {
+                    latches[LATCH_IMMEDIATE_LOW] = current.operands[0];
+                    latches[LATCH_IMMEDIATE_HIGH] = current.operands[1];
+                    step = 0;
+                    stage = Stage::Execute;
                 }
-                ++pc;
+                break;
             }
-            
-        break;
-    
-        case OP_GROUP_MOV:
-            if(instruction == OP_INST_HLT) { // HLT
-                waitFor(7);
-#ifdef ENABLE_TESTING
-                /*
-                    Once sc_stop() has been called,
-                    the simulation enters a "terminated" state, and sc_start() cannot be called
-                    again within the same execution context.
-                */
-                {
-                    std::lock_guard guard(mutex);
-                    halted = true;
+
+            case Stage::Execute: {
+                const MicroProgram& program = microPrograms[current.opcode];
+                if (step < program.size) {
+                    if (!microStep(program.ops[step])) {
+                        next_trigger(SC_ZERO_TIME);
+                        return;
+                    }
+                    ++step;
+                    break;
                 }
-#else
-                logger()->info("HLT: Stopping execution...");
-                sc_stop();
-#endif
+
+                if (!stopped) {
+                    pc += current.length;
+                }
+                retire(current, instructionAddress);
+                stage = Stage::Start;
+
+                // As the thread does: the delay annotated by memory transactions, then the T-states
+                // of the instruction counted in clock edges, so the method always wakes up on an edge
+                const sc_time delay = quantumKeeper.get_local_time();
+                quantumKeeper.reset();
+                syncRequested = false;
+                pendingClocks = current.cycles != 0 ? current.cycles : 1;
+                if (cyclePeriod == SC_ZERO_TIME) {
+                    next_trigger();     // No period known, the next clock edge
+                } else if (delay == SC_ZERO_TIME) {
+                    next_trigger(cyclePeriod * pendingClocks);
+                } else {
+                    stage = Stage::Delay;
+                    next_trigger(delay);
+                }
+                return;
             }
-        break;
 
-        case OP_GROUP_ALU:
-            aluAccumulator.write(readReg(SELECT_REG_A)); // 1 cycle
-            aluOpcode.write(opcode);
-            aluOperand.write(getRegisterValue(source)); // 3 cycle if source is OP_REG_M or 1 cycle
-            if(source == OP_REG_M) { // If the operand is located in memory -> 7 clocks cycles - 5 cycles that have already passed
-                waitFor(2);
+            case Stage::Delay:
+                // The first edge after the delay may fall on the same time step, let the clock notify it
+                stage = Stage::Clocks;
+                next_trigger();
+                return;
+
+            case Stage::Clocks:
+                stage = Stage::Start;
+                if (--pendingClocks != 0) {
+                    next_trigger(cyclePeriod * pendingClocks);
+                    return;
+                }
+                break;
+        }
+    }
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::microStep(const MicroOp& op) {
+    const uint16_t hl = static_cast<uint16_t>(latches[LATCH_HIGH] << 8 | latches[LATCH_LOW]);
+    switch (op.kind) {
+        case MicroKind::ReadRegister:
+            return readRegPhase(op.select, latches[op.latch]);
+        case MicroKind::ReadMemory:
+            return readMemPhase(hl, latches[op.latch]);
+        case MicroKind::WriteRegister:
+            return writeRegPhase(op.select, latches[op.latch]);
+        case MicroKind::WriteMemory:
+            return writeMemPhase(hl, latches[op.latch]);
+        case MicroKind::Alu:
+            return aluPhase(op.select, latches[op.latch]);
+        case MicroKind::LoadStackPointer:
+            sp = (latches[LATCH_IMMEDIATE_HIGH] << 8) | latches[LATCH_IMMEDIATE_LOW];
+            return true;
+        case MicroKind::Halt:
+            stopped = true;
+            executeHlt(current);
+            return true;
+        case MicroKind::Trap:
+            stopped = true;
+            trap(current);
+            return true;
+    }
+    return true;
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::readMemPhase(uint16_t address, uint8_t& value) {
+    if (memoryAccess == MemoryAccess::Transaction) {
+        SIM_TRACE(logger(), "Reading memory at address {} ", address);
+        value = transport(tlm::TLM_READ_COMMAND, address, 0);
+        return true;
+    }
+    switch (phase++) {
+        case 0:
+            SIM_TRACE(logger(), "Reading memory at address {} ", address);
+            addressBus.write(address);
+            memoryReadEnable.write(true);
+            return false;
+        case 1:
+            memoryReadEnable.write(false);
+            return false;
+        default:
+            value = static_cast<uint8_t>(ToUnsigned(dataBusIn.read()));
+            phase = 0;
+            return true;
+    }
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::writeMemPhase(uint16_t address, uint8_t value) {
+    if (phase == 0) {
+        SIM_TRACE(logger(), "Writing value {} to memory at address {} ", value, address);
+        traceRecord.flags = TRACE_MEMORY_WRITE;
+        traceRecord.writeAddress = address;
+        traceRecord.writeValue = value;
+        if (memoryAccess == MemoryAccess::Transaction) {
+            transport(tlm::TLM_WRITE_COMMAND, address, value);
+            return true;
+        }
+        addressBus.write(address);
+        dataBusOut.write(value);
+        memoryWriteEnable.write(true);
+        phase = 1;
+        return false;
+    }
+    memoryWriteEnable.write(false);
+    phase = 0;
+    return true;
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::readRegPhase(uint8_t select, uint8_t& value) {
+    if (registerAccess == RegisterAccess::Direct) {
+        SIM_TRACE(logger(), "Reading register {}...", utils::to_binary(select));
+        value = registerFile->read(select);
+        return true;
+    }
+    switch (phase++) {
+        case 0:
+            SIM_TRACE(logger(), "Reading register {}...", utils::to_binary(select));
+            muxSelect.write(select);
+            muxReadEnable.write(true);
+            return false;
+        case 1:
+            muxReadEnable.write(false);
+            return false;
+        default:
+            value = static_cast<uint8_t>(ToUnsigned(inputMux.read()));
+            phase = 0;
+            return true;
+    }
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::writeRegPhase(uint8_t select, uint8_t value) {
+    if (phase == 0) {
+        SIM_TRACE(logger(), "Writing value {} to register {} ", value, utils::to_binary(select));
+        traceRegisters[select % traceRegisters.size()] = value;
+        if (registerAccess == RegisterAccess::Direct) {
+            registerFile->write(select, value);
+            return true;
+        }
+        muxSelect.write(select);
+        outputMux.write(value);
+        muxWriteEnable.write(true);
+        phase = 1;
+        return false;
+    }
+    muxWriteEnable.write(false);
+    phase = 0;
+    return true;
+}
+
+template<typename Types>
+bool BasicControlUnit<Types>::aluPhase(uint8_t operation, uint8_t operand) {
+    switch (phase++) {
+        case 0:
+            aluOpcode.write(operation);
+            aluAccumulator.write(latches[LATCH_ACCUMULATOR]);
+            aluOperand.write(operand);
+            return false;
+        case 1:
+            return false;   // The ALU evaluates in this delta cycle, its outputs are visible in the next one
+        default:
+            latches[LATCH_ACCUMULATOR] = static_cast<uint8_t>(ToUnsigned(aluResult.read()));
+            flags = aluFlags.read();
+            phase = 0;
+            return true;
+    }
+}
+
+template<typename Types>
+typename BasicControlUnit<Types>::MicroProgram BasicControlUnit<Types>::microDecode(uint8_t opcode) {
+    const uint8_t code = (opcode >> 3) & 0b00000111;
+    const uint8_t source = opcode & 0b00000111;
+    const uint8_t rp = (opcode >> 4) & 0b00000011;
+
+    MicroProgram program {};
+    const auto push = [&program](MicroKind kind, uint8_t select, uint8_t latch) {
+        program.ops[program.size++] = {kind, select, latch};
+    };
+    const auto readHL = [&push]() {
+        push(MicroKind::ReadRegister, SELECT_REG_H, LATCH_HIGH);
+        push(MicroKind::ReadRegister, SELECT_REG_L, LATCH_LOW);
+    };
+
+    // The classification of decode() and the access order of the handlers
+    switch (classify(opcode)) {
+        case InstructionClass::Nop:
+            break;      // Nothing but the fetch
+        case InstructionClass::Mvi:
+            if (code == OP_REG_M) {
+                readHL();
+                push(MicroKind::WriteMemory, 0, LATCH_IMMEDIATE_LOW);
             } else {
-                waitFor(1);
+                push(MicroKind::WriteRegister, SelectRegister(code), LATCH_IMMEDIATE_LOW);
             }
-            writeReg(SELECT_REG_A, aluResult.read());   // 1 cycle
-            flags = aluFlags.read();
-            ++pc;
             break;
-        
-        case OP_GROUP_SPECIAL:
-            if(source == OP_REG_M) {          // ALU Immediate
-                aluOpcode.write(opcode);
-                aluOperand.write(readMemAt(++pc));  // 1 cycle
-                aluAccumulator.write(readReg(SELECT_REG_A)); // 1 cycle
-                waitFor(4); // clocks = 7 - 3
-                writeReg(SELECT_REG_A, aluResult.read());
-                flags = aluFlags.read();
-                ++pc;
+        case InstructionClass::Lxi:
+            if (rp == OP_RP_SP) {
+                push(MicroKind::LoadStackPointer, 0, 0);
+            } else {
+                push(MicroKind::WriteRegister, SelectRegister(static_cast<uint8_t>(rp << 1)), LATCH_IMMEDIATE_HIGH);
+                push(MicroKind::WriteRegister, SelectRegister(static_cast<uint8_t>(rp << 1 | 1)), LATCH_IMMEDIATE_LOW);
             }
             break;
-
-        default:
-            std::cerr << "Unknown opcode: " << std::hex << (int)instruction << std::dec << std::endl;
+        case InstructionClass::Hlt:
+            push(MicroKind::Halt, 0, 0);
             break;
-        }
-
-        wait();
-    }
-}
-
-sc_dt::sc_uint<8> ControlUnit::getRegisterValue(uint8_t regCode) {
-    switch (regCode) {
-        case OP_REG_A: return readReg(SELECT_REG_A); // 1 cycle
-        case OP_REG_B: return readReg(SELECT_REG_B); // 1 cycle            
-        case OP_REG_C: return readReg(SELECT_REG_C); // 1 cycle
-        case OP_REG_D: return readReg(SELECT_REG_D); // 1 cycle
-        case OP_REG_E: return readReg(SELECT_REG_E); // 1 cycle
-        case OP_REG_H: return readReg(SELECT_REG_H); // 1 cycle
-        case OP_REG_L: return readReg(SELECT_REG_L); // 1 cycle
-        case OP_REG_M: 
-        {
-            const sc_dt::sc_uint<8> h = readReg(SELECT_REG_H); // 1 cycle
-            const sc_dt::sc_uint<8> l = readReg(SELECT_REG_L); // 1 cycle
-            // Get the memory value pointed to by HL
-            const sc_dt::sc_uint<16> address = (h << 8) | l;
-            // Memory at (HL), read from the bus
-            return readMemAt(address); // 1 cycle
-        }
-        default: return 0; // Should not happen
-    }
-}
-
-void ControlUnit::setRegisterValue(uint8_t regCode, sc_dt::sc_uint<8> value) {
-    switch (regCode) {
-        case OP_REG_A: return writeReg(SELECT_REG_A, value); // 1 cycle
-        case OP_REG_B: return writeReg(SELECT_REG_B, value); // 1 cycle
-        case OP_REG_C: return writeReg(SELECT_REG_C, value); // 1 cycle
-        case OP_REG_D: return writeReg(SELECT_REG_D, value); // 1 cycle
-        case OP_REG_E: return writeReg(SELECT_REG_E, value); // 1 cycle
-        case OP_REG_H: return writeReg(SELECT_REG_H, value); // 1 cycle
-        case OP_REG_L: return writeReg(SELECT_REG_L, value); // 1 cycle
-        case OP_REG_M: 
-        {
-            const sc_dt::sc_uint<8> h = readReg(SELECT_REG_H); // 1 cycle
-            const sc_dt::sc_uint<8> l = readReg(SELECT_REG_L); // 1 cycle
-            // Get the memory value pointed to by HL
-            const sc_dt::sc_uint<16> address = (h << 8) | l;
-            // Memory at (HL), read from the bus
-            writeMemAt(address, value); // 1 cycle
+        case InstructionClass::Alu:
+            push(MicroKind::ReadRegister, SELECT_REG_A, LATCH_ACCUMULATOR);
+            if (source == OP_REG_M) {
+                readHL();
+                push(MicroKind::ReadMemory, 0, LATCH_OPERAND);
+            } else {
+                push(MicroKind::ReadRegister, SelectRegister(source), LATCH_OPERAND);
+            }
+            push(MicroKind::Alu, code, LATCH_OPERAND);
+            push(MicroKind::WriteRegister, SELECT_REG_A, LATCH_ACCUMULATOR);
+            break;
+        case InstructionClass::AluImmediate:
+            push(MicroKind::ReadRegister, SELECT_REG_A, LATCH_ACCUMULATOR);
+            push(MicroKind::Alu, code, LATCH_IMMEDIATE_LOW);
+            push(MicroKind::WriteRegister, SELECT_REG_A, LATCH_ACCUMULATOR);
+            break;
+        case InstructionClass::Unknown:
+            push(MicroKind::Trap, 0, 0);
             break;
-        }
-        default: break; // Should not happen
     }
+    return program;
 }
 
+template<typename Types>
+const std::array<typename BasicControlUnit<Types>::MicroProgram, 256> BasicControlUnit<Types>::microPrograms = [] {
+    std::array<MicroProgram, 256> programs {};
+    for (size_t opcode = 0; opcode < programs.size(); ++opcode) {
+        programs[opcode] = microDecode(static_cast<uint8_t>(opcode));
+    }
+    return programs;
+}();
+
+// MARK: - Instruction handlers
+
+template<typename Types>
+void BasicControlUnit<Types>::executeNop(Instruction instruction) {
+    pc += instruction.length;
+}
+
+template<typename Types>
+template<uint8_t Dst>
+void BasicControlUnit<Types>::executeMvi(Instruction instruction) {     // MVI ddd,data
+    setRegisterValue<Dst>(instruction.operands[0]);
+    pc += instruction.length;
+}
+
+template<typename Types>
+template<uint8_t RegisterPair>
+void BasicControlUnit<Types>::executeLxi(Instruction instruction) {     // LXI rp,data
+    const uint8_t low = instruction.operands[0];
+    const uint8_t high = instruction.operands[1];
+    if constexpr (RegisterPair == OP_RP_BC) {
+        writeReg(SELECT_REG_B, high);
+        writeReg(SELECT_REG_C, low);
+    } else if constexpr (RegisterPair == OP_RP_DE) {
+        writeReg(SELECT_REG_D, high);
+        writeReg(SELECT_REG_E, low);
+    } else if constexpr (RegisterPair == OP_RP_HL) {
+        writeReg(SELECT_REG_H, high);
+        writeReg(SELECT_REG_L, low);
+    } else {
+        sp = (high << 8) | low;
+    }
+    pc += instruction.length;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::executeHlt(Instruction) {
+    stop();
+}
+
+template<typename Types>
+template<uint8_t Op, uint8_t Src>
+void BasicControlUnit<Types>::executeAlu(Instruction instruction) {     // ADD ... CMP sss
+    // Collect both arguments first and drive the ALU inputs in the same delta cycle,
+    // so the ALU doesn't evaluate (and update the carry) on half-written inputs.
+    const uint8_t accumulator = readReg(SELECT_REG_A); // 1 cycle
+    const uint8_t operand = getRegisterValue<Src>();    // 3 cycle if source is OP_REG_M or 1 cycle
+    aluOpcode.write(Op);
+    aluAccumulator.write(accumulator);
+    aluOperand.write(operand);
+    waitFor(2); // The ALU evaluates in the next delta cycle and its outputs are visible in the one after
+    writeReg(SELECT_REG_A, static_cast<uint8_t>(ToUnsigned(aluResult.read())));   // 1 cycle
+    flags = aluFlags.read();
+    pc += instruction.length;
+}
+
+template<typename Types>
+template<uint8_t Op>
+void BasicControlUnit<Types>::executeAluImmediate(Instruction instruction) { // ADI ... CPI data
+    const uint8_t operand = instruction.operands[0];
+    const uint8_t accumulator = readReg(SELECT_REG_A); // 1 cycle
+    aluOpcode.write(Op);
+    aluOperand.write(operand);
+    aluAccumulator.write(accumulator);
+    waitFor(2); // The ALU evaluates in the next delta cycle and its outputs are visible in the one after
+    writeReg(SELECT_REG_A, static_cast<uint8_t>(ToUnsigned(aluResult.read())));
+    flags = aluFlags.read();
+    pc += instruction.length;
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::trap(Instruction instruction) {
+    // PC stays at the offending instruction
+    SIM_ERROR(logger(), "Unknown opcode {} at pc [{}]", utils::to_binary(instruction.opcode), ToUnsigned(pc));
+    stop();
+}
+
+template<typename Types>
+void BasicControlUnit<Types>::stop() {
+    SIM_INFO(logger(), "HLT: Stopping execution at pc [{}]...", ToUnsigned(pc));
+    if (!stopOnHalt) {
+        idle = true;
+        sc_pause();
+        return;
+    }
+#ifdef ENABLE_TESTING
+    /*
+        Once sc_stop() has been called,
+        the simulation enters a "terminated" state, and sc_start() cannot be called
+        again within the same execution context.
+    */
+    {
+        std::lock_guard guard(mutex);
+        halted = true;
+        haltTime = sc_time_stamp();
+    }
+#else
+    sc_stop();
+#endif
+}
+
+// MARK: - Dispatch table
+
+template<typename Types>
+constexpr typename BasicControlUnit<Types>::InstructionClass BasicControlUnit<Types>::classify(uint8_t opcode) {
+    const uint8_t opgroup = (opcode >> 6) & 0b00000011;
+    const uint8_t source = opcode & 0b00000111;
+    const uint8_t rp_opcode = opcode & 0b00001111;
+
+    if (opcode == OP_INST_NOP) {
+        return InstructionClass::Nop;
+    } else if (opgroup == OP_GROUP_DATA_TRANSFER && source == 0b00000110) {
+        return InstructionClass::Mvi;
+    } else if (opgroup == OP_GROUP_DATA_TRANSFER && rp_opcode == 0b00000001) {
+        return InstructionClass::Lxi;
+    } else if (opcode == OP_INST_HLT) {
+        return InstructionClass::Hlt;
+    } else if (opgroup == OP_GROUP_ALU) {
+        return InstructionClass::Alu;
+    } else if (opgroup == OP_GROUP_SPECIAL && source == OP_REG_M) {
+        return InstructionClass::AluImmediate;
+    }
+    return InstructionClass::Unknown;
+}
+
+template<typename Types>
+template<uint8_t Opcode>
+constexpr typename BasicControlUnit<Types>::Instruction BasicControlUnit<Types>::decode() {
+    constexpr InstructionClass kind = classify(Opcode);
+    constexpr uint8_t opcode = (Opcode >> 3) & 0b00000111;
+    constexpr uint8_t source = Opcode & 0b00000111;
+    constexpr uint8_t rp = (Opcode >> 4) & 0b00000011;
+
+    if constexpr (kind == InstructionClass::Nop) {
+        return {&BasicControlUnit::executeNop, Opcode, 1, 4, {}};
+    } else if constexpr (kind == InstructionClass::Mvi) {
+        return {&BasicControlUnit::executeMvi<opcode>, Opcode, 2, opcode == OP_REG_M ? 10 : 7, {}};
+    } else if constexpr (kind == InstructionClass::Lxi) {
+        return {&BasicControlUnit::executeLxi<rp>, Opcode, 3, 10, {}};
+    } else if constexpr (kind == InstructionClass::Hlt) {
+        return {&BasicControlUnit::executeHlt, Opcode, 1, 7, {}};
+    } else if constexpr (kind == InstructionClass::Alu) {
+        return {&BasicControlUnit::executeAlu<opcode, source>, Opcode, 1, source == OP_REG_M ? 7 : 4, {}};
+    } else if constexpr (kind == InstructionClass::AluImmediate) {
+        return {&BasicControlUnit::executeAluImmediate<opcode>, Opcode, 2, 7, {}};
+    } else {
+        return {&BasicControlUnit::trap, Opcode, 1, 0, {}};
+    }
+}
+
+template<typename Types>
+template<size_t... Opcodes>
+constexpr std::array<typename BasicControlUnit<Types>::Instruction, 256> BasicControlUnit<Types>::makeDispatchTable(std::index_sequence<Opcodes...>) {
+    return {{ decode<static_cast<uint8_t>(Opcodes)>()... }};
+}
+
+template<typename Types>
+const std::array<typename BasicControlUnit<Types>::Instruction, 256> BasicControlUnit<Types>::dispatchTable = makeDispatchTable(std::make_index_sequence<256>{});
+
+// MARK: - Registers
+
+template<typename Types>
+template<uint8_t Reg>
+uint8_t BasicControlUnit<Types>::getRegisterValue() {
+    if constexpr (Reg == OP_REG_M) {
+        const uint8_t h = readReg(SELECT_REG_H); // 1 cycle
+        const uint8_t l = readReg(SELECT_REG_L); // 1 cycle
+        // Get the memory value pointed to by HL
+        const uint16_t address = static_cast<uint16_t>(h << 8 | l);
+        // Memory at (HL), read from the bus
+        return readMemAt(address); // 1 cycle
+    } else {
+        return readReg(SelectRegister(Reg)); // 1 cycle
+    }
+}
+
+template<typename Types>
+template<uint8_t Reg>
+void BasicControlUnit<Types>::setRegisterValue(uint8_t value) {
+    if constexpr (Reg == OP_REG_M) {
+        const uint8_t h = readReg(SELECT_REG_H); // 1 cycle
+        const uint8_t l = readReg(SELECT_REG_L); // 1 cycle
+        // Get the memory value pointed to by HL
+        const uint16_t address = static_cast<uint16_t>(h << 8 | l);
+        // Memory at (HL), read from the bus
+        writeMemAt(address, value); // 1 cycle
+    } else {
+        writeReg(SelectRegister(Reg), value); // 1 cycle
+    }
+}
+
+template class BasicControlUnit<NativeTypes>;
+template class BasicControlUnit<BitAccurateTypes>;
+
 } // namespace sim
@@ -0,0 +1,253 @@
+//
+//  engine.cpp
+//
+
+#include "engine.hpp"
+#include "alutable.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+namespace {
+    const sim::LogHandle& logger() { return sim::Log::engine; }
+
+    constexpr uint8_t OP_GROUP_DATA_TRANSFER = 0b00000000;
+    constexpr uint8_t OP_GROUP_MOV = 0b00000001;
+    constexpr uint8_t OP_GROUP_ALU = 0b00000010;
+    constexpr uint8_t OP_GROUP_SPECIAL = 0b00000011;
+
+    constexpr uint8_t OP_RP_BC = 0b00000000;
+    constexpr uint8_t OP_RP_DE = 0b00000001;
+    constexpr uint8_t OP_RP_HL = 0b00000010;
+    constexpr uint8_t OP_RP_SP = 0b00000011;
+
+    constexpr uint8_t OP_INST_NOP = 0b00000000;
+    constexpr uint8_t OP_INST_HLT = 0b01110110;
+}
+
+namespace sim {
+
+FunctionalEngine::FunctionalEngine()
+    : regs {}, memory {}, current(Status::Running), executed(0), cycles(0) {
+}
+
+FunctionalEngine::~FunctionalEngine() = default;
+
+void FunctionalEngine::reset() {
+    regs = State {};
+    memory.fill(0);
+    current = Status::Running;
+    executed = 0;
+    cycles = 0;
+    if (jit) {
+        jit->flush();
+    }
+}
+
+void FunctionalEngine::load(const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& data) {
+    memory = data;
+    if (jit) {
+        jit->flush();
+    }
+}
+
+uint64_t FunctionalEngine::memoryDigest() const {
+    return utils::Fnv1a(memory.data(), memory.size());
+}
+
+bool FunctionalEngine::setJitEnabled(bool enabled) {
+    if (!enabled) {
+        jit.reset();
+        return true;
+    }
+    if (!Jit::isSupported()) {
+        SIM_WARN(logger(), "JIT isn't supported on this host, interpreting");
+        return false;
+    }
+    if (!jit) {
+        jit = std::make_unique<Jit>();
+    }
+    return true;
+}
+
+Jit::Stats FunctionalEngine::jitStats() const {
+    return jit ? jit->stats() : Jit::Stats {};
+}
+
+FunctionalEngine::Status FunctionalEngine::step() {
+    run(1);
+    return current;
+}
+
+uint64_t FunctionalEngine::run(uint64_t maxInstructions) {
+    if (!jit) {
+        const uint64_t count = interpret(maxInstructions, false);
+        executed += count;
+        return count;
+    }
+
+    uint64_t count = 0;
+    while (current == Status::Running && count < maxInstructions) {
+        Jit::Code code = jit->lookup(regs.pc);
+        if (code == nullptr && jit->isHot(regs.pc)) {
+            code = jit->translate(regs.pc, memory);
+        }
+        if (code != nullptr) {
+            const uint64_t translated = runTranslated(code, maxInstructions - count);
+            count += translated;
+            if (translated > 0) {
+                continue;
+            }
+            // The block doesn't fit into the budget, finish it in the interpreter
+        }
+        count += interpret(maxInstructions - count, true);
+    }
+    executed += count;
+    return count;
+}
+
+uint64_t FunctionalEngine::runTranslated(Jit::Code code, uint64_t maxInstructions) {
+    Jit::Context context {};
+    for (size_t i = 0; i < regs.registers.size(); ++i) {
+        context.registers[i] = regs.registers[i];
+    }
+    context.flags = regs.flags;
+    context.sp = regs.sp;
+    context.limit = maxInstructions;
+    context.memory = memory.data();
+    context.flagTable = alu::FLAG_TABLE.data();
+
+    jit->enter(code, context);
+
+    for (size_t i = 0; i < regs.registers.size(); ++i) {
+        if (i != REG_M) {
+            regs.registers[i] = static_cast<uint8_t>(context.registers[i]);
+        }
+    }
+    regs.flags = static_cast<uint8_t>(context.flags);
+    regs.sp = static_cast<uint16_t>(context.sp);
+    regs.pc = static_cast<uint16_t>(context.pc);
+    cycles += context.cycles;
+
+    if (context.exitReason == Jit::CodeWrite) {
+        SIM_TRACE(logger(), "JIT: code at [{}] has been overwritten", context.writeAddress);
+        jit->flush();
+    }
+    return context.executed;
+}
+
+uint64_t FunctionalEngine::interpret(uint64_t maxInstructions, bool blockEnd) {
+    const uint16_t page = regs.pc >> Jit::PAGE_SHIFT;
+    uint64_t count = 0;
+    while (current == Status::Running && count < maxInstructions) {
+        // fetch & decode & execute
+        const uint8_t instruction = memory[regs.pc];
+        const uint8_t opgroup = (instruction >> 6) & 0b00000011;
+        const uint8_t opcode = (instruction >> 3) & 0b00000111;
+        const uint8_t source = instruction & 0b00000111;
+        const uint8_t rp = (instruction >> 4) & 0b00000011;
+        const uint8_t rp_opcode = instruction & 0b00001111;
+
+        switch (opgroup) {
+        case OP_GROUP_DATA_TRANSFER:
+            if (instruction == OP_INST_NOP) {           // NOP
+                ++regs.pc;
+                cycles += 4;
+            } else if (source == 0b00000110) {          // MVI ddd,data
+                setRegisterValue(opcode, memory[static_cast<uint16_t>(regs.pc + 1)]);
+                regs.pc += 2;
+                cycles += opcode == REG_M ? 10 : 7;
+            } else if (rp_opcode == 0b00000001) {       // LXI rp,data
+                const uint8_t low = memory[static_cast<uint16_t>(regs.pc + 1)];
+                const uint8_t high = memory[static_cast<uint16_t>(regs.pc + 2)];
+                switch (rp) {
+                    case OP_RP_BC:
+                        regs.registers[REG_B] = high;
+                        regs.registers[REG_C] = low;
+                    break;
+                    case OP_RP_DE:
+                        regs.registers[REG_D] = high;
+                        regs.registers[REG_E] = low;
+                    break;
+                    case OP_RP_HL:
+                        regs.registers[REG_H] = high;
+                        regs.registers[REG_L] = low;
+                    break;
+                    case OP_RP_SP:
+                        regs.sp = static_cast<uint16_t>((high << 8) | low);
+                    break;
+                }
+                regs.pc += 3;
+                cycles += 10;
+            } else {
+                trap(instruction);
+            }
+            break;
+
+        case OP_GROUP_MOV:
+            if (instruction == OP_INST_HLT) {           // HLT
+                current = Status::Halted;
+                cycles += 7;
+            } else {
+                trap(instruction);
+            }
+            break;
+
+        case OP_GROUP_ALU:
+            executeAlu(opcode, getRegisterValue(source));
+            ++regs.pc;
+            cycles += source == REG_M ? 7 : 4;
+            break;
+
+        case OP_GROUP_SPECIAL:
+            if (source == REG_M) {                      // ALU Immediate
+                executeAlu(opcode, memory[static_cast<uint16_t>(regs.pc + 1)]);
+                regs.pc += 2;
+                cycles += 7;
+            } else {
+                trap(instruction);
+            }
+            break;
+        }
+
+        if (current != Status::Trapped) {
+            ++count;
+        }
+        if (blockEnd && (regs.pc >> Jit::PAGE_SHIFT) != page) {
+            break;
+        }
+    }
+    return count;
+}
+
+uint8_t FunctionalEngine::getRegisterValue(uint8_t regCode) const {
+    if (regCode == REG_M) {
+        return memory[static_cast<uint16_t>((regs.registers[REG_H] << 8) | regs.registers[REG_L])];
+    }
+    return regs.registers[regCode];
+}
+
+void FunctionalEngine::setRegisterValue(uint8_t regCode, uint8_t value) {
+    if (regCode == REG_M) {
+        const uint16_t address = static_cast<uint16_t>((regs.registers[REG_H] << 8) | regs.registers[REG_L]);
+        memory[address] = value;
+        if (jit && jit->isCodePage(address)) {
+            jit->flush();   // Self-modifying code
+        }
+    } else {
+        regs.registers[regCode] = value;
+    }
+}
+
+void FunctionalEngine::executeAlu(uint8_t opcode, uint8_t operand) {
+    const alu::Output out = alu::Execute(opcode, regs.registers[REG_A], operand, regs.flags);
+    regs.flags = out.flags;
+    // CMP leaves a zero result on the ALU output, which the ControlUnit writes back to A
+    regs.registers[REG_A] = out.result;
+}
+
+void FunctionalEngine::trap(uint8_t instruction) {
+    current = Status::Trapped;
+    SIM_ERROR(logger(), "Unknown opcode {} at pc [{}]", utils::to_binary(instruction), regs.pc);
+}
+
+} // namespace sim
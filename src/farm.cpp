@@ -0,0 +1,468 @@
+//
+//  farm.cpp
+//
+
+#include "farm.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIM_FARM_POSIX 1
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace sim {
+
+#ifdef SIM_FARM_POSIX
+
+namespace {
+    const LogHandle& logger() { return Log::main; }
+
+    // Sent back by a worker for every job, small enough to be written to a pipe atomically
+    struct WireResult {
+        uint64_t index;
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t memoryDigest;
+        uint16_t pc;
+        uint16_t sp;
+        uint8_t status;
+        uint8_t flags;
+        uint8_t failed;                     // The worker threw, `message` holds what()
+        std::array<uint8_t, 8> registers;
+        char message[128];
+    };
+    static_assert(sizeof(WireResult) <= PIPE_BUF, "Results must be written to a pipe atomically");
+
+    std::string ErrnoMessage(const char* function, const char* what) {
+        return std::string(function) + ": " + what + " (" + std::strerror(errno) + ")";
+    }
+
+    // False on end of file or error
+    bool ReadAll(int fd, void* data, size_t size) {
+        auto bytes = static_cast<uint8_t*>(data);
+        while (size > 0) {
+            const ssize_t count = ::read(fd, bytes, size);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            bytes += count;
+            size -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    bool WriteAll(int fd, const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            const ssize_t count = ::write(fd, bytes, size);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            bytes += count;
+            size -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    void CloseFd(int& fd) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    [[noreturn]] void RunWorker(int jobs, int results, const ImageStore& images, const ProcessFarm::Worker& worker) {
+        uint64_t index = 0;
+        while (ReadAll(jobs, &index, sizeof(index))) {
+            WireResult wire {};
+            wire.index = index;
+            try {
+                const BatchRunner::Result result = worker(index, images.image(index));
+                wire.instructions = result.instructions;
+                wire.cycles = result.cycles;
+                wire.memoryDigest = result.memoryDigest;
+                wire.pc = result.state.pc;
+                wire.sp = result.state.sp;
+                wire.status = static_cast<uint8_t>(result.status);
+                wire.flags = result.state.flags;
+                wire.registers = result.state.registers;
+            } catch (const std::exception& e) {
+                wire.failed = 1;
+                std::strncpy(wire.message, e.what(), sizeof(wire.message) - 1);
+            }
+            if (!WriteAll(results, &wire, sizeof(wire))) {
+                break;
+            }
+        }
+        // Skip the destructors and atexit handlers of the parent, e.g. of the SystemC kernel
+        ::_exit(0);
+    }
+
+    BatchRunner::Result FromWire(const WireResult& wire, const std::string& program) {
+        BatchRunner::Result result;
+        result.index = wire.index;
+        result.program = program;
+        if (wire.failed) {
+            result.error = std::string(wire.message, strnlen(wire.message, sizeof(wire.message)));
+            return result;
+        }
+        result.status = static_cast<FunctionalEngine::Status>(wire.status);
+        result.state.registers = wire.registers;
+        result.state.pc = wire.pc;
+        result.state.sp = wire.sp;
+        result.state.flags = wire.flags;
+        result.instructions = wire.instructions;
+        result.cycles = wire.cycles;
+        result.memoryDigest = wire.memoryDigest;
+        return result;
+    }
+}
+
+// MARK: - Image store
+
+ImageStore::ImageStore()
+    : fd(-1), length(0), mapping(nullptr) {
+#ifdef __linux__
+    fd = ::memfd_create("sim-images", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    char path[] = "/tmp/sim-images-XXXXXX";
+    fd = ::mkstemp(path);
+    if (fd >= 0) {
+        ::unlink(path);
+    }
+#endif
+    if (fd < 0) {
+        throw std::runtime_error(ErrnoMessage("ImageStore()", "can't create the image file"));
+    }
+}
+
+ImageStore::~ImageStore() {
+    if (mapping != nullptr) {
+        ::munmap(const_cast<uint8_t*>(mapping), length);
+    }
+    CloseFd(fd);
+}
+
+void ImageStore::add(const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& image) {
+    if (mapping != nullptr) {
+        throw std::runtime_error("ImageStore::add(): the store is sealed");
+    }
+    const auto last = std::find_if(image.rbegin(), image.rend(), [](uint8_t byte) { return byte != 0; });
+    const size_t size = static_cast<size_t>(image.rend() - last);
+    if (!WriteAll(fd, image.data(), size)) {
+        throw std::runtime_error(ErrnoMessage("ImageStore::add()", "can't append an image"));
+    }
+    entries.push_back({length, size});
+    length += size;
+}
+
+void ImageStore::seal() {
+    if (mapping != nullptr || length == 0) {
+        return;
+    }
+#ifdef __linux__
+    if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        throw std::runtime_error(ErrnoMessage("ImageStore::seal()", "can't seal the images"));
+    }
+#endif
+    void* data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(ErrnoMessage("ImageStore::seal()", "can't map the images"));
+    }
+    mapping = static_cast<const uint8_t*>(data);
+}
+
+std::array<uint8_t, DEFAULT_MEMORY_SIZE> ImageStore::image(size_t index) const {
+    const Entry& entry = entries.at(index);
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> data {};
+    if (entry.size != 0) {
+        if (mapping == nullptr) {
+            throw std::runtime_error("ImageStore::image(): the store isn't sealed");
+        }
+        std::memcpy(data.data(), mapping + entry.offset, entry.size);
+    }
+    return data;
+}
+
+// MARK: - Process farm
+
+ProcessFarm::ProcessFarm(unsigned workers)
+    : workers(workers != 0 ? workers : std::max(1u, std::thread::hardware_concurrency())), jobTimeout(0) {
+}
+
+bool ProcessFarm::isSupported() {
+    return true;
+}
+
+ProcessFarm::Stats ProcessFarm::run(const ImageStore& images, const std::vector<std::string>& programs, const Worker& worker,
+                                    const BatchRunner::Sink& sink) {
+    if (programs.size() != images.size()) {
+        throw std::runtime_error("ProcessFarm::run(): " + std::to_string(programs.size()) + " names for "
+            + std::to_string(images.size()) + " images");
+    }
+
+    struct Slot {
+        pid_t pid {-1};
+        int jobs {-1};          // Parent writes job indexes
+        int results {-1};       // Parent reads WireResults
+        bool busy {false};
+        uint64_t job {0};
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // A worker dying with a job pipe open must not kill the parent
+    struct sigaction ignore {};
+    struct sigaction previous {};
+    ignore.sa_handler = SIG_IGN;
+    ::sigaction(SIGPIPE, &ignore, &previous);
+
+    const auto start = std::chrono::steady_clock::now();
+    const size_t count = std::min<size_t>(workers, std::max<size_t>(images.size(), 1));
+    std::vector<Slot> slots(count);
+    const auto spawn = [&](Slot& slot) {
+        int jobPipe[2];
+        int resultPipe[2];
+        if (::pipe(jobPipe) != 0 || ::pipe(resultPipe) != 0) {
+            throw std::runtime_error(ErrnoMessage("ProcessFarm::run()", "can't create a pipe"));
+        }
+        std::fflush(nullptr);   // Buffered output would be written again by the worker
+        const pid_t pid = ::fork();
+        if (pid < 0) {
+            throw std::runtime_error(ErrnoMessage("ProcessFarm::run()", "can't fork a worker"));
+        }
+        if (pid == 0) {
+            for (auto& other : slots) {
+                CloseFd(other.jobs);
+                CloseFd(other.results);
+            }
+            ::close(jobPipe[1]);
+            ::close(resultPipe[0]);
+            ::sigaction(SIGPIPE, &previous, nullptr);
+            if (workerInit) {
+                try {
+                    workerInit(static_cast<unsigned>(&slot - slots.data()));
+                } catch (...) {
+                    ::_exit(1);
+                }
+            }
+            RunWorker(jobPipe[0], resultPipe[1], images, worker);
+        }
+        ::close(jobPipe[0]);
+        ::close(resultPipe[1]);
+        slot.pid = pid;
+        slot.jobs = jobPipe[1];
+        slot.results = resultPipe[0];
+    };
+    for (auto& slot : slots) {
+        spawn(slot);
+    }
+
+    Stats stats;
+    size_t next = 0;
+    std::exception_ptr failure;
+    const auto report = [&](const BatchRunner::Result& result) {
+        ++stats.programs;
+        if (failure) {
+            return;
+        }
+        try {
+            sink(result);
+        } catch (...) {
+            failure = std::current_exception();
+            next = images.size();   // Hand out no more jobs
+        }
+    };
+    // Hands the next job to an idle worker or tells it to exit by closing its job pipe
+    const auto dispatch = [&](Slot& slot) {
+        if (next < images.size()) {
+            const uint64_t index = next;
+            if (WriteAll(slot.jobs, &index, sizeof(index))) {
+                ++next;
+                slot.busy = true;
+                slot.job = index;
+                slot.started = std::chrono::steady_clock::now();
+                return;
+            }
+        }
+        CloseFd(slot.jobs);
+    };
+
+    for (auto& slot : slots) {
+        dispatch(slot);
+    }
+
+    // Milliseconds until the oldest job runs out of time, -1 without a timeout
+    const auto pollTimeout = [&]() {
+        int timeout = -1;
+        if (jobTimeout.count() == 0) {
+            return timeout;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& slot : slots) {
+            if (slot.busy) {
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(slot.started + jobTimeout - now);
+                const int milliseconds = static_cast<int>(std::clamp<int64_t>(left.count(), 0, INT_MAX));
+                timeout = timeout < 0 ? milliseconds : std::min(timeout, milliseconds);
+            }
+        }
+        return timeout;
+    };
+    // Kills the workers past the timeout and forks new ones while there are jobs left
+    const auto expire = [&]() {
+        if (jobTimeout.count() == 0) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& slot : slots) {
+            if (!slot.busy || now - slot.started < jobTimeout) {
+                continue;
+            }
+            ::kill(slot.pid, SIGKILL);
+            int status = 0;
+            while (::waitpid(slot.pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            slot.pid = -1;
+            CloseFd(slot.results);
+            CloseFd(slot.jobs);
+            slot.busy = false;
+            ++stats.timedOut;
+
+            BatchRunner::Result result;
+            result.index = slot.job;
+            result.program = programs[slot.job];
+            result.status = FunctionalEngine::Status::Running;
+            result.error = "timed out after " + std::to_string(jobTimeout.count()) + " ms";
+            report(result);
+            if (next < images.size()) {
+                spawn(slot);
+                dispatch(slot);
+            }
+        }
+    };
+
+    std::vector<pollfd> fds;
+    std::vector<Slot*> polled;
+    while (true) {
+        fds.clear();
+        polled.clear();
+        for (auto& slot : slots) {
+            if (slot.results >= 0) {
+                fds.push_back({slot.results, POLLIN, 0});
+                polled.push_back(&slot);
+            }
+        }
+        if (fds.empty()) {
+            break;
+        }
+        if (::poll(fds.data(), fds.size(), pollTimeout()) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(ErrnoMessage("ProcessFarm::run()", "poll failed"));
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            Slot& slot = *polled[i];
+            WireResult wire {};
+            if (ReadAll(slot.results, &wire, sizeof(wire))) {
+                slot.busy = false;
+                report(FromWire(wire, programs.at(wire.index)));
+                dispatch(slot);
+                continue;
+            }
+            // The worker is gone
+            CloseFd(slot.results);
+            CloseFd(slot.jobs);
+            if (slot.busy) {
+                ++stats.failedWorkers;
+                BatchRunner::Result result;
+                result.index = slot.job;
+                result.program = programs[slot.job];
+                result.error = "worker process exited";
+                report(result);
+                slot.busy = false;
+            }
+        }
+        expire();
+    }
+
+    // Every worker died before the manifest was done
+    for (; next < images.size(); ++next) {
+        BatchRunner::Result result;
+        result.index = next;
+        result.program = programs[next];
+        result.error = "no worker process left";
+        report(result);
+    }
+
+    for (auto& slot : slots) {
+        int status = 0;
+        while (slot.pid > 0 && ::waitpid(slot.pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    ::sigaction(SIGPIPE, &previous, nullptr);
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.seconds = elapsed.count();
+    SIM_INFO(logger(), "Farm: {} programs on {} worker processes in {:.3f} s, {} workers failed, {} jobs timed out",
+        stats.programs, slots.size(), stats.seconds, stats.failedWorkers, stats.timedOut);
+    return stats;
+}
+
+#else
+
+ImageStore::ImageStore() : fd(-1), length(0), mapping(nullptr) {
+    throw std::runtime_error("ImageStore(): shared program images need a POSIX host");
+}
+
+ImageStore::~ImageStore() = default;
+
+void ImageStore::add(const std::array<uint8_t, DEFAULT_MEMORY_SIZE>&) {}
+
+void ImageStore::seal() {}
+
+std::array<uint8_t, DEFAULT_MEMORY_SIZE> ImageStore::image(size_t) const {
+    return {};
+}
+
+ProcessFarm::ProcessFarm(unsigned workers) : workers(workers), jobTimeout(0) {
+}
+
+bool ProcessFarm::isSupported() {
+    return false;
+}
+
+ProcessFarm::Stats ProcessFarm::run(const ImageStore&, const std::vector<std::string>&, const Worker&, const BatchRunner::Sink&) {
+    throw std::runtime_error("ProcessFarm::run(): forking worker processes needs a POSIX host");
+}
+
+#endif
+
+} // namespace sim
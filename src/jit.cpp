@@ -0,0 +1,642 @@
+//
+//  jit.cpp
+//
+
+#include "jit.hpp"
+#include "alutable.hpp"
+#include "log.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define SIM_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#endif
+
+namespace {
+    const sim::LogHandle& logger() { return sim::Log::engine; }
+
+    constexpr size_t BUFFER_SIZE = 16 * 1024 * 1024;
+    constexpr size_t MAX_BLOCK_CODE = 64 * 1024;    // Worst case of a 256 byte page is far below this
+
+    // Mirrors FunctionalEngine::REG_* and the instruction layout of ControlUnit
+    constexpr uint8_t REG_H = 0b00000100;
+    constexpr uint8_t REG_L = 0b00000101;
+    constexpr uint8_t REG_M = 0b00000110;
+    constexpr uint8_t REG_A = 0b00000111;
+
+    constexpr uint8_t OP_GROUP_DATA_TRANSFER = 0b00000000;
+    constexpr uint8_t OP_GROUP_ALU = 0b00000010;
+    constexpr uint8_t OP_GROUP_SPECIAL = 0b00000011;
+
+    constexpr uint8_t OP_RP_BC = 0b00000000;
+    constexpr uint8_t OP_RP_DE = 0b00000001;
+    constexpr uint8_t OP_RP_HL = 0b00000010;
+
+    constexpr uint8_t OP_INST_NOP = 0b00000000;
+}
+
+namespace sim {
+
+namespace {
+    // x86-64 register numbers
+    enum Reg : uint8_t {
+        RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+        R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+    };
+
+    // Host register of every 8080 register code (B, C, D, E, H, L, -, A), flags are in r15d.
+    // rbx holds the guest memory, rbp the flag table, rdi the instruction counter,
+    // [rsp] the limit of the counter and [rsp + 8] the T-state counter; rax, rcx, rdx
+    // and rsi are scratch.
+    constexpr std::array<Reg, 8> HOST_REGISTERS = {R8, R9, R10, R11, R12, R13, RAX, R14};
+    constexpr Reg FLAGS = R15;
+    constexpr Reg MEMORY = RBX;
+    constexpr Reg FLAG_TABLE = RBP;
+    constexpr Reg COUNTER = RDI;
+
+    constexpr int32_t LIMIT_SLOT = 0;       // [rsp]
+    constexpr int32_t CYCLES_SLOT = 8;      // [rsp + 8]
+    constexpr int32_t CONTEXT_SLOT = 16;    // [rsp + 16]
+
+    // ModR/M reg field extensions
+    constexpr uint8_t EXT_ADD = 0;
+    constexpr uint8_t EXT_AND = 4;
+    constexpr uint8_t EXT_SHL = 4;
+    constexpr uint8_t EXT_SHR = 5;
+    constexpr uint8_t EXT_CMP = 7;
+
+    // Opcodes of the `op r/m32, r32` forms
+    constexpr uint8_t OP_ADD = 0x01;
+    constexpr uint8_t OP_OR = 0x09;
+    constexpr uint8_t OP_AND = 0x21;
+    constexpr uint8_t OP_SUB = 0x29;
+    constexpr uint8_t OP_XOR = 0x31;
+    constexpr uint8_t OP_MOV = 0x89;
+
+    constexpr uint8_t CC_E = 0x04;
+    constexpr uint8_t CC_BE = 0x06;
+}
+
+// Emits the handful of x86-64 instructions the translator needs
+class Jit::Assembler final {
+
+public:
+    Assembler(uint8_t* buffer, size_t& used)
+        : buffer(buffer), used(used) {
+    }
+
+    const uint8_t* address() const { return buffer + used; }
+
+    void byte(uint8_t value) { buffer[used++] = value; }
+    void dword(uint32_t value) { std::memcpy(buffer + used, &value, sizeof(value)); used += sizeof(value); }
+    void qword(uint64_t value) { std::memcpy(buffer + used, &value, sizeof(value)); used += sizeof(value); }
+
+    // mov r32, imm32
+    void movImm(Reg dst, uint32_t value) {
+        rex(false, 0, 0, dst);
+        byte(0xB8 + (dst & 7));
+        dword(value);
+    }
+
+    // mov r64, imm64
+    void movImm64(Reg dst, uint64_t value) {
+        rex(true, 0, 0, dst);
+        byte(0xB8 + (dst & 7));
+        qword(value);
+    }
+
+    // op r32, r32 (dst = dst op src)
+    void op(uint8_t opcode, Reg dst, Reg src) {
+        rex(false, src, 0, dst);
+        byte(opcode);
+        modrm(src, dst);
+    }
+
+    // op r32, imm32
+    void opImm(uint8_t ext, Reg dst, uint32_t value) {
+        rex(false, 0, 0, dst);
+        byte(0x81);
+        modrm(ext, dst);
+        dword(value);
+    }
+
+    // op r64, imm32
+    void opImm64(uint8_t ext, Reg dst, uint32_t value) {
+        rex(true, 0, 0, dst);
+        byte(0x81);
+        modrm(ext, dst);
+        dword(value);
+    }
+
+    // shl/shr r32, imm8
+    void shift(uint8_t ext, Reg dst, uint8_t count) {
+        rex(false, 0, 0, dst);
+        byte(0xC1);
+        modrm(ext, dst);
+        byte(count);
+    }
+
+    // movzx r32, r8 (low byte of rax-rbx)
+    void movzx8(Reg dst, Reg src) {
+        rex(false, dst, 0, src);
+        byte(0x0F);
+        byte(0xB6);
+        modrm(dst, src);
+    }
+
+    // movzx r32, byte [base + index]
+    void loadByte(Reg dst, Reg base, Reg index) {
+        rex(false, dst, index, base);
+        byte(0x0F);
+        byte(0xB6);
+        sib(dst, base, index);
+    }
+
+    // mov byte [base + index], imm8
+    void storeByte(Reg base, Reg index, uint8_t value) {
+        rex(false, 0, index, base);
+        byte(0xC6);
+        sib(0, base, index);
+        byte(value);
+    }
+
+    // cmp byte [base + index], imm8
+    void compareByte(Reg base, Reg index, uint8_t value) {
+        rex(false, 0, index, base);
+        byte(0x80);
+        sib(EXT_CMP, base, index);
+        byte(value);
+    }
+
+    // mov r32/r64, [base + disp32]
+    void load(Reg dst, Reg base, int32_t disp, bool wide = false) {
+        rex(wide, dst, 0, base);
+        byte(0x8B);
+        displacement(dst, base, disp);
+    }
+
+    // mov [base + disp32], r32/r64
+    void store(Reg base, int32_t disp, Reg src, bool wide = false) {
+        rex(wide, src, 0, base);
+        byte(0x89);
+        displacement(src, base, disp);
+    }
+
+    // mov dword [base + disp32], imm32
+    void storeImm(Reg base, int32_t disp, uint32_t value) {
+        rex(false, 0, 0, base);
+        byte(0xC7);
+        displacement(0, base, disp);
+        dword(value);
+    }
+
+    // op qword [base + disp32], imm32
+    void opMemory(uint8_t ext, Reg base, int32_t disp, uint32_t value) {
+        rex(true, 0, 0, base);
+        byte(0x81);
+        displacement(ext, base, disp);
+        dword(value);
+    }
+
+    // lea r64, [base + disp32]
+    void lea(Reg dst, Reg base, int32_t disp) {
+        rex(true, dst, 0, base);
+        byte(0x8D);
+        displacement(dst, base, disp);
+    }
+
+    // cmp r64, [base + disp32]
+    void compare(Reg reg, Reg base, int32_t disp) {
+        rex(true, reg, 0, base);
+        byte(0x3B);
+        displacement(reg, base, disp);
+    }
+
+    void push(Reg reg) {
+        rex(false, 0, 0, reg);
+        byte(0x50 + (reg & 7));
+    }
+
+    void pop(Reg reg) {
+        rex(false, 0, 0, reg);
+        byte(0x58 + (reg & 7));
+    }
+
+    void ret() { byte(0xC3); }
+
+    // jmp r64
+    void jump(Reg target) {
+        rex(false, 0, 0, target);
+        byte(0xFF);
+        modrm(4, target);
+    }
+
+    // jmp rel32, returns the offset of rel32 for patching
+    size_t jump(const uint8_t* target) {
+        byte(0xE9);
+        const size_t offset = used;
+        dword(0);
+        patch(buffer, offset, target);
+        return offset;
+    }
+
+    // jcc rel8 to a label bound later
+    size_t jumpIf(uint8_t condition) {
+        byte(0x70 | condition);
+        byte(0);
+        return used - 1;
+    }
+
+    void bind(size_t label) {
+        buffer[label] = static_cast<uint8_t>(used - label - 1);
+    }
+
+    static void patch(uint8_t* buffer, size_t offset, const uint8_t* target) {
+        const int32_t rel = static_cast<int32_t>(target - (buffer + offset + 4));
+        std::memcpy(buffer + offset, &rel, sizeof(rel));
+    }
+
+private:
+    void rex(bool wide, uint8_t reg, uint8_t index, uint8_t base) {
+        // Byte registers 4-7 without REX would be ah-bh, they aren't used as byte operands here
+        const uint8_t value = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+        if (value != 0x40) {
+            byte(value);
+        }
+    }
+
+    void modrm(uint8_t reg, uint8_t rm) {
+        byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    // [base + index + 0], disp8 form works for every base register
+    void sib(uint8_t reg, uint8_t base, uint8_t index) {
+        byte(0x44 | ((reg & 7) << 3));
+        byte(((index & 7) << 3) | (base & 7));
+        byte(0);
+    }
+
+    // [base + disp32]
+    void displacement(uint8_t reg, uint8_t base, int32_t disp) {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP) {
+            byte(0x24);
+        }
+        dword(static_cast<uint32_t>(disp));
+    }
+
+    uint8_t* buffer;
+    size_t& used;
+};
+
+Jit::Jit()
+    : buffer(nullptr), capacity(0), used(0), codeStart(0), epilogue(nullptr), blocks {}, heat {}, codePages {}, statistics {} {
+#ifdef SIM_JIT_SUPPORTED
+    // Writable while code is emitted and executable while it runs, never both (W^X)
+    void* memory = mmap(nullptr, BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        SIM_ERROR(logger(), "JIT: can't allocate executable memory");
+        return;
+    }
+    buffer = static_cast<uint8_t*>(memory);
+    capacity = BUFFER_SIZE;
+    emitPrologueAndEpilogue();
+    protect(false);
+#endif
+}
+
+Jit::~Jit() {
+#ifdef SIM_JIT_SUPPORTED
+    if (buffer != nullptr) {
+        munmap(buffer, capacity);
+    }
+#endif
+}
+
+bool Jit::isSupported() {
+#ifdef SIM_JIT_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Jit::protect(bool writable) {
+#ifdef SIM_JIT_SUPPORTED
+    if (mprotect(buffer, capacity, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) {
+        // Without a usable buffer nothing gets translated and the engine keeps interpreting
+        SIM_ERROR(logger(), "JIT: can't make the code buffer {}", writable ? "writable" : "executable");
+        munmap(buffer, capacity);
+        buffer = nullptr;
+        capacity = 0;
+        blocks.fill(nullptr);
+        return false;
+    }
+#else
+    (void)writable;
+#endif
+    return true;
+}
+
+void Jit::emitPrologueAndEpilogue() {
+    Assembler a(buffer, used);
+
+    // void entry(Context* context /* rdi */, Code code /* rsi */)
+    a.push(RBX);
+    a.push(RBP);
+    a.push(R12);
+    a.push(R13);
+    a.push(R14);
+    a.push(R15);
+    a.push(RDI);                                                    // [rsp + CONTEXT_SLOT]
+    a.load(RAX, RDI, offsetof(Context, cycles), true);
+    a.push(RAX);                                                    // [rsp + CYCLES_SLOT]
+    for (uint8_t code = 0; code < HOST_REGISTERS.size(); ++code) {
+        if (code != REG_M) {
+            a.load(HOST_REGISTERS[code], RDI, offsetof(Context, registers) + code * sizeof(uint32_t));
+        }
+    }
+    a.load(FLAGS, RDI, offsetof(Context, flags));
+    a.load(MEMORY, RDI, offsetof(Context, memory), true);
+    a.load(FLAG_TABLE, RDI, offsetof(Context, flagTable), true);
+    a.load(RAX, RDI, offsetof(Context, limit), true);
+    a.push(RAX);                                                    // [rsp + LIMIT_SLOT]
+    a.load(COUNTER, RDI, offsetof(Context, executed), true);
+    a.jump(RSI);
+
+    // eax = next pc, edx = exit reason, ecx = written address
+    epilogue = a.address();
+    a.load(RSI, RSP, CONTEXT_SLOT, true);
+    for (uint8_t code = 0; code < HOST_REGISTERS.size(); ++code) {
+        if (code != REG_M) {
+            a.store(RSI, offsetof(Context, registers) + code * sizeof(uint32_t), HOST_REGISTERS[code]);
+        }
+    }
+    a.store(RSI, offsetof(Context, flags), FLAGS);
+    a.store(RSI, offsetof(Context, pc), RAX);
+    a.store(RSI, offsetof(Context, exitReason), RDX);
+    a.store(RSI, offsetof(Context, writeAddress), RCX);
+    a.store(RSI, offsetof(Context, executed), COUNTER, true);
+    a.pop(RAX);
+    a.pop(RAX);
+    a.store(RSI, offsetof(Context, cycles), RAX, true);
+    a.pop(RAX);
+    a.pop(R15);
+    a.pop(R14);
+    a.pop(R13);
+    a.pop(R12);
+    a.pop(RBP);
+    a.pop(RBX);
+    a.ret();
+
+    codeStart = used;
+}
+
+Jit::Code Jit::translate(uint16_t address, const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& memory) {
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+    if (capacity - used < MAX_BLOCK_CODE) {
+        flush();
+    }
+    if (!protect(true)) {
+        return nullptr;
+    }
+
+    Assembler a(buffer, used);
+    const size_t start = used;
+
+    // Leave without executing anything if the whole block doesn't fit into the budget
+    a.lea(RAX, COUNTER, 0);
+    const size_t countOffset = used - 4;
+    a.compare(RAX, RSP, LIMIT_SLOT);
+    const size_t enter = a.jumpIf(CC_BE);
+    a.movImm(RAX, address);
+    a.op(OP_XOR, RDX, RDX);
+    a.jump(epilogue);
+    a.bind(enter);
+
+    // Address (HL) in ecx
+    const auto addressHL = [&a]() {
+        a.op(OP_MOV, RCX, HOST_REGISTERS[REG_H]);
+        a.shift(EXT_SHL, RCX, 8);
+        a.op(OP_OR, RCX, HOST_REGISTERS[REG_L]);
+    };
+
+    uint16_t pc = address;
+    uint32_t count = 0;
+    uint32_t cycles = 0;    // T-states of the translated instructions, as the interpreter counts them
+    while (true) {
+        const uint8_t instruction = memory[pc];
+        const uint8_t opgroup = (instruction >> 6) & 0b00000011;
+        const uint8_t opcode = (instruction >> 3) & 0b00000111;
+        const uint8_t source = instruction & 0b00000111;
+        const uint8_t rp = (instruction >> 4) & 0b00000011;
+        const uint8_t rp_opcode = instruction & 0b00001111;
+        const uint8_t data1 = memory[static_cast<uint16_t>(pc + 1)];
+        const uint8_t data2 = memory[static_cast<uint16_t>(pc + 2)];
+
+        uint8_t length = 0;
+        uint8_t tstates = 0;
+        bool alu = false;
+        if (instruction == OP_INST_NOP) {                                       // NOP
+            length = 1;
+            tstates = 4;
+        } else if (opgroup == OP_GROUP_DATA_TRANSFER && source == 0b00000110) { // MVI ddd,data
+            length = 2;
+            tstates = opcode == REG_M ? 10 : 7;
+            if (opcode == REG_M) {
+                addressHL();
+                a.storeByte(MEMORY, RCX, data1);
+                // Leave if the write has hit translated code
+                a.op(OP_MOV, RAX, RCX);
+                a.shift(EXT_SHR, RAX, PAGE_SHIFT);
+                a.movImm64(RDX, reinterpret_cast<uint64_t>(codePages.data()));
+                a.compareByte(RDX, RAX, 0);
+                const size_t skip = a.jumpIf(CC_E);
+                a.opImm64(EXT_ADD, COUNTER, count + 1);
+                a.opMemory(EXT_ADD, RSP, CYCLES_SLOT, cycles + tstates);
+                a.movImm(RAX, static_cast<uint16_t>(pc + length));
+                a.movImm(RDX, CodeWrite);
+                a.jump(epilogue);
+                a.bind(skip);
+            } else {
+                a.movImm(HOST_REGISTERS[opcode], data1);
+            }
+        } else if (opgroup == OP_GROUP_DATA_TRANSFER && rp_opcode == 0b00000001) { // LXI rp,data
+            length = 3;
+            tstates = 10;
+            if (rp == OP_RP_BC || rp == OP_RP_DE || rp == OP_RP_HL) {
+                a.movImm(HOST_REGISTERS[rp * 2], data2);
+                a.movImm(HOST_REGISTERS[rp * 2 + 1], data1);
+            } else {
+                a.load(RAX, RSP, CONTEXT_SLOT, true);
+                a.storeImm(RAX, offsetof(Context, sp), static_cast<uint32_t>((data2 << 8) | data1));
+            }
+        } else if (opgroup == OP_GROUP_ALU) {                                   // ALU sss
+            length = 1;
+            tstates = source == REG_M ? 7 : 4;
+            alu = true;
+            if (source == REG_M) {
+                addressHL();
+                a.loadByte(RDX, MEMORY, RCX);
+            } else {
+                a.op(OP_MOV, RDX, HOST_REGISTERS[source]);
+            }
+        } else if (opgroup == OP_GROUP_SPECIAL && source == REG_M) {            // ALU Immediate
+            length = 2;
+            tstates = 7;
+            alu = true;
+            a.movImm(RDX, data1);
+        } else {
+            break;  // HLT and unknown opcodes are left to the interpreter
+        }
+
+        if (alu) {
+            // Same reduction as alu::Execute: a 9-bit raw value in ecx, flags from FLAG_TABLE
+            const Reg accumulator = HOST_REGISTERS[REG_A];
+            a.op(OP_MOV, RAX, accumulator);
+            switch (opcode) {
+                case alu::OP_ADD:
+                    a.op(OP_MOV, RCX, RAX);
+                    a.op(OP_ADD, RCX, RDX);
+                    a.op(OP_MOV, RSI, RAX);                 // Auxiliary carry: bit 4 of a ^ b ^ sum
+                    a.op(OP_XOR, RSI, RDX);
+                    a.op(OP_XOR, RSI, RCX);
+                    a.opImm(EXT_AND, RSI, alu::FLAG_AUX_CARRY);
+                    break;
+                case alu::OP_ADC:
+                    a.op(OP_MOV, RCX, FLAGS);
+                    a.shift(EXT_SHR, RCX, alu::FLAG_IDX_CARRY);
+                    a.opImm(EXT_AND, RCX, 1);
+                    a.op(OP_ADD, RCX, RAX);
+                    a.op(OP_ADD, RCX, RDX);
+                    break;
+                case alu::OP_SUB:
+                case alu::OP_CMP:
+                    a.op(OP_MOV, RCX, RAX);
+                    a.op(OP_SUB, RCX, RDX);
+                    a.opImm(EXT_AND, RCX, 0x1FF);
+                    break;
+                case alu::OP_SBB:
+                    a.op(OP_MOV, RSI, FLAGS);
+                    a.shift(EXT_SHR, RSI, alu::FLAG_IDX_CARRY);
+                    a.opImm(EXT_AND, RSI, 1);
+                    a.op(OP_MOV, RCX, RAX);
+                    a.op(OP_SUB, RCX, RDX);
+                    a.op(OP_SUB, RCX, RSI);
+                    a.opImm(EXT_AND, RCX, 0x1FF);
+                    break;
+                case alu::OP_ANA:
+                    a.op(OP_MOV, RCX, RAX);
+                    a.op(OP_AND, RCX, RDX);
+                    break;
+                case alu::OP_XRA:
+                    a.op(OP_MOV, RCX, RAX);
+                    a.op(OP_XOR, RCX, RDX);
+                    break;
+                case alu::OP_ORA:
+                    a.op(OP_MOV, RCX, RAX);
+                    a.op(OP_OR, RCX, RDX);
+                    break;
+            }
+
+            a.loadByte(RAX, FLAG_TABLE, RCX);
+            if (opcode == alu::OP_ADD) {
+                a.op(OP_OR, RAX, RSI);
+            }
+            const uint8_t kept = alu::KEPT_FLAG_TABLE[opcode];
+            if (kept != 0) {
+                a.opImm(EXT_AND, RAX, ~kept & alu::FLAG_ALL);
+                a.opImm(EXT_AND, FLAGS, kept);
+                a.op(OP_OR, FLAGS, RAX);
+            } else {
+                a.op(OP_MOV, FLAGS, RAX);
+            }
+
+            if (opcode == alu::OP_CMP) {
+                a.op(OP_XOR, accumulator, accumulator);     // CMP leaves a zero result on the ALU output
+            } else {
+                a.movzx8(accumulator, RCX);
+            }
+        }
+
+        // Every byte of the block is code now
+        for (uint8_t i = 0; i < length; ++i) {
+            codePages[static_cast<uint16_t>(pc + i) >> PAGE_SHIFT] = 1;
+        }
+
+        ++count;
+        cycles += tstates;
+        pc = static_cast<uint16_t>(pc + length);
+        if ((pc >> PAGE_SHIFT) != (address >> PAGE_SHIFT)) {
+            break;
+        }
+    }
+
+    if (count == 0) {
+        used = start;
+        protect(false);
+        return nullptr;
+    }
+
+    const int32_t total = static_cast<int32_t>(count);
+    std::memcpy(buffer + countOffset, &total, sizeof(total));
+    a.opImm64(EXT_ADD, COUNTER, count);
+    a.opMemory(EXT_ADD, RSP, CYCLES_SLOT, cycles);
+
+    // Chain to the next block, or leave through a stub until it gets translated
+    const size_t exit = a.jump(a.address() + 5);   // Falls into the stub below
+    if (blocks[pc] != nullptr) {
+        Assembler::patch(buffer, exit, blocks[pc]);
+    } else {
+        pendingLinks[pc].push_back(exit);
+    }
+    a.movImm(RAX, pc);
+    a.op(OP_XOR, RDX, RDX);
+    a.jump(epilogue);
+
+    const Code code = buffer + start;
+    link(address, code);
+    if (!protect(false)) {
+        return nullptr;
+    }
+    blocks[address] = code;
+    ++statistics.translations;
+    SIM_TRACE(logger(), "JIT: translated {} instructions at [{}]", count, address);
+    return code;
+}
+
+void Jit::link(uint16_t target, Code code) {
+    const auto it = pendingLinks.find(target);
+    if (it == pendingLinks.end()) {
+        return;
+    }
+    for (const size_t offset : it->second) {
+        Assembler::patch(buffer, offset, code);
+    }
+    pendingLinks.erase(it);
+}
+
+void Jit::enter(Code code, Context& context) {
+    // The prologue at the start of the buffer loads the context and jumps to `code`
+    using Entry = void (*)(Context*, Code);
+    ++statistics.entries;
+    reinterpret_cast<Entry>(buffer)(&context, code);
+}
+
+void Jit::flush() {
+    if (buffer == nullptr) {
+        return;
+    }
+    used = codeStart;
+    blocks.fill(nullptr);
+    heat.fill(0);
+    codePages.fill(0);
+    pendingLinks.clear();
+    ++statistics.flushes;
+}
+
+} // namespace sim
@@ -12,8 +12,10 @@
 #endif
 
 #include <iostream>
+#include <vector>
 
 #include "spdlog/pattern_formatter.h"
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/null_sink.h>
 
@@ -25,13 +27,59 @@ std::string LogName::memory = "memory";
 std::string LogName::cu = "cu";
 std::string LogName::mut = "mut";
 std::string LogName::reg = "reg";
+std::string LogName::engine = "engine";
+
+LogHandle Log::main {LogName::main};
+LogHandle Log::alu {LogName::alu};
+LogHandle Log::memory {LogName::memory};
+LogHandle Log::cu {LogName::cu};
+LogHandle Log::mut {LogName::mut};
+LogHandle Log::reg {LogName::reg};
+LogHandle Log::engine {LogName::engine};
+
+void LogHandle::refresh(unsigned rate)
+{
+    // The registry keeps the logger alive, the handle only caches the raw pointer
+    logger.store(spdlog::get(name).get(), std::memory_order_release);
+    sampleRate.store(rate, std::memory_order_relaxed);
+    sampleCounter.store(0, std::memory_order_relaxed);
+    skipped.store(0, std::memory_order_relaxed);
+}
 
 const int flushIntervalSec = 5;
 
-void ConfigureLogging(bool fileLogging, const std::string& filename, spdlog::level::level_enum level)
+namespace {
+
+// Loggers of earlier configurations. Handles on other threads may still point at them, so they live on.
+std::vector<std::shared_ptr<spdlog::logger>> retiredLoggers;
+bool asyncLogging = false;
+
+std::shared_ptr<spdlog::logger> MakeLogger(const std::string& name, const std::vector<spdlog::sink_ptr>& sinks,
+    const AsyncLogOptions* async)
+{
+    if (async == nullptr)
+    {
+        return std::make_shared<spdlog::logger>(name, sinks.begin(), sinks.end());
+    }
+    const auto policy = async->overflow == LogOverflow::Block
+        ? spdlog::async_overflow_policy::block
+        : spdlog::async_overflow_policy::overrun_oldest;
+    return std::make_shared<spdlog::async_logger>(name, sinks.begin(), sinks.end(), spdlog::thread_pool(), policy);
+}
+
+} // namespace
+
+void ConfigureLogging(bool fileLogging, const std::string& filename, spdlog::level::level_enum level,
+    const AsyncLogOptions* async = nullptr, bool periodicFlush = true)
 {
     try
     {
+        if (async != nullptr)
+        {
+            // One writer thread keeps the order of the messages
+            spdlog::init_thread_pool(async->queueSize, 1);
+        }
+
         std::vector<spdlog::sink_ptr> sinks;
         if (fileLogging)
         {
@@ -45,14 +93,25 @@ void ConfigureLogging(bool fileLogging, const std::string& filename, spdlog::lev
         sinks.push_back(std::make_shared<sim::oslogger_sink_mt>());
 #endif
 
-        spdlog::set_default_logger(std::make_shared<spdlog::logger>(LogName::main, sinks.begin(), sinks.end()));
+        for (const std::string* name : {&LogName::main, &LogName::alu, &LogName::memory, &LogName::cu, &LogName::mut,
+                                        &LogName::reg, &LogName::engine})
+        {
+            if (auto previous = spdlog::get(*name))
+            {
+                retiredLoggers.push_back(std::move(previous));
+                spdlog::drop(*name);
+            }
+        }
+
+        spdlog::set_default_logger(MakeLogger(LogName::main, sinks, async));
         spdlog::set_level(level);
         std::vector<std::shared_ptr<spdlog::logger>> subLoggers = {
-            std::make_shared<spdlog::logger>(LogName::alu, sinks.begin(), sinks.end()),
-            std::make_shared<spdlog::logger>(LogName::memory, sinks.begin(), sinks.end()),
-            std::make_shared<spdlog::logger>(LogName::cu, sinks.begin(), sinks.end()),
-            std::make_shared<spdlog::logger>(LogName::mut, sinks.begin(), sinks.end()),
-            std::make_shared<spdlog::logger>(LogName::reg, sinks.begin(), sinks.end()),
+            MakeLogger(LogName::alu, sinks, async),
+            MakeLogger(LogName::memory, sinks, async),
+            MakeLogger(LogName::cu, sinks, async),
+            MakeLogger(LogName::mut, sinks, async),
+            MakeLogger(LogName::reg, sinks, async),
+            MakeLogger(LogName::engine, sinks, async),
         };
 
         for (const auto& logger : subLoggers)
@@ -61,18 +120,37 @@ void ConfigureLogging(bool fileLogging, const std::string& filename, spdlog::lev
             spdlog::register_logger(logger);
         }
 
-        if (fileLogging)
+        if (fileLogging && async != nullptr)
+        {
+            // Batched flushes on the writer thread
+            spdlog::flush_on(spdlog::level::err);
+            spdlog::flush_every(async->flushInterval);
+        }
+        else if (fileLogging && periodicFlush)
         {
             spdlog::flush_on(level);
             spdlog::flush_every(std::chrono::seconds(flushIntervalSec));
         }
+        else if (fileLogging)
+        {
+            // A zero interval also stops the flush thread of an earlier configuration
+            spdlog::flush_on(spdlog::level::trace);
+            spdlog::flush_every(std::chrono::seconds(0));
+        }
 
+        asyncLogging = async != nullptr;
         spdlog::get(LogName::main)->info("Starting new session at {}...\n", utils::GetCurrentDateTime());
     }
     catch (const spdlog::spdlog_ex& ex)
     {
         std::cerr << "Log init failed: " << ex.what() << std::endl;
     }
+
+    const unsigned sampleRate = async != nullptr && async->overflow == LogOverflow::Sample ? async->sampleRate : 1;
+    for (LogHandle* handle : {&Log::main, &Log::alu, &Log::memory, &Log::cu, &Log::mut, &Log::reg, &Log::engine})
+    {
+        handle->refresh(sampleRate);
+    }
 }
 
 void ConfigureFileLogging(const std::string& filename, spdlog::level::level_enum level)
@@ -85,4 +163,40 @@ void ConfigureNullLogging()
     ConfigureLogging(false, "", spdlog::level::trace);
 }
 
+void ConfigureForkSafeFileLogging(const std::string& filename, spdlog::level::level_enum level)
+{
+    ConfigureLogging(true, filename, level, nullptr, false);
+}
+
+void ConfigureAsyncFileLogging(const std::string& filename, spdlog::level::level_enum level,
+    const AsyncLogOptions& options)
+{
+    ConfigureLogging(true, filename, level, &options);
+}
+
+LogStats GetLogStats()
+{
+    LogStats stats;
+    if (const auto pool = spdlog::thread_pool(); asyncLogging && pool)
+    {
+        stats.dropped = pool->overrun_counter();
+    }
+    for (const LogHandle* handle : {&Log::main, &Log::alu, &Log::memory, &Log::cu, &Log::mut, &Log::reg, &Log::engine})
+    {
+        stats.sampled += handle->sampledOut();
+    }
+    return stats;
+}
+
+bool SetLogLevel(const std::string& name, spdlog::level::level_enum level)
+{
+    const auto logger = spdlog::get(name);
+    if (!logger)
+    {
+        return false;
+    }
+    logger->set_level(level);
+    return true;
+}
+
 } // namespace sim
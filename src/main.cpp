@@ -1,18 +1,360 @@
 #include "processor.hpp"
+#include "engine.hpp"
+#include "batch.hpp"
+#include "farm.hpp"
 #include "log.hpp"
+#include "utils.hpp"
 
 #include <systemc>
+#include <CLI/CLI.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
 
 using namespace sim;
 
 namespace {
-    auto logger() { return spdlog::get(LogName::main); }
+    const LogHandle& logger() { return Log::main; }
+
+    const std::string engineSystemC = "systemc";
+    const std::string engineFunctional = "functional";
+
+    const std::map<std::string, LogOverflow> logOverflowPolicies = {
+        {"block", LogOverflow::Block},
+        {"drop", LogOverflow::Drop},
+        {"sample", LogOverflow::Sample},
+    };
+
+    const std::map<std::string, spdlog::level::level_enum> logLevels = {
+        {"trace", spdlog::level::trace},
+        {"debug", spdlog::level::debug},
+        {"info", spdlog::level::info},
+        {"warn", spdlog::level::warn},
+        {"error", spdlog::level::err},
+        {"off", spdlog::level::off},
+    };
+
+    const std::map<std::string, ControlUnit::MemoryAccess> memoryAccessModes = {
+        {"pins", ControlUnit::MemoryAccess::Pins},
+        {"tlm", ControlUnit::MemoryAccess::Transaction},
+    };
+
+    const std::map<std::string, ControlUnit::Sequencer> sequencers = {
+        {"thread", ControlUnit::Sequencer::Thread},
+        {"method", ControlUnit::Sequencer::Method},
+    };
+
+    const std::map<std::string, ControlUnit::RegisterAccess> registerAccessModes = {
+        {"pins", ControlUnit::RegisterAccess::Pins},
+        {"direct", ControlUnit::RegisterAccess::Direct},
+    };
+
+    int runFunctional(const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& program, bool jit) {
+        FunctionalEngine engine;
+        engine.setJitEnabled(jit);
+        engine.load(program);
+
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t instructions = engine.run();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const auto& state = engine.state();
+        logger()->info("{}: Stopping execution at pc [{}]...",
+            engine.status() == FunctionalEngine::Status::Halted ? "HLT" : "TRAP", state.pc);
+        logger()->info("Executed {} instructions in {:.6f} s ({:.2f} MIPS)",
+            instructions, elapsed.count(), instructions / elapsed.count() / 1e6);
+        std::cout << "Executed " << instructions << " instructions in " << elapsed.count() << " s" << std::endl;
+        if (engine.isJitEnabled()) {
+            const auto stats = engine.jitStats();
+            logger()->info("JIT: {} translations, {} flushes, {} entries", stats.translations, stats.flushes, stats.entries);
+        }
+
+        return engine.status() == FunctionalEngine::Status::Halted ? 0 : 1;
+    }
+
+    bool openOutput(std::ofstream& file, const std::string& path) {
+        file.open(path);
+        if (!file) {
+            std::cerr << "Can't open " << path << " for the --batch results" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    int runBatch(const std::string& manifestPath, const std::string& outPath, unsigned workers, uint64_t maxInstructions) {
+        std::ifstream manifest(manifestPath);
+        const auto programs = BatchRunner::ReadManifest(manifest);
+
+        std::ofstream file;
+        if (!outPath.empty() && !openOutput(file, outPath)) {
+            return 1;
+        }
+        std::ostream& out = outPath.empty() ? std::cout : file;
+
+        BatchRunner runner(workers);
+        if (maxInstructions != 0) {
+            runner.setMaxInstructions(maxInstructions);
+        }
+        uint64_t failed = 0;
+        const auto stats = runner.run(programs, [&out, &failed](const BatchRunner::Result& result) {
+            BatchRunner::WriteJson(out, result);
+            if (!result.error.empty() || result.status != FunctionalEngine::Status::Halted) {
+                ++failed;
+            }
+        });
+        out.flush();
+
+        std::cerr << "Ran " << stats.programs << " programs on " << runner.workerCount() << " workers in "
+                  << stats.seconds << " s, " << failed << " didn't halt" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+
+    // Runs one image on the model elaborated by the first job of this worker process
+    BatchRunner::Result runOnModel(Intel8080& processor, size_t index, const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& image,
+                                   uint64_t maxInstructions) {
+        // Slices keep --max-instructions from running far over, the control unit pauses the kernel on HLT
+        const sc_core::sc_time slice(100, sc_core::SC_US);
+
+        processor.reset();
+        processor.loadMemory(image);
+        const uint64_t instructions = processor.cu.instructionCount();
+        const uint64_t cycles = processor.cu.cycleCount();
+        while (!processor.cu.isIdle() && (maxInstructions == 0 || processor.cu.instructionCount() - instructions < maxInstructions)) {
+            sc_core::sc_start(slice);
+        }
+
+        BatchRunner::Result result;
+        result.index = index;
+        result.instructions = processor.cu.instructionCount() - instructions;
+        result.cycles = processor.cu.cycleCount() - cycles;
+        result.memoryDigest = processor.memory.digest();
+
+        auto& state = result.state;
+        state.pc = static_cast<uint16_t>(ToUnsigned(processor.cu.getPC()));
+        state.sp = static_cast<uint16_t>(ToUnsigned(processor.cu.getSP()));
+        state.flags = static_cast<uint8_t>(ToUnsigned(processor.cu.getFlags()));
+        state.registers[FunctionalEngine::REG_A] = processor.registers.read(SELECT_REG_A);
+        state.registers[FunctionalEngine::REG_B] = processor.registers.read(SELECT_REG_B);
+        state.registers[FunctionalEngine::REG_C] = processor.registers.read(SELECT_REG_C);
+        state.registers[FunctionalEngine::REG_D] = processor.registers.read(SELECT_REG_D);
+        state.registers[FunctionalEngine::REG_E] = processor.registers.read(SELECT_REG_E);
+        state.registers[FunctionalEngine::REG_H] = processor.registers.read(SELECT_REG_H);
+        state.registers[FunctionalEngine::REG_L] = processor.registers.read(SELECT_REG_L);
+
+        if (!processor.cu.isIdle()) {
+            result.status = FunctionalEngine::Status::Running;
+        } else if (ToUnsigned(processor.memory.getValueAt(processor.cu.getPC())) == ControlUnit::OP_INST_HLT) {
+            result.status = FunctionalEngine::Status::Halted;   // PC stays at the HLT
+        } else {
+            result.status = FunctionalEngine::Status::Trapped;
+        }
+        return result;
+    }
+
+    int runFarm(const std::string& manifestPath, const std::string& outPath, unsigned workers, uint64_t maxInstructions,
+                double jobTimeout, const ProcessFarm::WorkerInit& init, const std::function<std::unique_ptr<Intel8080>()>& elaborate) {
+        std::ifstream manifest(manifestPath);
+        const auto programs = BatchRunner::ReadManifest(manifest);
+
+        std::ofstream file;
+        if (!outPath.empty() && !openOutput(file, outPath)) {
+            return 1;
+        }
+        std::ostream& out = outPath.empty() ? std::cout : file;
+
+        // Programs that can't be loaded are reported here, the store holds the others
+        uint64_t failed = 0;
+        ImageStore images;
+        std::vector<std::string> loaded;
+        std::vector<size_t> indices;
+        for (size_t index = 0; index < programs.size(); ++index) {
+            try {
+                images.add(utils::LoadProgram(programs[index]));
+                loaded.push_back(programs[index]);
+                indices.push_back(index);
+            } catch (const std::exception& e) {
+                BatchRunner::Result result;
+                result.index = index;
+                result.program = programs[index];
+                result.error = e.what();
+                BatchRunner::WriteJson(out, result);
+                ++failed;
+            }
+        }
+        images.seal();
+
+        ProcessFarm farm(workers);
+        farm.setJobTimeout(std::chrono::milliseconds(static_cast<int64_t>(jobTimeout * 1000)));
+        farm.setWorkerInit(init);
+        const auto stats = farm.run(images, loaded, [&elaborate, maxInstructions](size_t index, const auto& image) {
+            // Each worker process elaborates once, sc_start() can't be called on a second model
+            static std::unique_ptr<Intel8080> processor = elaborate();
+            return runOnModel(*processor, index, image, maxInstructions);
+        }, [&out, &failed, &indices](const BatchRunner::Result& result) {
+            BatchRunner::Result reported = result;
+            reported.index = indices[result.index];
+            BatchRunner::WriteJson(out, reported);
+            if (!result.error.empty() || result.status != FunctionalEngine::Status::Halted) {
+                ++failed;
+            }
+        });
+        out.flush();
+
+        std::cerr << "Ran " << programs.size() << " programs on " << farm.workerCount() << " processes in "
+                  << stats.seconds << " s, " << images.bytes() << " image bytes shared, " << failed << " didn't halt" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
 }
 
-int sc_main(__unused int argc, __unused char* argv[]) {
-    ConfigureFileLogging("simulator.log", spdlog::level::trace);
+int sc_main(int argc, char* argv[]) {
+    CLI::App app {"Intel 8080 Simulator"};
+
+    std::string engine = engineSystemC;
+    app.add_option("-e,--engine", engine, "Execution engine")
+        ->check(CLI::IsMember({engineSystemC, engineFunctional}))
+        ->capture_default_str();
+
+    ControlUnit::MemoryAccess memoryAccess = ControlUnit::MemoryAccess::Pins;
+    app.add_option("-m,--memory-access", memoryAccess, "Memory interface of the SystemC model (pins, tlm)")
+        ->transform(CLI::CheckedTransformer(memoryAccessModes, CLI::ignore_case));
+
+    ControlUnit::Sequencer sequencer = ControlUnit::Sequencer::Thread;
+    app.add_option("--sequencer", sequencer, "Process of the SystemC control unit (thread, method)")
+        ->transform(CLI::CheckedTransformer(sequencers, CLI::ignore_case));
+
+    ControlUnit::RegisterAccess registerAccess = ControlUnit::RegisterAccess::Pins;
+    app.add_option("--registers", registerAccess, "Register access of the SystemC control unit (pins, direct)")
+        ->transform(CLI::CheckedTransformer(registerAccessModes, CLI::ignore_case));
+
+    bool dmi = true;
+    app.add_flag("--dmi,!--no-dmi", dmi, "Use Direct Memory Interface pointers with --memory-access tlm");
+
+    bool blockCache = false;
+    app.add_flag("--block-cache", blockCache, "Execute pre-decoded basic blocks in the SystemC control unit");
+
+    bool jit = false;
+    app.add_flag("--jit", jit, "Translate hot blocks of the functional engine to host code (Linux x86-64)");
+
+    std::string tracePath;
+    app.add_option("--trace", tracePath, "Record the executed instructions of the SystemC engine into a binary trace");
+
+    uint64_t traceCapacity = TraceWriter::DEFAULT_CAPACITY;
+    app.add_option("--trace-capacity", traceCapacity, "Instructions kept in the trace, older ones are overwritten")
+        ->check(CLI::PositiveNumber)
+        ->capture_default_str();
+
+    std::string profilePath;
+    app.add_option("--profile", profilePath, "Write a hotspot report of the guest program executed by the SystemC engine");
+
+    std::string profileJsonPath;
+    app.add_option("--profile-json", profileJsonPath, "Write the per-PC and per-opcode counters of the guest program as JSON");
+
+    double quantum = 0.0;
+    app.add_option("-q,--quantum", quantum, "Temporal decoupling quantum of the SystemC control unit in microseconds (0 = clocked)")
+        ->check(CLI::NonNegativeNumber)
+        ->capture_default_str();
+
+    std::string programPath;
+    app.add_option("-p,--program", programPath, "Raw program image loaded at address 0")
+        ->check(CLI::ExistingFile);
+
+    std::string batchPath;
+    app.add_option("--batch", batchPath, "Run the images listed in a manifest on the functional engine, one JSON line per program")
+        ->check(CLI::ExistingFile);
+
+    std::string batchOutPath;
+    app.add_option("--batch-out", batchOutPath, "File for the --batch results, stdout by default");
+
+    bool farm = false;
+    app.add_flag("--farm", farm, "Run --batch on the SystemC model in worker processes sharing the program images");
+
+    unsigned workers = 0;
+    app.add_option("--workers", workers, "Worker threads of --batch or processes of --farm (0 = one per hardware thread)")
+        ->capture_default_str();
+
+    uint64_t maxInstructions = BatchRunner::DEFAULT_MAX_INSTRUCTIONS;
+    app.add_option("--max-instructions", maxInstructions, "Instructions after which a --batch program is stopped (0 = no limit)")
+        ->capture_default_str();
+
+    double jobTimeout = 600.0;
+    app.add_option("--job-timeout", jobTimeout, "Seconds after which a --farm worker is killed and its program reported as running (0 = no limit)")
+        ->check(CLI::NonNegativeNumber)
+        ->capture_default_str();
+
+    spdlog::level::level_enum logLevel = spdlog::level::trace;
+    app.add_option("-l,--log-level", logLevel, "Level of every logger (trace, debug, info, warn, error, off)")
+        ->transform(CLI::CheckedTransformer(logLevels, CLI::ignore_case));
+
+    std::vector<std::pair<std::string, spdlog::level::level_enum>> moduleLogLevels;
+    app.add_option("--log-module", moduleLogLevels, "Level of a single logger overriding --log-level, e.g. --log-module cu trace")
+        ->check(CLI::IsMember({LogName::main, LogName::alu, LogName::memory, LogName::cu, LogName::mut, LogName::reg, LogName::engine})
+            .application_index(0))
+        ->transform(CLI::CheckedTransformer(logLevels, CLI::ignore_case).application_index(1));
+
+    bool logAsync = false;
+    app.add_flag("--log-async", logAsync, "Write the log on a dedicated thread through a bounded queue");
+
+    AsyncLogOptions logOptions;
+    app.add_option("--log-overflow", logOptions.overflow, "Full queue policy of --log-async (block, drop, sample)")
+        ->transform(CLI::CheckedTransformer(logOverflowPolicies, CLI::ignore_case));
+    app.add_option("--log-queue", logOptions.queueSize, "Queue size of --log-async in messages")
+        ->check(CLI::PositiveNumber)
+        ->capture_default_str();
+
+    CLI11_PARSE(app, argc, argv);
+    if (sequencer == ControlUnit::Sequencer::Method && (quantum != 0.0 || blockCache)) {
+        return app.exit(CLI::ValidationError("--sequencer", "method runs clocked and without the block cache"));
+    }
+    if (farm && logAsync) {
+        // The logging thread doesn't survive fork(), the workers would fill its queue
+        return app.exit(CLI::ValidationError("--farm", "the worker processes log synchronously, drop --log-async"));
+    }
+
+    if (logAsync) {
+        ConfigureAsyncFileLogging("simulator.log", logLevel, logOptions);
+    } else if (farm) {
+        // No flush thread in the parent while it forks the workers
+        ConfigureForkSafeFileLogging("simulator.log", logLevel);
+    } else {
+        ConfigureFileLogging("simulator.log", logLevel);
+    }
+    for (const auto& [name, level] : moduleLogLevels) {
+        SetLogLevel(name, level);
+    }
+
+    if (!batchPath.empty() && farm) {
+        const auto init = [&](unsigned slot) {
+            // Every worker logs into a file of its own, the parent keeps simulator.log
+            ConfigureFileLogging("simulator-worker-" + std::to_string(slot) + ".log", logLevel);
+            for (const auto& [name, level] : moduleLogLevels) {
+                SetLogLevel(name, level);
+            }
+        };
+        const int result = runFarm(batchPath, batchOutPath, workers, maxInstructions, jobTimeout, init, [&]() {
+            auto processor = std::make_unique<Intel8080>("Intel8080", sequencer, registerAccess);
+            processor->cu.setMemoryAccess(memoryAccess);
+            processor->cu.setDmiEnabled(dmi);
+            processor->cu.setQuantum(sc_core::sc_time(quantum, sc_core::SC_US));
+            processor->cu.setBlockCacheEnabled(blockCache);
+            processor->cu.setStopOnHalt(false);
+            return processor;
+        });
+        logger()->info("Shutting down...\n\n");
+        spdlog::shutdown();
+        return result;
+    }
+    if (!batchPath.empty()) {
+        const int result = runBatch(batchPath, batchOutPath, workers, maxInstructions);
+        logger()->info("Shutting down...\n\n");
+        spdlog::shutdown();
+        return result;
+    }
 
-    Intel8080 processor("Intel8080");
     std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
         0b00000110, 18,  // MVI B, 18
         0b00001110, 19,  // MVI C, 19
@@ -23,12 +365,81 @@ int sc_main(__unused int argc, __unused char* argv[]) {
         0b00111110, 24,  // MVI A, 24
         0b01110110       // HLT
     };
-    processor.loadMemory(program);
+    if (!programPath.empty()) {
+        program = utils::LoadProgram(programPath);
+    }
+
+    int result = 0;
+    if (engine == engineFunctional) {
+        result = runFunctional(program, jit);
+    } else {
+        Intel8080 processor("Intel8080", sequencer, registerAccess);
+        processor.cu.setMemoryAccess(memoryAccess);
+        processor.cu.setDmiEnabled(dmi);
+        processor.cu.setQuantum(sc_core::sc_time(quantum, sc_core::SC_US));
+        processor.cu.setBlockCacheEnabled(blockCache);
+        processor.loadMemory(program);
+
+        std::unique_ptr<TraceWriter> trace;
+        if (!tracePath.empty()) {
+            trace = std::make_unique<TraceWriter>(tracePath, traceCapacity);
+            processor.cu.setTraceWriter(trace.get());
+        }
+
+        std::unique_ptr<Profiler> profiler;
+        if (!profilePath.empty() || !profileJsonPath.empty()) {
+            profiler = std::make_unique<Profiler>();
+            processor.cu.setProfiler(profiler.get());
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        sc_core::sc_start();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-    sc_core::sc_start();
+        logger()->info("Executed {} instructions in {:.6f} s, simulated time {}",
+            processor.cu.instructionCount(), elapsed.count(), sc_core::sc_time_stamp().to_string());
+        if (elapsed.count() > 0.0) {
+            // Simulated clock rate against the 2 MHz of the real 8080, below 1x is slower than real time
+            const uint64_t cycles = processor.cu.cycleCount();
+            logger()->info("Simulated {} cycles at {:.3f} MHz effective, {:.3f}x real time", cycles,
+                static_cast<double>(cycles) / elapsed.count() / 1e6, sc_core::sc_time_stamp().to_seconds() / elapsed.count());
+        }
+        const auto accesses = processor.memory.totalCounters();
+        logger()->info("Memory: {} reads, {} writes, {} process activations, {} of {} pages resident, {} ROM write traps",
+            accesses.reads, accesses.writes, processor.memory.activations(),
+            processor.memory.residentPages(), processor.memory.PAGE_COUNT, processor.memory.romWriteTraps());
+        for (size_t region = 0; region < processor.memory.REGION_COUNT; ++region) {
+            const auto& counters = processor.memory.regionCounters(region);
+            if (counters.reads != 0 || counters.writes != 0) {
+                SIM_DEBUG(logger(), "Memory region [{}]: {} reads, {} writes",
+                    region << processor.memory.REGION_SHIFT, counters.reads, counters.writes);
+            }
+        }
+        if (blockCache) {
+            const auto& stats = processor.cu.blockCacheStats();
+            logger()->info("Block cache: {} hits, {} misses, {} invalidations", stats.hits, stats.misses, stats.invalidations);
+        }
+        if (trace) {
+            processor.cu.setTraceWriter(nullptr);
+            logger()->info("Trace: {} instructions recorded into {}", trace->written(), tracePath);
+        }
+        if (profiler) {
+            processor.cu.setProfiler(nullptr);
+            if (!profilePath.empty()) {
+                std::ofstream report(profilePath);
+                profiler->writeReport(report);
+                logger()->info("Profile: hotspot report written into {}", profilePath);
+            }
+            if (!profileJsonPath.empty()) {
+                std::ofstream json(profileJsonPath);
+                profiler->writeJson(json);
+                logger()->info("Profile: counters written into {}", profileJsonPath);
+            }
+        }
+    }
 
     logger()->info("Shutting down...\n\n");
     spdlog::shutdown();
 
-    return 0;
+    return result;
 }
@@ -8,5 +8,6 @@
 #include "memory.tpp"
 
 namespace sim {
-    template class Memory<DEFAULT_MEMORY_SIZE>;
+    template class Memory<DEFAULT_MEMORY_SIZE, NativeTypes>;
+    template class Memory<DEFAULT_MEMORY_SIZE, BitAccurateTypes>;
 }
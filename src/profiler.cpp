@@ -0,0 +1,103 @@
+//
+//  profiler.cpp
+//
+
+#include "profiler.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+
+namespace sim {
+
+Profiler::Profiler()
+    : pcCounts {}, pcOpcodes {}, opcodeCounts {}, opcodeCycles {} {
+}
+
+void Profiler::reset() {
+    pcCounts.fill(0);
+    pcOpcodes.fill(0);
+    opcodeCounts.fill(0);
+    opcodeCycles.fill(0);
+}
+
+uint64_t Profiler::instructions() const {
+    return std::accumulate(opcodeCounts.begin(), opcodeCounts.end(), uint64_t {0});
+}
+
+uint64_t Profiler::cycles() const {
+    return std::accumulate(opcodeCycles.begin(), opcodeCycles.end(), uint64_t {0});
+}
+
+void Profiler::writeReport(std::ostream& out, size_t hotspots) const {
+    const uint64_t totalInstructions = instructions();
+    const uint64_t totalCycles = cycles();
+    const auto percent = [](uint64_t value, uint64_t total) {
+        return total != 0 ? 100.0 * static_cast<double>(value) / static_cast<double>(total) : 0.0;
+    };
+
+    out << fmt::format("Guest profile: {} instructions, {} cycles\n\n", totalInstructions, totalCycles);
+
+    std::vector<unsigned> opcodes;
+    for (unsigned opcode = 0; opcode < opcodeCounts.size(); ++opcode) {
+        if (opcodeCounts[opcode] != 0) {
+            opcodes.push_back(opcode);
+        }
+    }
+    std::sort(opcodes.begin(), opcodes.end(), [this](unsigned lhs, unsigned rhs) {
+        return opcodeCycles[lhs] != opcodeCycles[rhs] ? opcodeCycles[lhs] > opcodeCycles[rhs] : lhs < rhs;
+    });
+
+    out << "Opcodes by cycles\n";
+    out << fmt::format("{:>6}  {:<10} {:>16} {:>8} {:>18} {:>8}\n", "opcode", "mnemonic", "count", "count%", "cycles", "cycles%");
+    for (const unsigned opcode : opcodes) {
+        out << fmt::format("  0x{:02X}  {:<10} {:>16} {:>7.2f}% {:>18} {:>7.2f}%\n", opcode, Mnemonic(static_cast<uint8_t>(opcode)),
+            opcodeCounts[opcode], percent(opcodeCounts[opcode], totalInstructions),
+            opcodeCycles[opcode], percent(opcodeCycles[opcode], totalCycles));
+    }
+
+    std::vector<unsigned> pcs;
+    for (unsigned pc = 0; pc < pcCounts.size(); ++pc) {
+        if (pcCounts[pc] != 0) {
+            pcs.push_back(pc);
+        }
+    }
+    const size_t shown = std::min(hotspots, pcs.size());
+    std::partial_sort(pcs.begin(), pcs.begin() + shown, pcs.end(), [this](unsigned lhs, unsigned rhs) {
+        return pcCounts[lhs] != pcCounts[rhs] ? pcCounts[lhs] > pcCounts[rhs] : lhs < rhs;
+    });
+
+    out << fmt::format("\nHot spots ({} of {} executed addresses)\n", shown, pcs.size());
+    out << fmt::format("{:>6}  {:<10} {:>16} {:>8}\n", "pc", "mnemonic", "count", "count%");
+    for (size_t i = 0; i < shown; ++i) {
+        const unsigned pc = pcs[i];
+        out << fmt::format("  {:04X}  {:<10} {:>16} {:>7.2f}%\n", pc, Mnemonic(pcOpcodes[pc]),
+            pcCounts[pc], percent(pcCounts[pc], totalInstructions));
+    }
+}
+
+void Profiler::writeJson(std::ostream& out) const {
+    out << fmt::format("{{\n  \"instructions\": {},\n  \"cycles\": {},\n  \"opcodes\": [", instructions(), cycles());
+    const char* separator = "\n";
+    for (unsigned opcode = 0; opcode < opcodeCounts.size(); ++opcode) {
+        if (opcodeCounts[opcode] != 0) {
+            out << fmt::format("{}    {{\"opcode\": {}, \"mnemonic\": \"{}\", \"count\": {}, \"cycles\": {}}}", separator,
+                opcode, Mnemonic(static_cast<uint8_t>(opcode)), opcodeCounts[opcode], opcodeCycles[opcode]);
+            separator = ",\n";
+        }
+    }
+    out << "\n  ],\n  \"pcs\": [";
+    separator = "\n";
+    for (unsigned pc = 0; pc < pcCounts.size(); ++pc) {
+        if (pcCounts[pc] != 0) {
+            out << fmt::format("{}    {{\"pc\": {}, \"opcode\": {}, \"count\": {}}}", separator, pc, pcOpcodes[pc], pcCounts[pc]);
+            separator = ",\n";
+        }
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace sim
@@ -13,22 +13,28 @@ using namespace sc_core;
 
 namespace sim {
 
-Register::Register(sc_module_name name) : sc_module(name) {
+template<typename Types>
+BasicRegister<Types>::BasicRegister(sc_module_name name) : sc_module(name) {
     SC_METHOD(update);
     sensitive << writeEnable << dataIn;
     dont_initialize();
 }
 
-void Register::reset() {
+template<typename Types>
+void BasicRegister<Types>::reset() {
     value = 0;
 }
 
-void Register::update() {
+template<typename Types>
+void BasicRegister<Types>::update() {
     if (writeEnable.read()) {
         value = dataIn.read();
-        spdlog::get(sim::LogName::reg)->trace("The value {} has been set", value.to_uint());
+        SIM_TRACE(sim::Log::reg, "The value {} has been set", ToUnsigned(value));
     }
     dataOut.write(value);
 }
 
+template class BasicRegister<NativeTypes>;
+template class BasicRegister<BitAccurateTypes>;
+
 } // namespace sim
@@ -0,0 +1,102 @@
+//
+//  regfile.cpp
+//
+
+#include "regfile.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#include <systemc>
+
+using namespace sc_core;
+
+namespace sim {
+
+template<typename Types>
+BasicRegisterFile<Types>::BasicRegisterFile(sc_module_name name)
+    : sc_module(name)
+    , direct("direct")
+    , registers {&registerA, &registerB, &registerC, &registerD, &registerE, &registerH, &registerL} {
+    direct.bind(*this);
+
+    registerA.writeEnable(aWriteEnable);
+    registerA.dataIn(dataMuxToRegA);
+    registerA.dataOut(dataRegAToMux);
+
+    registerB.writeEnable(bWriteEnable);
+    registerB.dataIn(dataMuxToRegB);
+    registerB.dataOut(dataRegBToMux);
+
+    registerC.writeEnable(cWriteEnable);
+    registerC.dataIn(dataMuxToRegC);
+    registerC.dataOut(dataRegCToMux);
+
+    registerD.writeEnable(dWriteEnable);
+    registerD.dataIn(dataMuxToRegD);
+    registerD.dataOut(dataRegDToMux);
+
+    registerE.writeEnable(eWriteEnable);
+    registerE.dataIn(dataMuxToRegE);
+    registerE.dataOut(dataRegEToMux);
+
+    registerH.writeEnable(hWriteEnable);
+    registerH.dataIn(dataMuxToRegH);
+    registerH.dataOut(dataRegHToMux);
+
+    registerL.writeEnable(lWriteEnable);
+    registerL.dataIn(dataMuxToRegL);
+    registerL.dataOut(dataRegLToMux);
+
+    mux.inputA(dataRegAToMux);
+    mux.inputB(dataRegBToMux);
+    mux.inputC(dataRegCToMux);
+    mux.inputD(dataRegDToMux);
+    mux.inputE(dataRegEToMux);
+    mux.inputH(dataRegHToMux);
+    mux.inputL(dataRegLToMux);
+    mux.outputA(dataMuxToRegA);
+    mux.outputB(dataMuxToRegB);
+    mux.outputC(dataMuxToRegC);
+    mux.outputD(dataMuxToRegD);
+    mux.outputE(dataMuxToRegE);
+    mux.outputH(dataMuxToRegH);
+    mux.outputL(dataMuxToRegL);
+
+    mux.regWriteEnable[SELECT_REG_A](aWriteEnable);
+    mux.regWriteEnable[SELECT_REG_B](bWriteEnable);
+    mux.regWriteEnable[SELECT_REG_C](cWriteEnable);
+    mux.regWriteEnable[SELECT_REG_D](dWriteEnable);
+    mux.regWriteEnable[SELECT_REG_E](eWriteEnable);
+    mux.regWriteEnable[SELECT_REG_H](hWriteEnable);
+    mux.regWriteEnable[SELECT_REG_L](lWriteEnable);
+
+    // The control unit side of the multiplexer is the pin-level interface of the file
+    mux.select(select);
+    mux.input(input);
+    mux.output(output);
+    mux.writeEnable(writeEnable);
+    mux.readEnable(readEnable);
+}
+
+template<typename Types>
+void BasicRegisterFile<Types>::reset() {
+    for (auto reg : registers) {
+        reg->reset();
+    }
+}
+
+template<typename Types>
+uint8_t BasicRegisterFile<Types>::read(uint8_t select) const {
+    return static_cast<uint8_t>(ToUnsigned(registers[select % registers.size()]->getValue()));
+}
+
+template<typename Types>
+void BasicRegisterFile<Types>::write(uint8_t select, uint8_t value) {
+    SIM_TRACE(sim::Log::reg, "Writing value {} to register {} directly", value, utils::to_binary(select));
+    registers[select % registers.size()]->setValue(value);
+}
+
+template class BasicRegisterFile<NativeTypes>;
+template class BasicRegisterFile<BitAccurateTypes>;
+
+} // namespace sim
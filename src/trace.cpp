@@ -0,0 +1,142 @@
+//
+//  trace.cpp
+//
+
+#include "trace.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIM_TRACE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr std::array<char, 8> MAGIC = {'I', '8', '0', '8', '0', 'T', 'R', 'C'};
+    constexpr uint32_t VERSION = 1;
+
+    constexpr std::array<const char*, 8> REGISTER_NAMES = {"B", "C", "D", "E", "H", "L", "M", "A"};
+    constexpr std::array<const char*, 4> PAIR_NAMES = {"B", "D", "H", "SP"};
+    constexpr std::array<const char*, 8> ALU_NAMES = {"ADD", "ADC", "SUB", "SBB", "ANA", "XRA", "ORA", "CMP"};
+    constexpr std::array<const char*, 8> ALU_IMMEDIATE_NAMES = {"ADI", "ACI", "SUI", "SBI", "ANI", "XRI", "ORI", "CPI"};
+}
+
+namespace sim {
+
+TraceWriter::TraceWriter(const std::string& path, uint64_t capacity)
+    : path(path), size(sizeof(TraceHeader) + capacity * sizeof(TraceRecord)),
+      mapping(nullptr), header(nullptr), records(nullptr), position(0) {
+    if (capacity == 0) {
+        throw std::runtime_error("TraceWriter(): capacity must not be zero");
+    }
+#ifdef SIM_TRACE_MMAP
+    const int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        throw std::runtime_error("TraceWriter(): unable to create " + path);
+    }
+    if (ftruncate(file, static_cast<off_t>(size)) != 0) {
+        close(file);
+        throw std::runtime_error("TraceWriter(): unable to resize " + path);
+    }
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("TraceWriter(): unable to map " + path);
+    }
+#else
+    // No memory-mapped files, the ring is written out by the destructor
+    if (!std::ofstream(path, std::ios::binary)) {
+        throw std::runtime_error("TraceWriter(): unable to create " + path);
+    }
+    mapping = new uint8_t[size] {};
+#endif
+    header = static_cast<TraceHeader*>(mapping);
+    records = reinterpret_cast<TraceRecord*>(static_cast<uint8_t*>(mapping) + sizeof(TraceHeader));
+    *header = TraceHeader {MAGIC, VERSION, sizeof(TraceRecord), capacity, 0, 0};
+}
+
+TraceWriter::~TraceWriter() {
+#ifdef SIM_TRACE_MMAP
+    munmap(mapping, size);
+#else
+    std::ofstream(path, std::ios::binary).write(static_cast<const char*>(mapping), static_cast<std::streamsize>(size));
+    delete[] static_cast<uint8_t*>(mapping);
+#endif
+}
+
+TraceReader::TraceReader(const std::string& path) : head {} {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("TraceReader(): unable to open " + path);
+    }
+    if (!file.read(reinterpret_cast<char*>(&head), sizeof(head)) || head.magic != MAGIC) {
+        throw std::runtime_error("TraceReader(): " + path + " is not a trace");
+    }
+    if (head.version != VERSION || head.recordSize != sizeof(TraceRecord) || head.capacity == 0) {
+        throw std::runtime_error("TraceReader(): unsupported trace format in " + path);
+    }
+
+    std::vector<TraceRecord> ring(head.capacity);
+    if (!file.read(reinterpret_cast<char*>(ring.data()), static_cast<std::streamsize>(ring.size() * sizeof(TraceRecord)))) {
+        throw std::runtime_error("TraceReader(): " + path + " is truncated");
+    }
+
+    // Once the ring has wrapped around the oldest record is the next one to be overwritten
+    const uint64_t count = head.written < head.capacity ? head.written : head.capacity;
+    const uint64_t first = head.written - count;
+    uint64_t cycle = head.baseCycle;
+    list.reserve(count);
+    for (uint64_t index = first; index < head.written; ++index) {
+        const TraceRecord& record = ring[index % head.capacity];
+        cycle += record.cycles;
+        list.push_back({cycle, index, record});
+    }
+}
+
+std::string Mnemonic(uint8_t opcode) {
+    const uint8_t opgroup = (opcode >> 6) & 0b00000011;
+    const uint8_t code = (opcode >> 3) & 0b00000111;
+    const uint8_t source = opcode & 0b00000111;
+    const uint8_t rp = (opcode >> 4) & 0b00000011;
+    const uint8_t rp_opcode = opcode & 0b00001111;
+
+    if (opcode == 0b00000000) {
+        return "NOP";
+    } else if (opcode == 0b01110110) {
+        return "HLT";
+    } else if (opgroup == 0b00 && source == 0b110) {
+        return std::string("MVI ") + REGISTER_NAMES[code];
+    } else if (opgroup == 0b00 && rp_opcode == 0b0001) {
+        return std::string("LXI ") + PAIR_NAMES[rp];
+    } else if (opgroup == 0b10) {
+        return std::string(ALU_NAMES[code]) + " " + REGISTER_NAMES[source];
+    } else if (opgroup == 0b11 && source == 0b110) {
+        return ALU_IMMEDIATE_NAMES[code];
+    }
+    char text[8];
+    std::snprintf(text, sizeof(text), "DB 0x%02X", opcode);
+    return text;
+}
+
+std::string Disassemble(const std::array<uint8_t, 3>& bytes) {
+    const uint8_t opcode = bytes[0];
+    const std::string mnemonic = Mnemonic(opcode);
+
+    char text[32];
+    if ((opcode & 0b11000111) == 0b00000110) {                  // MVI ddd,data
+        std::snprintf(text, sizeof(text), "%s, 0x%02X", mnemonic.c_str(), bytes[1]);
+    } else if ((opcode & 0b11001111) == 0b00000001) {           // LXI rp,data
+        std::snprintf(text, sizeof(text), "%s, 0x%02X%02X", mnemonic.c_str(), bytes[2], bytes[1]);
+    } else if ((opcode & 0b11000111) == 0b11000110) {           // ALU Immediate
+        std::snprintf(text, sizeof(text), "%s 0x%02X", mnemonic.c_str(), bytes[1]);
+    } else {
+        return mnemonic;
+    }
+    return text;
+}
+
+} // namespace sim
@@ -10,6 +10,10 @@
 #include <iomanip>
 #include <sstream>
 #include <bitset>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
 
 namespace sim::utils {
 
@@ -34,4 +38,25 @@ std::string to_binary(uint8_t value) {
     return "0b" + std::bitset<8>(value).to_string().substr(8 - std::numeric_limits<uint8_t>::digits);
 }
 
+std::array<uint8_t, DEFAULT_MEMORY_SIZE> LoadProgram(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("LoadProgram(): unable to open " + path);
+    }
+    const std::string image {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (image.size() > DEFAULT_MEMORY_SIZE) {
+        throw std::runtime_error("LoadProgram(): " + path + " does not fit into memory");
+    }
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+    std::copy(image.begin(), image.end(), program.begin());
+    return program;
+}
+
+uint64_t Fnv1a(const uint8_t* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001B3;
+    }
+    return hash;
+}
+
 } // namespace sim::utils
@@ -0,0 +1,129 @@
+//
+//  alu-table-tests.cpp
+//
+
+#include <systemc>
+#include <gtest/gtest.h>
+
+#include "alutable.hpp"
+
+using namespace sc_dt;
+using namespace sim;
+
+namespace {
+    // The sc_uint arithmetic ALU::execute used before the tables were introduced
+    alu::Output Reference(uint8_t opcode, uint8_t accumulator, uint8_t operand, uint8_t flags) {
+        const sc_uint<8> a = accumulator;
+        const sc_uint<8> b = operand;
+        const sc_uint<4> op = opcode;
+
+        sc_uint<8> regACC = 0;
+        sc_uint<5> regFR = flags;
+
+        switch (op) {
+            case alu::OP_ADD:
+                regACC = a + b;
+                regFR[alu::FLAG_IDX_CARRY] = a + b > 255;
+                regFR[alu::FLAG_IDX_AUX_CARRY] = ((a & 0x0F) + (b & 0x0F)) > 0x0F;
+                break;
+            case alu::OP_ADC:
+                regACC = a + b + regFR[alu::FLAG_IDX_CARRY];
+                regFR[alu::FLAG_IDX_CARRY] = (a + b + regFR[alu::FLAG_IDX_CARRY]) > 255;
+                break;
+            case alu::OP_SUB:
+                regACC = a - b;
+                regFR[alu::FLAG_IDX_CARRY] = a < b;
+                regFR[alu::FLAG_IDX_AUX_CARRY] = 0;
+                break;
+            case alu::OP_SBB:
+                regACC = a - b - regFR[alu::FLAG_IDX_CARRY];
+                regFR[alu::FLAG_IDX_CARRY] = a < (b + regFR[alu::FLAG_IDX_CARRY]);
+                regFR[alu::FLAG_IDX_AUX_CARRY] = 0;
+                break;
+            case alu::OP_ANA:
+                regACC = a & b;
+                regFR[alu::FLAG_IDX_CARRY] = 0;
+                regFR[alu::FLAG_IDX_AUX_CARRY] = ((a & 0x0F) & (b & 0x0F)) > 0x0F;
+                break;
+            case alu::OP_XRA:
+                regACC = a ^ b;
+                regFR[alu::FLAG_IDX_CARRY] = 0;
+                regFR[alu::FLAG_IDX_AUX_CARRY] = 0;
+                break;
+            case alu::OP_ORA:
+                regACC = a | b;
+                regFR[alu::FLAG_IDX_CARRY] = 0;
+                regFR[alu::FLAG_IDX_AUX_CARRY] = 0;
+                break;
+            case alu::OP_CMP:
+                regACC = a - b;
+                regFR[alu::FLAG_IDX_CARRY] = a < b;
+                regFR[alu::FLAG_IDX_AUX_CARRY] = 0;
+                break;
+            default:
+                // Undefined opcodes leave the flags untouched
+                return {0, static_cast<uint8_t>(regFR.to_uint())};
+        }
+
+        regFR[alu::FLAG_IDX_ZERO] = regACC == 0;
+        regFR[alu::FLAG_IDX_SIGN] = regACC[7];
+        regFR[alu::FLAG_IDX_PARITY] = __builtin_parity(static_cast<unsigned int>(regACC));
+        if (op == alu::OP_CMP) {
+            regACC = 0;
+        }
+
+        return {static_cast<uint8_t>(regACC.to_uint()), static_cast<uint8_t>(regFR.to_uint())};
+    }
+
+    // The tables are usable at compile time
+    static_assert(alu::Execute(alu::OP_ADD, 200, 100, 0).result == 44);
+    static_assert(alu::Execute(alu::OP_ADD, 200, 100, 0).flags == (alu::FLAG_CARRY | alu::FLAG_PARITY));
+    static_assert(alu::Execute(alu::OP_CMP, 5, 5, 0).result == 0);
+    static_assert(alu::Execute(alu::OP_CMP, 5, 5, 0).flags == alu::FLAG_ZERO);
+}
+
+TEST(ALUTableTests, FlagTableTest) {
+    for (unsigned raw = 0; raw < alu::FLAG_TABLE.size(); ++raw) {
+        const uint8_t value = static_cast<uint8_t>(raw);
+        const uint8_t flags = alu::FLAG_TABLE[raw];
+        EXPECT_EQ((flags & alu::FLAG_ZERO) != 0, value == 0) << raw;
+        EXPECT_EQ((flags & alu::FLAG_CARRY) != 0, raw > 0xFF) << raw;
+        EXPECT_EQ((flags & alu::FLAG_SIGN) != 0, (value & 0x80) != 0) << raw;
+        EXPECT_EQ((flags & alu::FLAG_PARITY) != 0, __builtin_parity(value) != 0) << raw;
+        EXPECT_EQ(flags & alu::FLAG_AUX_CARRY, 0) << raw;
+    }
+}
+
+TEST(ALUTableTests, ExhaustiveReferenceTest) {
+    // Carry-in and auxiliary carry combinations, with the other flags toggled to check they are overwritten or kept
+    const std::array<uint8_t, 4> inputFlags = {
+        0,
+        alu::FLAG_CARRY | alu::FLAG_ZERO | alu::FLAG_SIGN,
+        alu::FLAG_AUX_CARRY | alu::FLAG_PARITY,
+        alu::FLAG_ALL,
+    };
+
+    unsigned mismatches = 0;
+    for (unsigned op = 0; op < alu::OP_COUNT; ++op) {
+        for (unsigned a = 0; a < 256; ++a) {
+            for (unsigned b = 0; b < 256; ++b) {
+                for (const uint8_t flags : inputFlags) {
+                    const auto opcode = static_cast<uint8_t>(op);
+                    const auto accumulator = static_cast<uint8_t>(a);
+                    const auto operand = static_cast<uint8_t>(b);
+                    const auto expected = Reference(opcode, accumulator, operand, flags);
+                    const auto actual = alu::Execute(opcode, accumulator, operand, flags);
+                    if (expected.result != actual.result || expected.flags != actual.flags) {
+                        // Report only the first few to keep the output readable
+                        if (++mismatches <= 10) {
+                            ADD_FAILURE() << "op=" << op << " a=" << a << " b=" << b << " flags=" << +flags
+                                << ": expected " << +expected.result << "/" << +expected.flags
+                                << ", got " << +actual.result << "/" << +actual.flags;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
@@ -0,0 +1,157 @@
+//
+//  batch-tests.cpp
+//
+
+#include <gtest/gtest.h>
+
+#include "batch.hpp"
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace sim;
+
+namespace {
+    using Image = std::array<uint8_t, DEFAULT_MEMORY_SIZE>;
+
+    // MVI A, seed followed by `additions` ADI 1 and HLT
+    Image MakeProgram(uint8_t seed, size_t additions) {
+        Image program {};
+        size_t size = 0;
+        program[size++] = 0b00111110;
+        program[size++] = seed;
+        for (size_t i = 0; i < additions; ++i) {
+            program[size++] = 0b11000110;
+            program[size++] = 1;
+        }
+        program[size] = 0b01110110;
+        return program;
+    }
+
+    BatchRunner::Loader MapLoader(const std::map<std::string, Image>& images) {
+        return [&images](const std::string& program) {
+            if (auto it = images.find(program); it != images.end()) {
+                return it->second;
+            }
+            throw std::runtime_error("LoadProgram(): can't open " + program);
+        };
+    }
+}
+
+TEST(BatchRunnerTests, ResultsMatchEngineTest) {
+    std::map<std::string, Image> images;
+    std::vector<std::string> programs;
+    for (size_t i = 0; i < 64; ++i) {
+        const std::string name = "program" + std::to_string(i);
+        images[name] = MakeProgram(static_cast<uint8_t>(i), (i * 37) % 500);
+        programs.push_back(name);
+    }
+
+    BatchRunner runner(4);
+    runner.setLoader(MapLoader(images));
+    std::vector<BatchRunner::Result> results(programs.size());
+    std::vector<int> reported(programs.size(), 0);
+    const auto stats = runner.run(programs, [&](const BatchRunner::Result& result) {
+        results[result.index] = result;
+        ++reported[result.index];
+    });
+
+    EXPECT_EQ(stats.programs, programs.size());
+    for (size_t i = 0; i < programs.size(); ++i) {
+        SCOPED_TRACE(i);
+        ASSERT_EQ(reported[i], 1);
+
+        FunctionalEngine engine;
+        engine.load(images[programs[i]]);
+        engine.run();
+
+        const auto& result = results[i];
+        EXPECT_TRUE(result.error.empty());
+        EXPECT_EQ(result.program, programs[i]);
+        EXPECT_EQ(result.status, FunctionalEngine::Status::Halted);
+        EXPECT_EQ(result.state.registers, engine.state().registers);
+        EXPECT_EQ(result.state.pc, engine.state().pc);
+        EXPECT_EQ(result.state.flags, engine.state().flags);
+        EXPECT_EQ(result.instructions, engine.instructionCount());
+        EXPECT_EQ(result.cycles, 7 + 7 * ((i * 37) % 500) + 7);
+        EXPECT_EQ(result.memoryDigest, engine.memoryDigest());
+    }
+}
+
+TEST(BatchRunnerTests, WorkStealingTest) {
+    // The first worker gets every slow program, the second one has to steal them
+    std::map<std::string, Image> images {{"fast", MakeProgram(1, 1)}, {"slow", MakeProgram(2, 1)}};
+    std::vector<std::string> programs;
+    for (size_t i = 0; i < 20; ++i) {
+        programs.push_back(i % 2 == 0 ? "slow" : "fast");
+    }
+
+    BatchRunner runner(2);
+    runner.setLoader([&images](const std::string& program) {
+        if (program == "slow") {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return images.at(program);
+    });
+    uint64_t count = 0;
+    const auto stats = runner.run(programs, [&count](const BatchRunner::Result&) { ++count; });
+
+    EXPECT_EQ(count, programs.size());
+    EXPECT_GT(stats.steals, 0);
+}
+
+TEST(BatchRunnerTests, LoadErrorAndLimitTest) {
+    Image loop {};      // NOPs only, never halts
+    std::map<std::string, Image> images {{"good", MakeProgram(5, 2)}, {"loop", loop}};
+
+    BatchRunner runner(3);
+    runner.setLoader(MapLoader(images));
+    runner.setMaxInstructions(1000);
+    std::map<std::string, BatchRunner::Result> results;
+    runner.run({"good", "missing", "loop"}, [&results](const BatchRunner::Result& result) {
+        results[result.program] = result;
+    });
+
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_EQ(results["good"].status, FunctionalEngine::Status::Halted);
+    EXPECT_EQ(results["good"].state.registers[FunctionalEngine::REG_A], 7);
+    EXPECT_NE(results["missing"].error.find("missing"), std::string::npos);
+    EXPECT_EQ(results["loop"].status, FunctionalEngine::Status::Running);
+    EXPECT_EQ(results["loop"].instructions, 1000);
+    EXPECT_EQ(results["loop"].cycles, 4000);
+}
+
+TEST(BatchRunnerTests, SinkExceptionTest) {
+    std::map<std::string, Image> images {{"good", MakeProgram(5, 2)}};
+
+    BatchRunner runner(2);
+    runner.setLoader(MapLoader(images));
+    EXPECT_THROW(runner.run({"good", "good", "good"}, [](const BatchRunner::Result&) {
+        throw std::runtime_error("sink failed");
+    }), std::runtime_error);
+}
+
+TEST(BatchRunnerTests, ManifestAndJsonTest) {
+    std::istringstream manifest("# programs\nfirst.bin\r\n\nsecond \"quoted\".bin\n");
+    const auto programs = BatchRunner::ReadManifest(manifest);
+    ASSERT_EQ(programs.size(), 2);
+    EXPECT_EQ(programs[0], "first.bin");
+
+    BatchRunner::Result result;
+    result.index = 3;
+    result.program = programs[1];
+    result.status = FunctionalEngine::Status::Halted;
+    result.state.registers[FunctionalEngine::REG_A] = 9;
+    result.state.pc = 4;
+    result.instructions = 2;
+    result.cycles = 14;
+    result.memoryDigest = 0xAB;
+    std::ostringstream out;
+    BatchRunner::WriteJson(out, result);
+    EXPECT_EQ(out.str(), "{\"index\": 3, \"program\": \"second \\\"quoted\\\".bin\", \"status\": \"halted\", "
+        "\"a\": 9, \"b\": 0, \"c\": 0, \"d\": 0, \"e\": 0, \"h\": 0, \"l\": 0, \"pc\": 4, \"sp\": 0, \"flags\": 0, "
+        "\"instructions\": 2, \"cycles\": 14, \"memoryDigest\": \"00000000000000ab\"}\n");
+}
@@ -0,0 +1,291 @@
+//
+//  engine-tests.cpp
+//
+
+#include <gtest/gtest.h>
+
+#include "engine.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace sim;
+
+namespace {
+    constexpr uint8_t FLAG_ZERO = 1 << 0;
+    constexpr uint8_t FLAG_CARRY = 1 << 1;
+    constexpr uint8_t FLAG_SIGN = 1 << 2;
+}
+
+TEST(FunctionalEngineTests, MVIInstructionTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00000000,      // NOP
+        0b00000110, 18,  // MVI B, 18
+        0b00001110, 19,  // MVI C, 19
+        0b00010110, 20,  // MVI D, 20
+        0b00011110, 21,  // MVI E, 21
+        0b00100110, 22,  // MVI H, 22
+        0b00101110, 23,  // MVI L, 23
+        0b00111110, 24,  // MVI A, 24
+        0b01110110       // HLT
+    });
+
+    EXPECT_EQ(engine.run(), 9);
+    EXPECT_EQ(engine.status(), FunctionalEngine::Status::Halted);
+
+    const auto& state = engine.state();
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_B], 18);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_C], 19);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_D], 20);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_E], 21);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_H], 22);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_L], 23);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_A], 24);
+    EXPECT_EQ(state.pc, 15);
+}
+
+TEST(FunctionalEngineTests, MVI_M_InstructionTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00100110, 0b00000001,  // MVI H, 0x01
+        0b00101110, 0b00001000,  // MVI L, 0x08
+        0b00110110, 117,         // MVI M, 117
+        0b01110110               // HLT
+    });
+    engine.run();
+
+    EXPECT_EQ(engine.readMemAt(0x0108), 117);
+}
+
+TEST(FunctionalEngineTests, LXIInstructionTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00000001, 5, 7,       // LXI B (B <- 7, C <- 5)
+        0b00010001, 3, 9,       // LXI D (D <- 9, E <- 3)
+        0b00100001, 6, 2,       // LXI H (H <- 2, L <- 6)
+        0b00110001, 0x34, 0x12, // LXI SP (SP <- 0x1234)
+        0b01110110,             // HLT
+    });
+    engine.run();
+
+    const auto& state = engine.state();
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_B], 7);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_C], 5);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_D], 9);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_E], 3);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_H], 2);
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_L], 6);
+    EXPECT_EQ(state.sp, 0x1234);
+}
+
+TEST(FunctionalEngineTests, ALUInstructionTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00111110, 200,        // MVI A, 200
+        0b00000110, 100,        // MVI B, 100
+        0b10000000,             // ADD B      (A = 44, Cy = 1)
+        0b10001000,             // ADC B      (A = 145, Cy = 0)
+        0b11010110, 146,        // SUI 146    (A = 255, Cy = 1)
+        0b01110110,             // HLT
+    });
+    engine.run();
+
+    const auto& state = engine.state();
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_A], 255);
+    EXPECT_EQ(state.flags & FLAG_CARRY, FLAG_CARRY);
+    EXPECT_EQ(state.flags & FLAG_SIGN, FLAG_SIGN);
+    EXPECT_EQ(state.flags & FLAG_ZERO, 0);
+}
+
+TEST(FunctionalEngineTests, ALUMemoryOperandTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00100001, 0x00, 0x01, // LXI H, 0x0100
+        0b00110110, 0x0F,       // MVI M, 0x0F
+        0b00111110, 0xFF,       // MVI A, 0xFF
+        0b10100110,             // ANA M      (A = 0x0F)
+        0b10101110,             // XRA M      (A = 0)
+        0b01110110,             // HLT
+    });
+    engine.run();
+
+    const auto& state = engine.state();
+    EXPECT_EQ(state.registers[FunctionalEngine::REG_A], 0);
+    EXPECT_EQ(state.flags & FLAG_ZERO, FLAG_ZERO);
+    EXPECT_EQ(state.flags & FLAG_CARRY, 0);
+}
+
+TEST(FunctionalEngineTests, StepAndLimitTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00000000,             // NOP
+        0b00000000,             // NOP
+        0b00000000,             // NOP
+        0b01110110,             // HLT
+    });
+
+    EXPECT_EQ(engine.step(), FunctionalEngine::Status::Running);
+    EXPECT_EQ(engine.state().pc, 1);
+    EXPECT_EQ(engine.run(1), 1);
+    EXPECT_EQ(engine.state().pc, 2);
+    EXPECT_EQ(engine.run(), 2);
+    EXPECT_EQ(engine.status(), FunctionalEngine::Status::Halted);
+    EXPECT_EQ(engine.instructionCount(), 4);
+    EXPECT_EQ(engine.run(), 0);
+}
+
+TEST(FunctionalEngineTests, CycleCountTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00000000,              // NOP       4
+        0b00100001, 0x00, 0x20,  // LXI H     10
+        0b00110110, 0x2A,        // MVI M     10
+        0b00000110, 0x01,        // MVI B     7
+        0b10000110,              // ADD M     7
+        0b10000000,              // ADD B     4
+        0b11000110, 0x01,        // ADI 1     7
+        0b01110110               // HLT       7
+    });
+    engine.run();
+
+    EXPECT_EQ(engine.cycleCount(), 4 + 10 + 10 + 7 + 7 + 4 + 7 + 7);
+    const uint64_t digest = engine.memoryDigest();
+    engine.reset();
+    EXPECT_EQ(engine.cycleCount(), 0);
+    EXPECT_NE(engine.memoryDigest(), digest);
+}
+
+TEST(FunctionalEngineTests, UnknownOpcodeTrapTest) {
+    FunctionalEngine engine;
+    engine.load({
+        0b00000000,             // NOP
+        0b01000111,             // MOV B, A (not implemented)
+        0b01110110,             // HLT
+    });
+
+    EXPECT_EQ(engine.run(), 1);
+    EXPECT_EQ(engine.status(), FunctionalEngine::Status::Trapped);
+    EXPECT_EQ(engine.state().pc, 1);
+}
+
+namespace {
+    // Never halting random program for the JIT: the whole memory is code, PC wraps around at 0xFFFF.
+    // Every data byte (and so every byte MVI M can write) is NOP or a one-byte ALU instruction, so
+    // overwritten code and operands executed as opcodes stay implemented instructions.
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> MakeRandomProgram(uint32_t seed) {
+        std::mt19937 random(seed);
+        const auto data = [&random]() {
+            const uint8_t value = static_cast<uint8_t>(random() % 65);
+            return value == 64 ? uint8_t {0} : static_cast<uint8_t>(0x80 | value);
+        };
+
+        std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+        size_t pc = 0;
+        while (pc + 3 <= program.size()) {
+            const uint8_t code = random() % 8;
+            switch (random() % 6) {
+                case 0:                                                     // NOP
+                    program[pc++] = 0b00000000;
+                    break;
+                case 1:                                                     // MVI ddd,data
+                    program[pc++] = static_cast<uint8_t>(0b00000110 | (code << 3));
+                    program[pc++] = data();
+                    break;
+                case 2:                                                     // LXI rp,data
+                    program[pc++] = static_cast<uint8_t>(0b00000001 | ((code & 0b11) << 4));
+                    program[pc++] = data();
+                    program[pc++] = data();
+                    break;
+                case 3:
+                case 4:                                                     // ALU sss
+                    program[pc++] = static_cast<uint8_t>(0b10000000 | (random() % 64));
+                    break;
+                case 5:                                                     // ALU Immediate
+                    program[pc++] = static_cast<uint8_t>(0b11000110 | (code << 3));
+                    program[pc++] = data();
+                    break;
+            }
+        }
+        return program;
+    }
+}
+
+TEST(FunctionalEngineTests, JitMatchesInterpreterTest) {
+    if (!Jit::isSupported()) {
+        GTEST_SKIP() << "JIT isn't supported on this host";
+    }
+
+    for (const uint32_t seed : {1u, 2u, 3u}) {
+        const auto program = MakeRandomProgram(seed);
+
+        FunctionalEngine interpreter;
+        interpreter.load(program);
+        FunctionalEngine translator;
+        ASSERT_TRUE(translator.setJitEnabled(true));
+        translator.load(program);
+
+        // Uneven budgets stop the translated code in the middle of its blocks
+        std::mt19937 random(seed);
+        for (int i = 0; i < 200; ++i) {
+            const uint64_t budget = 1 + random() % 30000;
+            ASSERT_EQ(interpreter.run(budget), budget);
+            ASSERT_EQ(translator.run(budget), budget);
+
+            const auto& expected = interpreter.state();
+            const auto& actual = translator.state();
+            ASSERT_EQ(actual.pc, expected.pc) << "seed " << seed << ", run " << i;
+            ASSERT_EQ(actual.sp, expected.sp);
+            ASSERT_EQ(actual.flags, expected.flags);
+            ASSERT_EQ(actual.registers, expected.registers);
+            ASSERT_EQ(translator.cycleCount(), interpreter.cycleCount());
+        }
+        EXPECT_EQ(translator.instructionCount(), interpreter.instructionCount());
+        for (size_t address = 0; address < DEFAULT_MEMORY_SIZE; ++address) {
+            ASSERT_EQ(translator.readMemAt(address), interpreter.readMemAt(address)) << "address " << address;
+        }
+
+        const auto stats = translator.jitStats();
+        EXPECT_GT(stats.translations, 0);
+        EXPECT_GT(stats.entries, 0);
+    }
+}
+
+TEST(FunctionalEngineTests, JitSelfModifyingCodeTest) {
+    if (!Jit::isSupported()) {
+        GTEST_SKIP() << "JIT isn't supported on this host";
+    }
+
+    // Every pass through the memory ends by rewriting ADI 1 at 0x0000 into ADI 2,
+    // which is translated code once the first page gets hot
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+    for (size_t i = 0; i < 0xFFFA; i += 2) {
+        program[i] = 0b11000110;        // ADI 1
+        program[i + 1] = 1;
+    }
+    const std::array<uint8_t, 6> patch = {
+        0b00100001, 0x01, 0x00,         // LXI H, 0x0001
+        0b00110110, 0x02,               // MVI M, 2
+        0b00000000,                     // NOP
+    };
+    std::copy(patch.begin(), patch.end(), program.begin() + 0xFFFA);
+
+    FunctionalEngine interpreter;
+    interpreter.load(program);
+    FunctionalEngine translator;
+    ASSERT_TRUE(translator.setJitEnabled(true));
+    translator.load(program);
+    const uint64_t flushes = translator.jitStats().flushes;
+
+    const uint64_t instructions = 0x8000 * (Jit::HOT_THRESHOLD + 4);
+    EXPECT_EQ(interpreter.run(instructions), instructions);
+    EXPECT_EQ(translator.run(instructions), instructions);
+
+    EXPECT_EQ(translator.state().pc, interpreter.state().pc);
+    EXPECT_EQ(translator.state().registers, interpreter.state().registers);
+    EXPECT_EQ(translator.state().flags, interpreter.state().flags);
+    EXPECT_EQ(translator.cycleCount(), interpreter.cycleCount());     // Counts the partial block left on the write too
+    EXPECT_EQ(translator.readMemAt(0x0001), 2);
+    EXPECT_GT(translator.jitStats().translations, 0);
+    EXPECT_GT(translator.jitStats().flushes, flushes);
+}
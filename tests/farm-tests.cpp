@@ -0,0 +1,206 @@
+//
+//  farm-tests.cpp
+//
+
+#include <gtest/gtest.h>
+
+#include "farm.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+using namespace sim;
+
+namespace {
+    using Image = std::array<uint8_t, DEFAULT_MEMORY_SIZE>;
+
+    // MVI A, seed followed by `additions` ADI 1 and HLT
+    Image MakeProgram(uint8_t seed, size_t additions) {
+        Image program {};
+        size_t size = 0;
+        program[size++] = 0b00111110;
+        program[size++] = seed;
+        for (size_t i = 0; i < additions; ++i) {
+            program[size++] = 0b11000110;
+            program[size++] = 1;
+        }
+        program[size] = 0b01110110;
+        return program;
+    }
+
+    // The farm doesn't care about the model, the functional engine keeps the workers free of SystemC
+    BatchRunner::Result RunEngine(size_t index, const Image& image) {
+        FunctionalEngine engine;
+        engine.load(image);
+        engine.run();
+
+        BatchRunner::Result result;
+        result.index = index;
+        result.status = engine.status();
+        result.state = engine.state();
+        result.instructions = engine.instructionCount();
+        result.cycles = engine.cycleCount();
+        result.memoryDigest = engine.memoryDigest();
+        return result;
+    }
+}
+
+TEST(ImageStoreTests, SharedImagesTest) {
+    ImageStore store;
+    store.add(MakeProgram(1, 3));
+    store.add(Image {});
+    store.add(MakeProgram(2, 0));
+    store.seal();
+
+    ASSERT_EQ(store.size(), 3);
+    EXPECT_EQ(store.bytes(), 9 + 0 + 3);     // Trailing zeros aren't stored
+    EXPECT_EQ(store.image(0), MakeProgram(1, 3));
+    EXPECT_EQ(store.image(1), Image {});
+    EXPECT_EQ(store.image(2), MakeProgram(2, 0));
+    EXPECT_THROW(store.add(Image {}), std::runtime_error);
+    EXPECT_THROW(store.image(3), std::out_of_range);
+}
+
+TEST(ProcessFarmTests, ResultsMatchEngineTest) {
+    if (!ProcessFarm::isSupported()) {
+        GTEST_SKIP() << "The farm needs a POSIX host";
+    }
+    ImageStore store;
+    std::vector<std::string> programs;
+    for (size_t i = 0; i < 24; ++i) {
+        store.add(MakeProgram(static_cast<uint8_t>(i), i * 5));
+        programs.push_back("program" + std::to_string(i));
+    }
+    store.seal();
+
+    ProcessFarm farm(3);
+    std::map<size_t, BatchRunner::Result> results;
+    const auto stats = farm.run(store, programs, RunEngine, [&results](const BatchRunner::Result& result) {
+        results[result.index] = result;
+    });
+
+    EXPECT_EQ(stats.programs, programs.size());
+    EXPECT_EQ(stats.failedWorkers, 0);
+    ASSERT_EQ(results.size(), programs.size());
+    for (size_t i = 0; i < programs.size(); ++i) {
+        SCOPED_TRACE(i);
+        const auto expected = RunEngine(i, MakeProgram(static_cast<uint8_t>(i), i * 5));
+        const auto& result = results[i];
+        EXPECT_TRUE(result.error.empty());
+        EXPECT_EQ(result.program, programs[i]);
+        EXPECT_EQ(result.status, FunctionalEngine::Status::Halted);
+        EXPECT_EQ(result.state.registers, expected.state.registers);
+        EXPECT_EQ(result.state.pc, expected.state.pc);
+        EXPECT_EQ(result.state.flags, expected.state.flags);
+        EXPECT_EQ(result.cycles, expected.cycles);
+        EXPECT_EQ(result.memoryDigest, expected.memoryDigest);
+    }
+}
+
+TEST(ProcessFarmTests, WorkerFailureTest) {
+    if (!ProcessFarm::isSupported()) {
+        GTEST_SKIP() << "The farm needs a POSIX host";
+    }
+    ImageStore store;
+    std::vector<std::string> programs;
+    for (size_t i = 0; i < 6; ++i) {
+        store.add(MakeProgram(static_cast<uint8_t>(i), 1));
+        programs.push_back("program" + std::to_string(i));
+    }
+    store.seal();
+
+    // Job 1 throws in the worker, job 4 takes its worker process down
+    ProcessFarm farm(2);
+    std::map<size_t, BatchRunner::Result> results;
+    const auto stats = farm.run(store, programs, [](size_t index, const Image& image) {
+        if (index == 1) {
+            throw std::runtime_error("model failed");
+        }
+        if (index == 4) {
+            std::_Exit(3);
+        }
+        return RunEngine(index, image);
+    }, [&results](const BatchRunner::Result& result) {
+        results[result.index] = result;
+    });
+
+    ASSERT_EQ(results.size(), programs.size());
+    EXPECT_EQ(stats.failedWorkers, 1);
+    EXPECT_EQ(results[1].error, "model failed");
+    EXPECT_EQ(results[4].error, "worker process exited");
+    for (const size_t i : {0, 2, 3, 5}) {
+        EXPECT_TRUE(results[i].error.empty()) << i;
+        EXPECT_EQ(results[i].status, FunctionalEngine::Status::Halted) << i;
+    }
+}
+
+TEST(ProcessFarmTests, JobTimeoutTest) {
+    if (!ProcessFarm::isSupported()) {
+        GTEST_SKIP() << "The farm needs a POSIX host";
+    }
+    ImageStore store;
+    std::vector<std::string> programs;
+    for (size_t i = 0; i < 5; ++i) {
+        store.add(MakeProgram(static_cast<uint8_t>(i), 1));
+        programs.push_back("program" + std::to_string(i));
+    }
+    store.seal();
+
+    // Job 2 never returns, the only worker is killed and replaced for the rest
+    ProcessFarm farm(1);
+    farm.setJobTimeout(std::chrono::milliseconds(200));
+    std::map<size_t, BatchRunner::Result> results;
+    const auto stats = farm.run(store, programs, [](size_t index, const Image& image) {
+        if (index == 2) {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+        return RunEngine(index, image);
+    }, [&results](const BatchRunner::Result& result) {
+        results[result.index] = result;
+    });
+
+    ASSERT_EQ(results.size(), programs.size());
+    EXPECT_EQ(stats.timedOut, 1);
+    EXPECT_EQ(stats.failedWorkers, 0);
+    EXPECT_EQ(results[2].status, FunctionalEngine::Status::Running);
+    EXPECT_EQ(results[2].error, "timed out after 200 ms");
+    for (const size_t i : {0, 1, 3, 4}) {
+        EXPECT_TRUE(results[i].error.empty()) << i;
+        EXPECT_EQ(results[i].status, FunctionalEngine::Status::Halted) << i;
+    }
+}
+
+TEST(ProcessFarmTests, WorkerInitTest) {
+    if (!ProcessFarm::isSupported()) {
+        GTEST_SKIP() << "The farm needs a POSIX host";
+    }
+    ImageStore store;
+    std::vector<std::string> programs;
+    for (size_t i = 0; i < 8; ++i) {
+        store.add(MakeProgram(static_cast<uint8_t>(i), 1));
+        programs.push_back("program" + std::to_string(i));
+    }
+    store.seal();
+
+    // The init runs in the workers only, every job reports the slot of its worker
+    static unsigned slotOfWorker = 99;
+    ProcessFarm farm(2);
+    farm.setWorkerInit([](unsigned slot) { slotOfWorker = slot; });
+    std::map<size_t, BatchRunner::Result> results;
+    farm.run(store, programs, [](size_t index, const Image& image) {
+        BatchRunner::Result result = RunEngine(index, image);
+        result.memoryDigest = slotOfWorker;
+        return result;
+    }, [&results](const BatchRunner::Result& result) {
+        results[result.index] = result;
+    });
+
+    ASSERT_EQ(results.size(), programs.size());
+    EXPECT_EQ(slotOfWorker, 99);
+    for (const auto& [index, result] : results) {
+        EXPECT_LT(result.memoryDigest, 2) << index;
+    }
+}
@@ -0,0 +1,132 @@
+//
+//  log-tests.cpp
+//
+
+#include <gtest/gtest.h>
+
+#include "log.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LOG_TESTS_FIFO 1
+#endif
+
+using namespace sim;
+
+namespace {
+    const size_t QueueSize = 4;
+    const size_t Messages = 1000;
+
+    class LogTests : public ::testing::Test {
+    protected:
+        void TearDown() override {
+            // tests/main.cpp logs through the registered loggers on exit
+            ConfigureNullLogging();
+        }
+
+#if LOG_TESTS_FIFO
+        // Logs into a pipe nobody reads: the writer thread blocks once the pipe is full,
+        // so all but the first few dozen messages overflow the small queue
+        LogStats FillQueue(LogOverflow overflow) {
+            const std::string path = (std::filesystem::temp_directory_path() / "sim-log-tests.fifo").string();
+            std::remove(path.c_str());
+            if (mkfifo(path.c_str(), 0600) != 0) {
+                ADD_FAILURE() << "mkfifo() failed";
+                return {};
+            }
+            // Opened first so the file sink doesn't wait for a reader
+            const int reader = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+
+            AsyncLogOptions options;
+            options.queueSize = QueueSize;
+            options.overflow = overflow;
+            options.sampleRate = 16;
+            ConfigureAsyncFileLogging(path, spdlog::level::trace, options);
+
+            const std::string payload(1024, 'x');
+            for (size_t i = 0; i < Messages; ++i) {
+                Log::cu->info("{} {}", i, payload);
+            }
+            // 10 of 160 get through the sampling
+            for (size_t i = 0; i < 160; ++i) {
+                if (Log::cu.sample(spdlog::level::debug)) {
+                    Log::cu->debug("{}", i);
+                }
+            }
+            const auto stats = GetLogStats();
+
+            // Let the writer go idle with nothing buffered before the pipe loses its reader
+            const auto logger = spdlog::get(LogName::cu);
+            ConfigureNullLogging();
+            logger->flush();
+            std::signal(SIGPIPE, SIG_IGN);
+            char buffer[4096];
+            auto lastRead = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - lastRead < std::chrono::milliseconds(200)) {
+                if (read(reader, buffer, sizeof(buffer)) > 0) {
+                    lastRead = std::chrono::steady_clock::now();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            close(reader);
+            std::remove(path.c_str());
+            return stats;
+        }
+#endif
+    };
+}
+
+TEST_F(LogTests, DropOverflowTest) {
+#if LOG_TESTS_FIFO
+    const auto stats = FillQueue(LogOverflow::Drop);
+    EXPECT_GT(stats.dropped, Messages / 2);
+    EXPECT_LE(stats.dropped, Messages + 160 + 1);
+    EXPECT_EQ(stats.sampled, 0);
+#else
+    GTEST_SKIP() << "The test needs a POSIX host";
+#endif
+}
+
+TEST_F(LogTests, SampleOverflowTest) {
+#if LOG_TESTS_FIFO
+    const auto stats = FillQueue(LogOverflow::Sample);
+    EXPECT_GT(stats.dropped, Messages / 2);
+    EXPECT_LE(stats.dropped, Messages + 10 + 1);
+    EXPECT_EQ(stats.sampled, 150);
+#else
+    GTEST_SKIP() << "The test needs a POSIX host";
+#endif
+}
+
+TEST_F(LogTests, BlockingLoggingStatsTest) {
+    ConfigureNullLogging();
+    for (size_t i = 0; i < 160; ++i) {
+        EXPECT_TRUE(Log::cu.sample(spdlog::level::debug));
+    }
+    const auto stats = GetLogStats();
+    EXPECT_EQ(stats.dropped, 0);
+    EXPECT_EQ(stats.sampled, 0);
+}
+
+TEST_F(LogTests, SetLogLevelTest) {
+    ConfigureNullLogging();
+    ASSERT_TRUE(SetLogLevel(LogName::alu, spdlog::level::warn));
+
+    EXPECT_EQ(spdlog::get(LogName::alu)->level(), spdlog::level::warn);
+    EXPECT_FALSE(Log::alu->should_log(spdlog::level::info));
+    for (const std::string* name : {&LogName::main, &LogName::memory, &LogName::cu, &LogName::mut, &LogName::reg,
+                                    &LogName::engine}) {
+        EXPECT_EQ(spdlog::get(*name)->level(), spdlog::level::trace) << *name;
+    }
+    EXPECT_FALSE(SetLogLevel("unknown", spdlog::level::off));
+}
@@ -5,45 +5,157 @@
 //
 
 #include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
 #include <gtest/gtest.h>
 
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "modules.hpp"
 #include "memory.hpp"
+#include "utils.hpp"
 
 using namespace sc_core;
 using namespace sim;
 
 static constexpr size_t MemorySize = 65536;    // 64 KB
 
+class MemoryInitiator final : public sc_core::sc_module {
+public:
+    tlm_utils::simple_initiator_socket<MemoryInitiator> socket {"socket"};
+    int invalidations {0};
+
+    MemoryInitiator(sc_core::sc_module_name name) : sc_core::sc_module(name) {
+        socket.register_invalidate_direct_mem_ptr(this, &MemoryInitiator::invalidate);
+    }
+
+private:
+    void invalidate(sc_dt::uint64, sc_dt::uint64) {
+        ++invalidations;
+    }
+};
+
+template<typename Types>
 class MemoryConsumer final {
-    Memory<MemorySize> memory {"Memory"};
+    Memory<MemorySize, Types> memory;
+    MemoryInitiator initiator;
 public:
     // Signal declarations
-    sc_core::sc_signal<sc_dt::sc_uint<16>> address;
-    sc_core::sc_signal<sc_dt::sc_uint<8>> dataIn;
-    sc_core::sc_signal<sc_dt::sc_uint<8>> dataOut;
+    sc_core::sc_signal<typename Types::Address> address;
+    sc_core::sc_signal<typename Types::Byte> dataIn;
+    sc_core::sc_signal<typename Types::Byte> dataOut;
     sc_core::sc_signal<bool> read;
     sc_core::sc_signal<bool> write;
 
-    MemoryConsumer() {
+    explicit MemoryConsumer(const std::string& name)
+        : memory(name.c_str()), initiator((name + "Initiator").c_str()) {
         // Bind signals to Memory ports
         memory.addressBus(address);
         memory.dataBusIn(dataIn);
         memory.dataBusOut(dataOut);
         memory.readEnable(read);
         memory.writeEnable(write);
+        initiator.socket.bind(memory.socket);
     }
 
     void load(const std::array<uint8_t, MemorySize>& data) {
         memory.load(data);
     }
+
+    void load(typename Memory<MemorySize, Types>::SharedImage image) {
+        memory.load(std::move(image));
+    }
+
+    void mapPages(sc_dt::uint64 start, sc_dt::uint64 end, typename Memory<MemorySize, Types>::PageType type) {
+        memory.mapPages(start, end, type);
+    }
+
+    void mapDevice(sc_dt::uint64 start, sc_dt::uint64 end, MemoryMappedDevice& device) {
+        memory.mapDevice(start, end, device);
+    }
+
+    void setAccessDelay(const sc_core::sc_time& delay) {
+        memory.setAccessDelay(delay);
+    }
+
+    tlm::tlm_response_status transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay) {
+        initiator.socket->b_transport(trans, delay);
+        return trans.get_response_status();
+    }
+
+    bool requestDmi(tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi) {
+        return initiator.socket->get_direct_mem_ptr(trans, dmi);
+    }
+
+    void setDmiAllowed(bool allowed) {
+        memory.setDmiAllowed(allowed);
+    }
+
+    int invalidations() const {
+        return initiator.invalidations;
+    }
+
+    const Memory<MemorySize, Types>& model() const {
+        return memory;
+    }
+
+    void resetCounters() {
+        memory.resetCounters();
+    }
 };
 
 // We need to create all modules and set all signals before starting any simulations.
-static modules::add<MemoryConsumer> gMemory;
+// Every memory exists once per datatype policy, prefixed by the policy name.
+static modules::add<MemoryConsumer<NativeTypes>, std::string> gNativeMemory ("NativeMemory", "NativeMemory");
+static modules::add<MemoryConsumer<NativeTypes>, std::string> gNativeSparseMemory ("NativeSparseMemory", "NativeSparseMemory");
+static modules::add<MemoryConsumer<NativeTypes>, std::string> gNativeFirstRomMemory ("NativeFirstRomMemory", "NativeFirstRomMemory");
+static modules::add<MemoryConsumer<NativeTypes>, std::string> gNativeSecondRomMemory ("NativeSecondRomMemory", "NativeSecondRomMemory");
+static modules::add<MemoryConsumer<NativeTypes>, std::string> gNativeDeviceMemory ("NativeDeviceMemory", "NativeDeviceMemory");
+static modules::add<MemoryConsumer<BitAccurateTypes>, std::string> gBitAccurateMemory ("BitAccurateMemory", "BitAccurateMemory");
+static modules::add<MemoryConsumer<BitAccurateTypes>, std::string> gBitAccurateSparseMemory ("BitAccurateSparseMemory", "BitAccurateSparseMemory");
+static modules::add<MemoryConsumer<BitAccurateTypes>, std::string> gBitAccurateFirstRomMemory ("BitAccurateFirstRomMemory", "BitAccurateFirstRomMemory");
+static modules::add<MemoryConsumer<BitAccurateTypes>, std::string> gBitAccurateSecondRomMemory ("BitAccurateSecondRomMemory", "BitAccurateSecondRomMemory");
+static modules::add<MemoryConsumer<BitAccurateTypes>, std::string> gBitAccurateDeviceMemory ("BitAccurateDeviceMemory", "BitAccurateDeviceMemory");
+
+namespace {
+    // Every test runs with both datatype policies
+    template<typename Types>
+    class MemoryConsumers : public ::testing::Test {
+    protected:
+        static std::shared_ptr<MemoryConsumer<Types>> Get(const std::string& name) {
+            const std::string policy = std::is_same_v<Types, NativeTypes> ? "Native" : "BitAccurate";
+            return modules::get<MemoryConsumer<Types>>(policy + name);
+        }
+    };
+
+    using Policies = ::testing::Types<NativeTypes, BitAccurateTypes>;
+    TYPED_TEST_SUITE(MemoryConsumers, Policies);
+}
+
+namespace {
+    // Reads return the offset plus one, writes are recorded
+    class RecordingDevice final : public MemoryMappedDevice {
+    public:
+        std::vector<std::pair<size_t, uint8_t>> writes;
+        std::vector<size_t> reads;
+
+        uint8_t read(size_t offset) override {
+            reads.push_back(offset);
+            return static_cast<uint8_t>(offset + 1);
+        }
 
-TEST(MemoryConsumers, ReadWriteTest) {
-    auto mem = modules::get<MemoryConsumer>();
+        void write(size_t offset, uint8_t value) override {
+            writes.emplace_back(offset, value);
+        }
+    };
+}
+
+TYPED_TEST(MemoryConsumers, ReadWriteTest) {
+    auto mem = TestFixture::Get("Memory");
 
     // Write to memory
     mem->address.write(0x05);
@@ -61,8 +173,8 @@ TEST(MemoryConsumers, ReadWriteTest) {
     mem->read.write(false); // Reset read signal
 }
 
-TEST(MemoryConsumers, LoadDataTest) {
-    auto mem = modules::get<MemoryConsumer>();
+TYPED_TEST(MemoryConsumers, LoadDataTest) {
+    auto mem = TestFixture::Get("Memory");
     std::array<uint8_t, MemorySize> data = {
         // 256 zeros (reserved)
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
@@ -101,13 +213,390 @@ TEST(MemoryConsumers, LoadDataTest) {
         0x76              // HLT
     };
     mem->load(data);
-    // Check if the program was loaded correctly
-    mem->read.write(true);
-
+    // Check if the program was loaded correctly. The memory reads on the rising edge only.
     for (size_t i = 0; i < data.size(); ++i) {
         mem->address.write(i);
+        mem->read.write(true);
         sc_start(1, SC_NS); // Trigger read
-        EXPECT_EQ(mem->dataOut.read().to_uint(), data[i]);
+        EXPECT_EQ(ToUnsigned(mem->dataOut.read()), data[i]);
+        mem->read.write(false);
+        sc_start(SC_ZERO_TIME);
     }
+}
+
+TYPED_TEST(MemoryConsumers, TransactionReadWriteTest) {
+    auto mem = TestFixture::Get("Memory");
+    mem->setAccessDelay(sc_time(10, SC_NS));
+
+    uint8_t data[2] = {0xAB, 0xCD};
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x1234);
+    trans.set_data_ptr(data);
+    trans.set_data_length(2);
+    trans.set_streaming_width(2);
+    trans.set_byte_enable_ptr(nullptr);
+
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(delay, sc_time(10, SC_NS));
+
+    uint8_t read[2] = {0, 0};
+    trans.set_command(tlm::TLM_READ_COMMAND);
+    trans.set_data_ptr(read);
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(delay, sc_time(20, SC_NS));
+    EXPECT_EQ(read[0], 0xAB);
+    EXPECT_EQ(read[1], 0xCD);
+
+    // The pin-level ports see the same storage
+    mem->address.write(0x1235);
+    mem->read.write(true);
+    sc_start(1, SC_NS);
+    EXPECT_EQ(mem->dataOut.read(), 0xCD);
     mem->read.write(false);
-}
\ No newline at end of file
+
+    mem->setAccessDelay(SC_ZERO_TIME);
+}
+
+TYPED_TEST(MemoryConsumers, TransactionAddressErrorTest) {
+    auto mem = TestFixture::Get("Memory");
+
+    uint8_t data[2] = {0, 0};
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_READ_COMMAND);
+    trans.set_address(MemorySize - 1);
+    trans.set_data_ptr(data);
+    trans.set_data_length(2);
+    trans.set_streaming_width(2);
+    trans.set_byte_enable_ptr(nullptr);
+
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_ADDRESS_ERROR_RESPONSE);
+}
+
+TYPED_TEST(MemoryConsumers, DirectMemoryInterfaceTest) {
+    auto mem = TestFixture::Get("Memory");
+
+    uint8_t data = 0;
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_READ_COMMAND);
+    trans.set_address(0x4000);
+    trans.set_data_ptr(&data);
+    trans.set_data_length(1);
+    trans.set_streaming_width(1);
+    trans.set_byte_enable_ptr(nullptr);
+
+    // A page never written has no storage to point at
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_FALSE(trans.is_dmi_allowed());
+    tlm::tlm_dmi dmi;
+    EXPECT_FALSE(mem->requestDmi(trans, dmi));
+
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_TRUE(trans.is_dmi_allowed());
+    trans.set_command(tlm::TLM_READ_COMMAND);
+
+    ASSERT_TRUE(mem->requestDmi(trans, dmi));
+    EXPECT_TRUE(dmi.is_read_write_allowed());
+    EXPECT_EQ(dmi.get_start_address(), 0x4000u);
+    EXPECT_EQ(dmi.get_end_address(), 0x40FFu);
+
+    // Writes through the pointer are visible through the socket
+    dmi.get_dmi_ptr()[0x0000] = 0x5A;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(data, 0x5A);
+
+    // Revoking DMI notifies the initiator and rejects further requests
+    const int invalidations = mem->invalidations();
+    mem->setDmiAllowed(false);
+    EXPECT_EQ(mem->invalidations(), invalidations + 1);
+    EXPECT_FALSE(mem->requestDmi(trans, dmi));
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_FALSE(trans.is_dmi_allowed());
+
+    mem->setDmiAllowed(true);
+}
+
+TYPED_TEST(MemoryConsumers, AccessCountersTest) {
+    auto mem = TestFixture::Get("Memory");
+    mem->resetCounters();
+
+    // Address and data changes without an enable edge don't wake the memory up
+    for (int i = 0; i < 4; ++i) {
+        mem->address.write(0x2000 + i);
+        mem->dataIn.write(i);
+        sc_start(1, SC_NS);
+    }
+    EXPECT_EQ(mem->model().activations(), 0u);
+
+    // Write to 0x2003 (region 2), read it back and read 0x0000 (region 0)
+    mem->write.write(true);
+    sc_start(1, SC_NS);
+    mem->write.write(false);
+    sc_start(1, SC_NS);
+
+    for (const uint16_t address : {0x2003, 0x0000}) {
+        mem->address.write(address);
+        mem->read.write(true);
+        sc_start(1, SC_NS);
+        mem->read.write(false);
+        sc_start(1, SC_NS);
+    }
+    EXPECT_EQ(mem->model().activations(), 3u);
+    EXPECT_EQ(mem->dataOut.read(), 0x03);
+
+    // A two byte transaction across the boundary of regions 2 and 3
+    uint8_t data[2] = {0x12, 0x34};
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x2FFF);
+    trans.set_data_ptr(data);
+    trans.set_data_length(2);
+    trans.set_streaming_width(2);
+    trans.set_byte_enable_ptr(nullptr);
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+
+    const auto& memory = mem->model();
+    EXPECT_EQ(memory.regionCounters(0).reads, 1u);
+    EXPECT_EQ(memory.regionCounters(0).writes, 0u);
+    EXPECT_EQ(memory.regionCounters(2).reads, 1u);
+    EXPECT_EQ(memory.regionCounters(2).writes, 2u);
+    EXPECT_EQ(memory.regionCounters(3).writes, 1u);
+    EXPECT_EQ(memory.totalCounters().reads, 2u);
+    EXPECT_EQ(memory.totalCounters().writes, 3u);
+    EXPECT_EQ(memory.activations(), 3u);
+
+    mem->resetCounters();
+    EXPECT_EQ(memory.totalCounters().writes, 0u);
+}
+
+TYPED_TEST(MemoryConsumers, SparsePagesTest) {
+    auto mem = TestFixture::Get("SparseMemory");
+    const auto& memory = mem->model();
+    EXPECT_EQ(memory.residentPages(), 0u);
+
+    // Only the pages holding something get storage
+    std::array<uint8_t, MemorySize> data {};
+    data[0x0000] = 0x3E;
+    data[0x0001] = 0x12;
+    data[MemorySize - 1] = 0x76;
+    mem->load(data);
+    EXPECT_EQ(memory.residentPages(), 2u);
+
+    // Reading an untouched page doesn't allocate it, writing does
+    mem->address.write(0x8001);
+    mem->read.write(true);
+    sc_start(1, SC_NS);
+    mem->read.write(false);
+    sc_start(1, SC_NS);
+    EXPECT_EQ(mem->dataOut.read(), 0x00);
+    EXPECT_EQ(memory.residentPages(), 2u);
+
+    mem->dataIn.write(0xAA);
+    mem->write.write(true);
+    sc_start(1, SC_NS);
+    mem->write.write(false);
+    sc_start(1, SC_NS);
+    EXPECT_EQ(memory.residentPages(), 3u);
+    EXPECT_EQ(memory.getValueAt(0x8001), 0xAA);
+    data[0x8001] = 0xAA;
+
+    // A transaction across a page boundary allocates both pages
+    uint8_t bytes[2] = {0x12, 0x34};
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x90FF);
+    trans.set_data_ptr(bytes);
+    trans.set_data_length(2);
+    trans.set_streaming_width(2);
+    trans.set_byte_enable_ptr(nullptr);
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(memory.residentPages(), 5u);
+    data[0x90FF] = 0x12;
+    data[0x9100] = 0x34;
+    EXPECT_EQ(memory.digest(), utils::Fnv1a(data.data(), data.size()));
+
+    // Loading zeros gives the pages back
+    mem->load(std::array<uint8_t, MemorySize> {});
+    EXPECT_EQ(memory.residentPages(), 0u);
+    EXPECT_EQ(memory.getValueAt(0x8001), 0x00);
+
+    // DMI covers the run of pages with storage and allocates none, zero pages aren't granted
+    data = {};
+    data[0x1234] = 0x56;
+    mem->load(data);
+    tlm::tlm_dmi dmi;
+    EXPECT_FALSE(mem->requestDmi(trans, dmi));
+    trans.set_address(0x1234);
+    ASSERT_TRUE(mem->requestDmi(trans, dmi));
+    EXPECT_EQ(dmi.get_start_address(), 0x1200u);
+    EXPECT_EQ(dmi.get_end_address(), 0x12FFu);
+    EXPECT_EQ(memory.residentPages(), 1u);
+    EXPECT_EQ(dmi.get_dmi_ptr()[0x34], 0x56);
+    EXPECT_EQ(memory.digest(), utils::Fnv1a(data.data(), data.size()));
+
+    // A page written after the grant joins the run
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x1300);
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(memory.residentPages(), 2u);
+    ASSERT_TRUE(mem->requestDmi(trans, dmi));
+    EXPECT_EQ(dmi.get_start_address(), 0x1200u);
+    EXPECT_EQ(dmi.get_end_address(), 0x13FFu);
+    EXPECT_EQ(dmi.get_dmi_ptr()[0x100], 0x12);
+    EXPECT_EQ(dmi.get_dmi_ptr()[0x34], 0x56);
+}
+
+TYPED_TEST(MemoryConsumers, SharedImageTest) {
+    using PageType = typename Memory<MemorySize, TypeParam>::PageType;
+    auto first = TestFixture::Get("FirstRomMemory");
+    auto second = TestFixture::Get("SecondRomMemory");
+
+    // 4 KB of firmware in ROM, the rest is RAM
+    auto image = std::make_shared<std::array<uint8_t, MemorySize>>();
+    for (size_t i = 0; i < 0x1000; ++i) {
+        (*image)[i] = static_cast<uint8_t>(i * 7);
+    }
+    (*image)[0x2000] = 0x11;
+    for (auto& mem : {first, second}) {
+        mem->mapPages(0x0000, 0x0FFF, PageType::Rom);
+        mem->load(image);
+        EXPECT_EQ(mem->model().residentPages(), 0u);
+        EXPECT_EQ(mem->model().pageType(0x0FFF), PageType::Rom);
+        EXPECT_EQ(mem->model().pageType(0x1000), PageType::Ram);
+    }
+    EXPECT_THROW(first->mapPages(0x0000, 0x0FFE, PageType::Rom), std::runtime_error);
+
+    // Writes to ROM are ignored, a write to RAM copies the page for this memory only
+    uint8_t data[2] = {0xAA, 0xBB};
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x0FFF);
+    trans.set_data_ptr(data);
+    trans.set_data_length(2);
+    trans.set_streaming_width(2);
+    trans.set_byte_enable_ptr(nullptr);
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(first->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+
+    EXPECT_EQ(first->model().residentPages(), 1u);
+    EXPECT_EQ(first->model().romWriteTraps(), 1u);
+    EXPECT_EQ(first->model().getValueAt(0x0FFF), static_cast<uint8_t>(0x0FFF * 7));
+    EXPECT_EQ(first->model().getValueAt(0x1000), 0xBB);
+    EXPECT_EQ(second->model().residentPages(), 0u);
+    EXPECT_EQ(second->model().getValueAt(0x1000), 0x00);
+    EXPECT_EQ((*image)[0x1000], 0x00);
+
+    // DMI grants ROM read-only in the shared image itself
+    trans.set_command(tlm::TLM_READ_COMMAND);
+    tlm::tlm_dmi dmi;
+    ASSERT_TRUE(first->requestDmi(trans, dmi));
+    EXPECT_TRUE(dmi.is_read_allowed());
+    EXPECT_FALSE(dmi.is_write_allowed());
+    EXPECT_EQ(dmi.get_start_address(), 0x0000u);
+    EXPECT_EQ(dmi.get_end_address(), 0x0FFFu);
+    EXPECT_EQ(dmi.get_dmi_ptr(), image->data());
+    EXPECT_EQ(dmi.get_dmi_ptr()[0x0010], static_cast<uint8_t>(0x10 * 7));
+    EXPECT_EQ(first->model().residentPages(), 1u);
+    ASSERT_TRUE(second->requestDmi(trans, dmi));
+    EXPECT_EQ(dmi.get_dmi_ptr(), image->data());
+
+    // RAM not copied yet is granted read-only in the image too, the copied page read-write
+    trans.set_address(0x2000);
+    ASSERT_TRUE(first->requestDmi(trans, dmi));
+    EXPECT_TRUE(dmi.is_read_allowed());
+    EXPECT_FALSE(dmi.is_write_allowed());
+    EXPECT_EQ(dmi.get_start_address(), 0x1100u);
+    EXPECT_EQ(dmi.get_end_address(), MemorySize - 1);
+    EXPECT_EQ(dmi.get_dmi_ptr(), image->data() + 0x1100);
+    trans.set_address(0x1000);
+    ASSERT_TRUE(first->requestDmi(trans, dmi));
+    EXPECT_TRUE(dmi.is_read_write_allowed());
+    EXPECT_EQ(dmi.get_start_address(), 0x1000u);
+    EXPECT_EQ(dmi.get_end_address(), 0x10FFu);
+    EXPECT_EQ(dmi.get_dmi_ptr()[0x0000], 0xBB);
+    EXPECT_EQ(first->model().residentPages(), 1u);
+    EXPECT_EQ(first->model().getValueAt(0x0FFF), static_cast<uint8_t>(0x0FFF * 7));
+
+    // Copying a RAM page revokes the read-only grants over it
+    sc_start(SC_ZERO_TIME);
+    const int invalidations = first->invalidations();
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x2000);
+    EXPECT_EQ(first->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(first->invalidations(), invalidations + 1);
+    EXPECT_EQ(first->model().residentPages(), 2u);
+    trans.set_command(tlm::TLM_READ_COMMAND);
+
+    // Reloading the image drops the copies and reads every page from the image again
+    first->load(image);
+    EXPECT_EQ(first->model().getValueAt(0x1000), 0x00);
+    EXPECT_EQ(first->model().getValueAt(0x2000), 0x11);
+    EXPECT_EQ(first->model().residentPages(), 0u);
+    trans.set_address(0x0000);
+    ASSERT_TRUE(first->requestDmi(trans, dmi));
+    EXPECT_EQ(dmi.get_dmi_ptr(), image->data());
+}
+
+TYPED_TEST(MemoryConsumers, MemoryMappedDeviceTest) {
+    using PageType = typename Memory<MemorySize, TypeParam>::PageType;
+    auto mem = TestFixture::Get("DeviceMemory");
+    RecordingDevice device;
+    mem->mapDevice(0xF000, 0xF1FF, device);
+    EXPECT_EQ(mem->model().pageType(0xF100), PageType::Device);
+    EXPECT_THROW(mem->mapPages(0x0000, 0x00FF, PageType::Device), std::runtime_error);
+
+    // Pin-level accesses are passed on with the offset in the mapping
+    mem->address.write(0xF101);
+    mem->dataIn.write(0x99);
+    mem->write.write(true);
+    sc_start(1, SC_NS);
+    mem->write.write(false);
+    sc_start(1, SC_NS);
+    mem->read.write(true);
+    sc_start(1, SC_NS);
+    mem->read.write(false);
+    sc_start(1, SC_NS);
+    ASSERT_EQ(device.writes.size(), 1u);
+    EXPECT_EQ(device.writes[0].first, 0x101u);
+    EXPECT_EQ(device.writes[0].second, 0x99);
+    EXPECT_EQ(mem->dataOut.read(), 0x02);
+    EXPECT_EQ(mem->model().residentPages(), 0u);
+
+    // So are transactions, which don't allow DMI over the device
+    uint8_t data[2] = {0, 0};
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_READ_COMMAND);
+    trans.set_address(0xF1FE);
+    trans.set_data_ptr(data);
+    trans.set_data_length(2);
+    trans.set_streaming_width(2);
+    trans.set_byte_enable_ptr(nullptr);
+    sc_time delay = SC_ZERO_TIME;
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    EXPECT_EQ(data[0], 0xFF);
+    EXPECT_EQ(data[1], 0x00);       // 0x1FF + 1
+    EXPECT_FALSE(trans.is_dmi_allowed());
+    EXPECT_EQ(device.reads.size(), 3u);
+
+    // Inspecting the memory doesn't touch the device
+    EXPECT_EQ(mem->model().getValueAt(0xF000), 0x00);
+    EXPECT_EQ(device.reads.size(), 3u);
+
+    tlm::tlm_dmi dmi;
+    EXPECT_FALSE(mem->requestDmi(trans, dmi));
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0xF200);
+    EXPECT_EQ(mem->transport(trans, delay), tlm::TLM_OK_RESPONSE);
+    ASSERT_TRUE(mem->requestDmi(trans, dmi));
+    EXPECT_EQ(dmi.get_start_address(), 0xF200u);
+    EXPECT_EQ(dmi.get_end_address(), 0xF2FFu);
+
+    mem->mapPages(0xF000, 0xF1FF, PageType::Ram);
+    EXPECT_EQ(mem->model().pageType(0xF100), PageType::Ram);
+}
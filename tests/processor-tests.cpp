@@ -8,10 +8,17 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>  // For sleep
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 #include "log.hpp"
 #include "modules.hpp"
 #include "processor.hpp"
+#include "engine.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
 
 using namespace sc_core;
 using namespace sc_dt;
@@ -19,8 +26,12 @@ using namespace sim;
 
 // We need to create all modules and set all signals before starting any simulations.
 static modules::add<Intel8080, sc_module_name> gProcessor ("Intel8080TestBench", "Intel8080");
+static modules::add<Intel8080, sc_module_name, ControlUnit::Sequencer> gMethodProcessor ("Intel8080MethodTestBench", "Intel8080Method", ControlUnit::Sequencer::Method);
+static modules::add<Intel8080, sc_module_name, ControlUnit::Sequencer, ControlUnit::RegisterAccess> gDirectProcessor ("Intel8080DirectTestBench", "Intel8080Direct", ControlUnit::Sequencer::Thread, ControlUnit::RegisterAccess::Direct);
+static modules::add<Intel8080, sc_module_name, ControlUnit::Sequencer, ControlUnit::RegisterAccess> gMethodDirectProcessor ("Intel8080MethodDirectTestBench", "Intel8080MethodDirect", ControlUnit::Sequencer::Method, ControlUnit::RegisterAccess::Direct);
+static modules::add<Intel8080, sc_module_name> gBatchProcessor ("Intel8080BatchTestBench", "Intel8080Batch");
 
-#pragma mark - Processor Tests
+// MARK: - Processor Tests
 
 namespace  {
 
@@ -89,13 +100,13 @@ TEST_F(ProcessorTests, MVIInstructionTest) {
 
     EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
 
-    EXPECT_EQ(processor->registerB.getValue(), 18);
-    EXPECT_EQ(processor->registerC.getValue(), 19);
-    EXPECT_EQ(processor->registerD.getValue(), 20);
-    EXPECT_EQ(processor->registerE.getValue(), 21);
-    EXPECT_EQ(processor->registerH.getValue(), 22);
-    EXPECT_EQ(processor->registerL.getValue(), 23);
-    EXPECT_EQ(processor->registerA.getValue(), 24);
+    EXPECT_EQ(processor->registers.registerB.getValue(), 18);
+    EXPECT_EQ(processor->registers.registerC.getValue(), 19);
+    EXPECT_EQ(processor->registers.registerD.getValue(), 20);
+    EXPECT_EQ(processor->registers.registerE.getValue(), 21);
+    EXPECT_EQ(processor->registers.registerH.getValue(), 22);
+    EXPECT_EQ(processor->registers.registerL.getValue(), 23);
+    EXPECT_EQ(processor->registers.registerA.getValue(), 24);
 
     EXPECT_EQ(processor->cu.getPC(), 15);
 }
@@ -116,10 +127,10 @@ TEST_F(ProcessorTests, MVI_M_InstructionTest) {
 
     EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
 
-    const auto h = processor->registerH.getValue();
-    const auto l = processor->registerL.getValue();
+    const auto h = processor->registers.registerH.getValue();
+    const auto l = processor->registers.registerL.getValue();
     // Memory address formed by HL (H = 0x01, L = 0x08 -> HL = 0x0108)
-    const uint16_t memoryAddress = (h.to_uint() << 8) | l.to_uint();
+    const uint16_t memoryAddress = (ToUnsigned(h) << 8) | ToUnsigned(l);
     
     EXPECT_EQ(h, 0b00000001);
     EXPECT_EQ(l, 0b00001000);
@@ -140,7 +151,7 @@ TEST_F(ProcessorTests, MVI_M_InstructionTest) {
 
      EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
 
-     EXPECT_EQ(processor->registerA.getValue(), 5);
+     EXPECT_EQ(processor->registers.registerA.getValue(), 5);
  }
 
  TEST_F(ProcessorTests, LXIInstructionTest) {
@@ -158,11 +169,622 @@ TEST_F(ProcessorTests, MVI_M_InstructionTest) {
 
      EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
 
-     EXPECT_EQ(processor->registerB.getValue(), 7);
-     EXPECT_EQ(processor->registerC.getValue(), 5);
-     EXPECT_EQ(processor->registerD.getValue(), 9);
-     EXPECT_EQ(processor->registerE.getValue(), 3);
-     EXPECT_EQ(processor->registerH.getValue(), 2);
-     EXPECT_EQ(processor->registerL.getValue(), 6);
+     EXPECT_EQ(processor->registers.registerB.getValue(), 7);
+     EXPECT_EQ(processor->registers.registerC.getValue(), 5);
+     EXPECT_EQ(processor->registers.registerD.getValue(), 9);
+     EXPECT_EQ(processor->registers.registerE.getValue(), 3);
+     EXPECT_EQ(processor->registers.registerH.getValue(), 2);
+     EXPECT_EQ(processor->registers.registerL.getValue(), 6);
      EXPECT_EQ(processor->cu.getSP(), 0x1234);
  }
+
+TEST_F(ProcessorTests, TransactionMemoryAccessTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    processor->cu.setDmiEnabled(false);
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,              // NOP
+        0b00100110, 0b00000001,  // MVI H, 0x01
+        0b00101110, 0b00001000,  // MVI L, 0x08
+        0b00110110, 117,         // MVI M, 117
+        0b00111110, 3,           // MVI A, 3
+        0b10000110,              // ADD M
+        0b11000110, 5,           // ADI 5
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+
+    EXPECT_EQ(processor->memory.getValueAt(0x0108), 117);
+    EXPECT_EQ(processor->registers.registerA.getValue(), 125);
+    EXPECT_EQ(processor->cu.getPC(), 12);
+}
+
+TEST_F(ProcessorTests, DirectMemoryAccessTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    processor->cu.setDmiEnabled(true);
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,              // NOP
+        0b00100001, 0x00, 0x20,  // LXI H, 0x2000
+        0b00110110, 0x40,        // MVI M, 0x40
+        0b00111110, 0x02,        // MVI A, 2
+        0b10000110,              // ADD M
+        0b10000110,              // ADD M
+        0b00101110, 0x01,        // MVI L, 0x01
+        0b00110110, 0x11,        // MVI M, 0x11
+        0b10100110,              // ANA M
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+
+    EXPECT_EQ(processor->memory.getValueAt(0x2000), 0x40);
+    EXPECT_EQ(processor->memory.getValueAt(0x2001), 0x11);
+    EXPECT_EQ(processor->registers.registerA.getValue(), 0x82 & 0x11);
+    EXPECT_EQ(processor->cu.getPC(), 15);
+}
+
+TEST_F(ProcessorTests, SharedRomImageTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    processor->cu.setDmiEnabled(true);
+    processor->memory.mapPages(0x0000, 0x00FF, Memory<DEFAULT_MEMORY_SIZE>::PageType::Rom);
+
+    // Code in ROM, data in RAM: the control unit keeps a DMI region for each
+    auto image = std::make_shared<std::array<uint8_t, DEFAULT_MEMORY_SIZE>>();
+    *image = {
+        0b00100001, 0x00, 0x20,  // LXI H, 0x2000
+        0b00110110, 0x40,        // MVI M, 0x40
+        0b00111110, 0x02,        // MVI A, 2
+        0b10000110,              // ADD M
+        0b00100001, 0x01, 0x00,  // LXI H, 0x0001
+        0b00110110, 0x55,        // MVI M, 0x55 (ignored by ROM)
+        0b10000110,              // ADD M
+        0b01110110               // HLT
+    };
+    (*image)[0x2000] = 0x33;
+    processor->loadMemory(image);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+    processor->memory.mapPages(0x0000, 0x00FF, Memory<DEFAULT_MEMORY_SIZE>::PageType::Ram);
+
+    EXPECT_EQ(processor->memory.getValueAt(0x2000), 0x40);
+    EXPECT_EQ(processor->memory.getValueAt(0x0001), 0x00);
+    EXPECT_EQ(processor->registers.registerA.getValue(), 0x42);
+    EXPECT_EQ(processor->cu.getPC(), 14);
+    // The shared image isn't written
+    EXPECT_EQ((*image)[0x2000], 0x33);
+    EXPECT_EQ((*image)[0x0001], 0x00);
+}
+
+TEST_F(ProcessorTests, MemoryMappedDeviceTest) {
+    // A port at 0xFF00 that reads as the last value written plus one
+    class Port final : public MemoryMappedDevice {
+    public:
+        uint8_t value {0};
+        uint8_t read(size_t) override { return static_cast<uint8_t>(value + 1); }
+        void write(size_t, uint8_t data) override { value = data; }
+    } port;
+
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->memory.mapDevice(0xFF00, 0xFFFF, port);
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00100001, 0x00, 0xFF,  // LXI H, 0xFF00
+        0b00110110, 0x20,        // MVI M, 0x20
+        0b00111110, 0x01,        // MVI A, 1
+        0b10000110,              // ADD M
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->memory.mapPages(0xFF00, 0xFFFF, Memory<DEFAULT_MEMORY_SIZE>::PageType::Ram);
+
+    EXPECT_EQ(port.value, 0x20);
+    EXPECT_EQ(processor->registers.registerA.getValue(), 0x22);
+    EXPECT_EQ(processor->cu.getPC(), 8);
+}
+
+TEST_F(ProcessorTests, UnknownOpcodeTrapTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,              // NOP
+        0b00111110, 7,           // MVI A, 7
+        0b01000111,              // MOV B, A (not implemented)
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    // The trap handler stops the control unit at the offending instruction
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_EQ(processor->registers.registerA.getValue(), 7);
+    EXPECT_EQ(processor->registers.registerB.getValue(), 0);
+    EXPECT_EQ(processor->cu.getPC(), 3);
+}
+
+TEST_F(ProcessorTests, BlockCacheSelfModifyingCodeTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setBlockCacheEnabled(true);
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00100001, 0x07, 0x00,  // LXI H, 0x0007
+        0b00110110, 0b10000111,  // MVI M, ADD A (patches the NOP below)
+        0b00111110, 5,           // MVI A, 5
+        0b00000000,              // NOP -> ADD A
+        0b01110110               // HLT
+    };
+    const auto before = processor->cu.blockCacheStats();
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setBlockCacheEnabled(false);
+
+    // The block decoded at 0 still had the NOP, the write has to discard it
+    const auto& stats = processor->cu.blockCacheStats();
+    EXPECT_EQ(processor->registers.registerA.getValue(), 10);
+    EXPECT_EQ(processor->cu.getPC(), 8);
+    EXPECT_EQ(stats.misses - before.misses, 2);
+    EXPECT_GE(stats.invalidations - before.invalidations, 1);
+}
+
+TEST_F(ProcessorTests, BlockCacheHitTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    processor->cu.setBlockCacheEnabled(true);
+
+    // Runs through the whole memory, writes HLT into the middle of it at the end and wraps around
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+    program[0x0000] = 0b00100001;   // LXI H, 0x8000
+    program[0x0001] = 0x00;
+    program[0x0002] = 0x80;
+    program[0xFFF0] = 0b00110110;   // MVI M, HLT
+    program[0xFFF1] = 0b01110110;
+    const auto before = processor->cu.blockCacheStats();
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setBlockCacheEnabled(false);
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+
+    // The second pass reuses the blocks of the lower half, the page at 0x8000 is decoded again
+    const auto& stats = processor->cu.blockCacheStats();
+    EXPECT_EQ(processor->cu.getPC(), 0x8000);
+    EXPECT_GT(stats.hits - before.hits, 0);
+    EXPECT_GE(stats.invalidations - before.invalidations, 1);
+}
+
+TEST_F(ProcessorTests, ExecutionTraceTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    const std::string path = "processor-trace-tests.bin";
+    auto writer = std::make_unique<TraceWriter>(path, 1024);
+    processor->cu.setTraceWriter(writer.get());
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00100001, 0x00, 0x20,  // LXI H, 0x2000
+        0b00110110, 0x2A,        // MVI M, 0x2A
+        0b00111110, 0x05,        // MVI A, 5
+        0b11000110, 0x01,        // ADI 1
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setTraceWriter(nullptr);
+    writer.reset();
+
+    const TraceReader reader(path);
+    const auto& entries = reader.entries();
+    ASSERT_EQ(entries.size(), 5);
+    EXPECT_EQ(entries[0].record.registers[SELECT_REG_H], 0x20);
+    EXPECT_EQ(entries[1].record.pc, 3);
+    EXPECT_EQ(entries[1].record.flags & TRACE_MEMORY_WRITE, TRACE_MEMORY_WRITE);
+    EXPECT_EQ(entries[1].record.writeAddress, 0x2000);
+    EXPECT_EQ(entries[1].record.writeValue, 0x2A);
+    EXPECT_EQ(entries[2].record.flags & TRACE_MEMORY_WRITE, 0);
+    EXPECT_EQ(Disassemble(entries[3].record.bytes), "ADI 0x01");
+    EXPECT_EQ(entries[3].record.registers[SELECT_REG_A], 6);
+    EXPECT_EQ(entries[4].record.bytes[0], 0b01110110);
+    EXPECT_EQ(entries[4].cycle, 10 + 10 + 7 + 7 + 7);
+    std::remove(path.c_str());
+}
+
+TEST_F(ProcessorTests, CycleCountTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    const uint64_t before = processor->cu.cycleCount();
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,              // NOP       4
+        0b00100001, 0x00, 0x20,  // LXI H     10
+        0b00110110, 0x2A,        // MVI M     10
+        0b10000110,              // ADD M     7
+        0b11000110, 0x01,        // ADI 1     7
+        0b01110110               // HLT       7
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_EQ(processor->cu.cycleCount() - before, 4 + 10 + 10 + 7 + 7 + 7);
+}
+
+TEST_F(ProcessorTests, GuestProfilerTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    auto profiler = std::make_unique<Profiler>();
+    processor->cu.setProfiler(profiler.get());
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00111110, 0x05,        // MVI A, 5
+        0b00000110, 0x01,        // MVI B, 1
+        0b10000000,              // ADD B
+        0b10000000,              // ADD B
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    processor->cu.setProfiler(nullptr);
+
+    EXPECT_EQ(profiler->instructions(), 5);
+    EXPECT_EQ(profiler->cycles(), 7 + 7 + 4 + 4 + 7);
+    EXPECT_EQ(profiler->countAt(4), 1);
+    EXPECT_EQ(profiler->countAt(5), 1);
+    EXPECT_EQ(profiler->opcodeCount(0b10000000), 2);
+    EXPECT_EQ(profiler->opcodeCycleCount(0b10000000), 8);
+    EXPECT_EQ(profiler->opcodeCount(0b01110110), 1);
+}
+
+namespace {
+    // Runs the program on the SystemC model and on the FunctionalEngine and compares the architectural state
+    void ExpectSameState(std::shared_ptr<Intel8080> processor, const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& program) {
+        processor->loadMemory(program);
+        ASSERT_TRUE(WaitForHalt(waitTimeout, processor));
+
+        FunctionalEngine engine;
+        engine.load(program);
+        engine.run();
+        ASSERT_EQ(engine.status(), FunctionalEngine::Status::Halted);
+
+        const auto& state = engine.state();
+        EXPECT_EQ(processor->registers.registerA.getValue(), state.registers[FunctionalEngine::REG_A]);
+        EXPECT_EQ(processor->registers.registerB.getValue(), state.registers[FunctionalEngine::REG_B]);
+        EXPECT_EQ(processor->registers.registerC.getValue(), state.registers[FunctionalEngine::REG_C]);
+        EXPECT_EQ(processor->registers.registerD.getValue(), state.registers[FunctionalEngine::REG_D]);
+        EXPECT_EQ(processor->registers.registerE.getValue(), state.registers[FunctionalEngine::REG_E]);
+        EXPECT_EQ(processor->registers.registerH.getValue(), state.registers[FunctionalEngine::REG_H]);
+        EXPECT_EQ(processor->registers.registerL.getValue(), state.registers[FunctionalEngine::REG_L]);
+        EXPECT_EQ(processor->cu.getPC(), state.pc);
+        EXPECT_EQ(processor->cu.getSP(), state.sp);
+        EXPECT_EQ(processor->cu.getFlags(), state.flags);
+
+        uint32_t address = 0;
+        while (address < DEFAULT_MEMORY_SIZE && processor->memory.getValueAt(address) == engine.readMemAt(address)) {
+            ++address;
+        }
+        EXPECT_EQ(address, DEFAULT_MEMORY_SIZE) << "memory differs at address " << address;
+    }
+
+    // The first ALU instruction must not depend on the incoming carry:
+    // the ALU keeps the flags of the previous test between programs.
+    const std::vector<std::vector<uint8_t>> differentialInstructions = {
+        {0b00111110, 0x3A},         // MVI A, 0x3A
+        {0b00000110, 0xC5},         // MVI B, 0xC5
+        {0b00001110, 0x0F},         // MVI C, 0x0F
+        {0b00010110, 0x80},         // MVI D, 0x80
+        {0b00011110, 0x01},         // MVI E, 0x01
+        {0b00100001, 0x40, 0x01},   // LXI H, 0x0140
+        {0b00110110, 0x7E},         // MVI M, 0x7E
+        {0b10000000},               // ADD B
+        {0b10001001},               // ADC C
+        {0b10010010},               // SUB D
+        {0b10011011},               // SBB E
+        {0b10100110},               // ANA M
+        {0b10101000},               // XRA B
+        {0b10110001},               // ORA C
+        {0b10111010},               // CMP D
+        {0b11000110, 0xF0},         // ADI 0xF0
+        {0b11001110, 0x20},         // ACI 0x20
+        {0b11010110, 0x11},         // SUI 0x11
+        {0b11011110, 0x01},         // SBI 0x01
+        {0b11100110, 0x5A},         // ANI 0x5A
+        {0b11101110, 0xFF},         // XRI 0xFF
+        {0b11110110, 0x00},         // ORI 0x00
+        {0b11111110, 0x10},         // CPI 0x10
+        {0b10000110},               // ADD M
+        {0b00101110, 0x41},         // MVI L, 0x41
+        {0b00110110, 0x99},         // MVI M, 0x99
+        {0b10001110},               // ADC M
+        {0b10000111},               // ADD A
+        {0b10011111},               // SBB A
+        {0b00000000},               // NOP
+        {0b00110001, 0xEF, 0xBE},   // LXI SP, 0xBEEF
+    };
+
+    // Grows the program one instruction at a time and compares the state after each of them
+    void ExpectSameStateAfterEach(std::shared_ptr<Intel8080> processor) {
+        std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+        size_t size = 0;
+        for (const auto& instruction : differentialInstructions) {
+            std::copy(instruction.begin(), instruction.end(), program.begin() + size);
+            size += instruction.size();
+
+            auto prefix = program;
+            prefix[size] = 0b01110110; // HLT
+            SCOPED_TRACE(size);
+            ExpectSameState(processor, prefix);
+        }
+    }
+}
+
+TEST_F(ProcessorTests, FunctionalEngineDifferentialTest) {
+    ExpectSameStateAfterEach(modules::get<Intel8080>("Intel8080TestBench"));
+}
+
+namespace {
+    // Registers, PC, SP, flags and the T-states of one run
+    std::vector<unsigned> RunAndSnapshot(std::shared_ptr<Intel8080> processor, const std::array<uint8_t, DEFAULT_MEMORY_SIZE>& program) {
+        const uint64_t before = processor->cu.cycleCount();
+        processor->loadMemory(program);
+        EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+
+        std::vector<unsigned> state;
+        for (uint8_t reg : {SELECT_REG_A, SELECT_REG_B, SELECT_REG_C, SELECT_REG_D, SELECT_REG_E, SELECT_REG_H, SELECT_REG_L}) {
+            state.push_back(processor->registers.read(reg));
+        }
+        state.push_back(ToUnsigned(processor->cu.getPC()));
+        state.push_back(ToUnsigned(processor->cu.getSP()));
+        state.push_back(ToUnsigned(processor->cu.getFlags()));
+        state.push_back(static_cast<unsigned>(processor->cu.cycleCount() - before));
+        return state;
+    }
+}
+
+TEST_F(ProcessorTests, TemporalDecouplingDifferentialTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program {};
+    size_t size = 0;
+    for (const auto& instruction : differentialInstructions) {
+        std::copy(instruction.begin(), instruction.end(), program.begin() + size);
+        size += instruction.size();
+
+        auto prefix = program;
+        prefix[size] = 0b01110110; // HLT
+        SCOPED_TRACE(size);
+
+        processor->cu.setQuantum(SC_ZERO_TIME);
+        const auto clocked = RunAndSnapshot(processor, prefix);
+        processor->cu.setQuantum(sc_time(50, SC_US));
+        const auto decoupled = RunAndSnapshot(processor, prefix);
+        EXPECT_EQ(decoupled, clocked);
+    }
+
+    processor->cu.setQuantum(SC_ZERO_TIME);
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+}
+
+TEST_F(ProcessorTests, RequestSyncTest) {
+    auto processor = modules::get<Intel8080>("Intel8080TestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    // Longer than the whole simulation, the processor never reaches the end of the quantum by itself
+    processor->cu.setQuantum(sc_time(10, SC_SEC));
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,     // NOP
+        0b00000000,     // NOP
+        0b01110110      // HLT
+    };
+
+    // The first instruction after a quantum change syncs, let it happen
+    processor->loadMemory(program);
+    ASSERT_TRUE(WaitForHalt(waitTimeout, processor));
+
+    // All the instructions run ahead of the simulation time
+    processor->loadMemory(program);
+    ASSERT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_EQ(processor->cu.haltElapsed(), SC_ZERO_TIME);
+
+    // The first NOP syncs, at least its own 4 T-states of 0.5 us have passed before HLT
+    processor->cu.requestSync();
+    processor->loadMemory(program);
+    ASSERT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_GE(processor->cu.haltElapsed(), sc_time(2, SC_US));
+
+    processor->cu.setQuantum(SC_ZERO_TIME);
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+}
+
+// MARK: - Method sequencer
+
+TEST_F(ProcessorTests, MethodSequencerDifferentialTest) {
+    auto processor = modules::get<Intel8080>("Intel8080MethodTestBench");
+    ASSERT_EQ(processor->cu.getSequencer(), ControlUnit::Sequencer::Method);
+    ExpectSameStateAfterEach(processor);
+}
+
+TEST_F(ProcessorTests, MethodSequencerTransactionTest) {
+    auto processor = modules::get<Intel8080>("Intel8080MethodTestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    ExpectSameStateAfterEach(processor);
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+}
+
+TEST_F(ProcessorTests, MethodSequencerCycleCountTest) {
+    auto processor = modules::get<Intel8080>("Intel8080MethodTestBench");
+    const uint64_t before = processor->cu.cycleCount();
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,              // NOP       4
+        0b00100001, 0x00, 0x20,  // LXI H     10
+        0b00110110, 0x2A,        // MVI M     10
+        0b10000110,              // ADD M     7
+        0b11000110, 0x01,        // ADI 1     7
+        0b01110110               // HLT       7
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_EQ(processor->cu.cycleCount() - before, 4 + 10 + 10 + 7 + 7 + 7);
+    EXPECT_EQ(processor->memory.getValueAt(0x2000), 0x2A);
+}
+
+TEST_F(ProcessorTests, MethodSequencerTimingTest) {
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,              // NOP
+        0b00100001, 0x00, 0x20,  // LXI H
+        0b00110110, 0x2A,        // MVI M
+        0b10000110,              // ADD M
+        0b11000110, 0x01,        // ADI 1
+        0b01110110               // HLT
+    };
+
+    // 0.3 us isn't a whole number of clock periods, 1 us is two of them
+    for (const sc_time& delay : {SC_ZERO_TIME, sc_time(0.3, SC_US), sc_time(1, SC_US)}) {
+        SCOPED_TRACE(delay.to_string());
+        std::array<sc_time, 2> elapsed;
+        const std::array<const char*, 2> names = {"Intel8080TestBench", "Intel8080MethodTestBench"};
+        for (size_t i = 0; i < names.size(); ++i) {
+            auto processor = modules::get<Intel8080>(names[i]);
+            processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+            processor->cu.setDmiEnabled(false);
+            processor->memory.setAccessDelay(delay);
+            processor->loadMemory(program);
+
+            EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+            elapsed[i] = processor->cu.haltElapsed();
+            processor->memory.setAccessDelay(SC_ZERO_TIME);
+            processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+        }
+        EXPECT_EQ(elapsed[0], elapsed[1]);
+    }
+}
+
+TEST_F(ProcessorTests, MethodSequencerTrapTest) {
+    auto processor = modules::get<Intel8080>("Intel8080MethodTestBench");
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00000000,     // NOP
+        0b11111111      // RST 7, not implemented
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_EQ(processor->cu.getPC(), 1);
+}
+
+TEST_F(ProcessorTests, MethodSequencerRestrictionsTest) {
+    auto processor = modules::get<Intel8080>("Intel8080MethodTestBench");
+    EXPECT_THROW(processor->cu.setQuantum(sc_time(50, SC_US)), std::runtime_error);
+    EXPECT_THROW(processor->cu.setBlockCacheEnabled(true), std::runtime_error);
+    EXPECT_NO_THROW(processor->cu.setQuantum(SC_ZERO_TIME));
+}
+
+// MARK: - Direct register access
+
+TEST_F(ProcessorTests, DirectRegisterDifferentialTest) {
+    auto processor = modules::get<Intel8080>("Intel8080DirectTestBench");
+    ASSERT_EQ(processor->cu.getRegisterAccess(), ControlUnit::RegisterAccess::Direct);
+    ExpectSameStateAfterEach(processor);
+}
+
+TEST_F(ProcessorTests, DirectRegisterMethodSequencerTest) {
+    auto processor = modules::get<Intel8080>("Intel8080MethodDirectTestBench");
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Transaction);
+    ExpectSameStateAfterEach(processor);
+    processor->cu.setMemoryAccess(ControlUnit::MemoryAccess::Pins);
+}
+
+TEST_F(ProcessorTests, DirectRegisterInterfaceTest) {
+    auto processor = modules::get<Intel8080>("Intel8080DirectTestBench");
+    const uint64_t before = processor->cu.cycleCount();
+
+    std::array<uint8_t, DEFAULT_MEMORY_SIZE> program = {
+        0b00111110, 0x11,        // MVI A, 0x11
+        0b00010110, 0x22,        // MVI D, 0x22
+        0b10000010,              // ADD D
+        0b01110110               // HLT
+    };
+    processor->loadMemory(program);
+
+    EXPECT_TRUE(WaitForHalt(waitTimeout, processor));
+    EXPECT_EQ(processor->registers.read(SELECT_REG_A), 0x33);
+    EXPECT_EQ(processor->registers.read(SELECT_REG_D), 0x22);
+    EXPECT_EQ(processor->registers.registerA.getValue(), 0x33);
+    EXPECT_EQ(processor->cu.cycleCount() - before, 7 + 7 + 4 + 7);   // The same T-states as at pin level
+}
+
+// MARK: - Batch Tests
+
+// The way --batch and --farm workers run programs: HLT pauses the kernel instead of
+// stopping it and every program is loaded into the same elaboration. The suite drives
+// sc_start() itself, it runs after ProcessorTests has joined its simulation thread.
+TEST(ProcessorBatchTests, BackToBackProgramsTest) {
+    auto processor = modules::get<Intel8080>("Intel8080BatchTestBench");
+    processor->cu.setStopOnHalt(false);
+
+    const std::vector<std::vector<uint8_t>> programs = {
+        {
+            0b00111110, 0x05,        // MVI A, 5
+            0b11000110, 0x03,        // ADI 3
+            0b01110110               // HLT
+        },
+        {
+            0b00100001, 0x00, 0x20,  // LXI H, 0x2000
+            0b00110110, 0x2A,        // MVI M, 0x2A
+            0b10000110,              // ADD M
+            0b01110110               // HLT
+        },
+        {
+            0b00000110, 0x07,        // MVI B, 7
+            0b00001110, 0xF9,        // MVI C, 0xF9
+            0b10000000,              // ADD B
+            0b10000001,              // ADD C, carries
+            0b01110110               // HLT
+        },
+        {
+            0b00000000,              // NOP
+            0b11111111               // RST 7, not implemented
+        }
+    };
+
+    for (size_t i = 0; i < programs.size(); ++i) {
+        SCOPED_TRACE(i);
+        std::array<uint8_t, DEFAULT_MEMORY_SIZE> image {};
+        std::copy(programs[i].begin(), programs[i].end(), image.begin());
+
+        FunctionalEngine engine;
+        engine.load(image);
+        engine.run();
+        const auto& expected = engine.state();
+
+        const uint64_t instructions = processor->cu.instructionCount();
+        const uint64_t cycles = processor->cu.cycleCount();
+        processor->loadMemory(image);
+        for (int slices = 0; !processor->cu.isIdle() && slices < 1000; ++slices) {
+            sc_start(100, SC_US);
+        }
+        ASSERT_TRUE(processor->cu.isIdle());
+
+        EXPECT_EQ(processor->registers.read(SELECT_REG_A), expected.registers[FunctionalEngine::REG_A]);
+        EXPECT_EQ(processor->registers.read(SELECT_REG_B), expected.registers[FunctionalEngine::REG_B]);
+        EXPECT_EQ(processor->registers.read(SELECT_REG_C), expected.registers[FunctionalEngine::REG_C]);
+        EXPECT_EQ(processor->registers.read(SELECT_REG_D), expected.registers[FunctionalEngine::REG_D]);
+        EXPECT_EQ(processor->registers.read(SELECT_REG_E), expected.registers[FunctionalEngine::REG_E]);
+        EXPECT_EQ(processor->registers.read(SELECT_REG_H), expected.registers[FunctionalEngine::REG_H]);
+        EXPECT_EQ(processor->registers.read(SELECT_REG_L), expected.registers[FunctionalEngine::REG_L]);
+        EXPECT_EQ(ToUnsigned(processor->cu.getPC()), expected.pc);
+        EXPECT_EQ(ToUnsigned(processor->cu.getFlags()), expected.flags);
+        EXPECT_EQ(processor->cu.instructionCount() - instructions, engine.instructionCount());   // The trap isn't counted
+        EXPECT_EQ(processor->cu.cycleCount() - cycles, engine.cycleCount());
+        EXPECT_EQ(processor->memory.digest(), engine.memoryDigest());
+    }
+}
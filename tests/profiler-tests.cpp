@@ -0,0 +1,87 @@
+//
+//  profiler-tests.cpp
+//
+
+#include <gtest/gtest.h>
+
+#include "profiler.hpp"
+
+#include <memory>
+#include <sstream>
+
+using namespace sim;
+
+namespace {
+    constexpr uint8_t MVI_B = 0b00000110;
+    constexpr uint8_t ADD_B = 0b10000000;
+    constexpr uint8_t HLT = 0b01110110;
+
+    // MVI B at 0x0000, a loop of ADD B at 0x0002 and HLT at 0x0003
+    std::unique_ptr<Profiler> MakeProfile() {
+        auto profiler = std::make_unique<Profiler>();
+        profiler->record(0x0000, MVI_B, 7);
+        for (int i = 0; i < 10; ++i) {
+            profiler->record(0x0002, ADD_B, 4);
+        }
+        profiler->record(0x0003, HLT, 7);
+        return profiler;
+    }
+}
+
+TEST(ProfilerTests, CountersTest) {
+    auto profiler = MakeProfile();
+
+    EXPECT_EQ(profiler->instructions(), 12);
+    EXPECT_EQ(profiler->cycles(), 7 + 10 * 4 + 7);
+    EXPECT_EQ(profiler->countAt(0x0000), 1);
+    EXPECT_EQ(profiler->countAt(0x0001), 0);
+    EXPECT_EQ(profiler->countAt(0x0002), 10);
+    EXPECT_EQ(profiler->opcodeCount(ADD_B), 10);
+    EXPECT_EQ(profiler->opcodeCycleCount(ADD_B), 40);
+    EXPECT_EQ(profiler->opcodeCycleCount(HLT), 7);
+
+    profiler->reset();
+    EXPECT_EQ(profiler->instructions(), 0);
+    EXPECT_EQ(profiler->cycles(), 0);
+    EXPECT_EQ(profiler->countAt(0x0002), 0);
+}
+
+TEST(ProfilerTests, ReportTest) {
+    auto profiler = MakeProfile();
+    std::ostringstream out;
+    profiler->writeReport(out, 2);
+    const std::string report = out.str();
+
+    EXPECT_NE(report.find("12 instructions, 54 cycles"), std::string::npos);
+
+    // Opcodes ranked by cycles, ties by opcode: ADD B, MVI B, HLT
+    const size_t add = report.find("ADD B");
+    const size_t mvi = report.find("MVI B");
+    const size_t hlt = report.find("HLT");
+    ASSERT_NE(add, std::string::npos);
+    ASSERT_NE(mvi, std::string::npos);
+    ASSERT_NE(hlt, std::string::npos);
+    EXPECT_LT(add, mvi);
+    EXPECT_LT(mvi, hlt);
+
+    // Only the two hottest of three addresses
+    const std::string hotspots = report.substr(report.find("Hot spots"));
+    EXPECT_NE(hotspots.find("2 of 3"), std::string::npos);
+    EXPECT_NE(hotspots.find("0002"), std::string::npos);
+    EXPECT_NE(hotspots.find("0000"), std::string::npos);
+    EXPECT_EQ(hotspots.find("0003"), std::string::npos);
+}
+
+TEST(ProfilerTests, JsonTest) {
+    auto profiler = MakeProfile();
+    std::ostringstream out;
+    profiler->writeJson(out);
+    const std::string json = out.str();
+
+    EXPECT_NE(json.find("\"instructions\": 12"), std::string::npos);
+    EXPECT_NE(json.find("\"cycles\": 54"), std::string::npos);
+    EXPECT_NE(json.find("{\"opcode\": 128, \"mnemonic\": \"ADD B\", \"count\": 10, \"cycles\": 40}"), std::string::npos);
+    EXPECT_NE(json.find("{\"pc\": 2, \"opcode\": 128, \"count\": 10}"), std::string::npos);
+    EXPECT_EQ(json.find("\"pc\": 1,"), std::string::npos);
+    EXPECT_EQ(json.back(), '\n');
+}
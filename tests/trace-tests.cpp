@@ -0,0 +1,94 @@
+//
+//  trace-tests.cpp
+//
+
+#include <gtest/gtest.h>
+
+#include "trace.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+using namespace sim;
+
+namespace {
+    const std::string tracePath = "trace-tests.bin";
+
+    TraceRecord MakeRecord(uint16_t pc, uint32_t cycles) {
+        TraceRecord record {};
+        record.cycles = cycles;
+        record.pc = pc;
+        record.bytes = {0b11000110, static_cast<uint8_t>(pc), 0};   // ADI pc
+        record.length = 2;
+        record.registers = {static_cast<uint8_t>(pc), 1, 2, 3, 4, 5, 6};
+        return record;
+    }
+}
+
+TEST(TraceTests, RoundTripTest) {
+    {
+        TraceWriter writer(tracePath, 16);
+        writer.record(MakeRecord(0x0000, 7));
+        TraceRecord write = MakeRecord(0x0002, 10);
+        write.flags = TRACE_MEMORY_WRITE | 0b00001;
+        write.writeAddress = 0x1234;
+        write.writeValue = 0xAB;
+        writer.record(write);
+        EXPECT_EQ(writer.written(), 2);
+    }
+
+    const TraceReader reader(tracePath);
+    const auto& entries = reader.entries();
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[0].cycle, 7);
+    EXPECT_EQ(entries[1].cycle, 17);
+    EXPECT_EQ(entries[1].index, 1);
+    EXPECT_EQ(entries[1].record.pc, 0x0002);
+    EXPECT_EQ(entries[1].record.flags, TRACE_MEMORY_WRITE | 0b00001);
+    EXPECT_EQ(entries[1].record.writeAddress, 0x1234);
+    EXPECT_EQ(entries[1].record.writeValue, 0xAB);
+    EXPECT_EQ(entries[1].record.registers[0], 0x02);
+    std::remove(tracePath.c_str());
+}
+
+TEST(TraceTests, RingWrapAroundTest) {
+    {
+        TraceWriter writer(tracePath, 4);
+        for (uint16_t i = 0; i < 10; ++i) {
+            writer.record(MakeRecord(i, i + 1));
+        }
+    }
+
+    // Only the last 4 records are kept, their cycles are still absolute
+    const TraceReader reader(tracePath);
+    const auto& entries = reader.entries();
+    EXPECT_EQ(reader.header().written, 10);
+    ASSERT_EQ(entries.size(), 4);
+    uint64_t cycle = 0;
+    for (uint64_t i = 0; i < 10; ++i) {
+        cycle += i + 1;
+        if (i >= 6) {
+            EXPECT_EQ(entries[i - 6].index, i);
+            EXPECT_EQ(entries[i - 6].record.pc, i);
+            EXPECT_EQ(entries[i - 6].cycle, cycle);
+        }
+    }
+    std::remove(tracePath.c_str());
+}
+
+TEST(TraceTests, InvalidFileTest) {
+    std::ofstream(tracePath) << "not a trace";
+    EXPECT_THROW(TraceReader {tracePath}, std::runtime_error);
+    std::remove(tracePath.c_str());
+}
+
+TEST(TraceTests, DisassembleTest) {
+    EXPECT_EQ(Disassemble({0b00000000, 0, 0}), "NOP");
+    EXPECT_EQ(Disassemble({0b00110110, 0x2A, 0}), "MVI M, 0x2A");
+    EXPECT_EQ(Disassemble({0b00110001, 0x34, 0x12}), "LXI SP, 0x1234");
+    EXPECT_EQ(Disassemble({0b10011010, 0, 0}), "SBB D");
+    EXPECT_EQ(Disassemble({0b11111110, 0x01, 0}), "CPI 0x01");
+    EXPECT_EQ(Disassemble({0b01110110, 0, 0}), "HLT");
+    EXPECT_EQ(Disassemble({0b01000111, 0, 0}), "DB 0x47");
+}
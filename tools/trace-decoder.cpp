@@ -0,0 +1,79 @@
+//
+//  trace-decoder.cpp
+//
+
+#include "trace.hpp"
+
+#include <CLI/CLI.hpp>
+
+#include <cstdio>
+#include <exception>
+
+using namespace sim;
+
+namespace {
+    void PrintListing(const TraceReader::Entry& entry) {
+        const TraceRecord& record = entry.record;
+        const auto& r = record.registers;      // A, B, C, D, E, H, L
+        std::printf("%10llu %12llu  %04X  %-16s A=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X SP=%04X F=%02X",
+            static_cast<unsigned long long>(entry.index), static_cast<unsigned long long>(entry.cycle),
+            record.pc, Disassemble(record.bytes).c_str(), r[0], r[1], r[2], r[3], r[4], r[5], r[6],
+            record.sp, record.flags & ~TRACE_MEMORY_WRITE);
+        if (record.flags & TRACE_MEMORY_WRITE) {
+            std::printf("  [%04X] <- %02X", record.writeAddress, record.writeValue);
+        }
+        std::printf("\n");
+    }
+
+    void PrintCsv(const TraceReader::Entry& entry) {
+        const TraceRecord& record = entry.record;
+        const auto& r = record.registers;
+        std::printf("%llu,%llu,%u,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,",
+            static_cast<unsigned long long>(entry.index), static_cast<unsigned long long>(entry.cycle),
+            record.pc, Disassemble(record.bytes).c_str(), r[0], r[1], r[2], r[3], r[4], r[5], r[6],
+            record.sp, record.flags & ~TRACE_MEMORY_WRITE);
+        if (record.flags & TRACE_MEMORY_WRITE) {
+            std::printf("%u,%u\n", record.writeAddress, record.writeValue);
+        } else {
+            std::printf(",\n");
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    CLI::App app {"Intel 8080 Simulator Trace Decoder"};
+
+    std::string path;
+    app.add_option("trace", path, "Binary trace written with --trace")
+        ->required()
+        ->check(CLI::ExistingFile);
+
+    bool csv = false;
+    app.add_flag("--csv", csv, "Print comma separated values instead of a listing");
+
+    uint64_t last = 0;
+    app.add_option("-n,--last", last, "Print only the last n instructions (0 = all in the trace)");
+
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+        const TraceReader reader(path);
+        const auto& entries = reader.entries();
+        const size_t first = last != 0 && last < entries.size() ? entries.size() - last : 0;
+
+        if (csv) {
+            std::printf("index,cycle,pc,instruction,a,b,c,d,e,h,l,sp,flags,write_address,write_value\n");
+        } else {
+            std::printf("%llu instructions traced, the last %zu kept\n",
+                static_cast<unsigned long long>(reader.header().written), entries.size());
+            std::printf("%10s %12s  %-4s  %-16s %s\n", "index", "cycle", "pc", "instruction", "state after");
+        }
+        for (size_t i = first; i < entries.size(); ++i) {
+            csv ? PrintCsv(entries[i]) : PrintListing(entries[i]);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}